@@ -0,0 +1,160 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "AIOpponent.h"
+#include "TileBasedGame.h"
+#include "TileMap.h"
+#include "TileStencils.h"
+#include "TurnManager.h"
+#include "Unit.h"
+#include "Async/Async.h"
+#include "Async/TaskGraphInterfaces.h"
+
+AAIOpponent::AAIOpponent()
+	: TurnManager(nullptr)
+	, Team(1)
+	, TimeBudgetSeconds(2.f)
+	, NumWorkers(0)
+	, RolloutDepth(4)
+	, ExplorationConstant(1.41f)
+	, AttackDamage(3)
+	, bMagicDamage(false)
+	, bSearching(false)
+	, ActedTurn(INDEX_NONE)
+{
+	// only checks whether it is the team's phase, the searching is done on worker threads
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.TickInterval = 0.1f;
+}
+
+void AAIOpponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	// the worker holds on to the decision until it finishes, it just stops early
+	if (Decision.IsValid())
+	{
+		Decision->bCancelled = true;
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void AAIOpponent::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	// wait for the units to finish moving so the next search sees where they are. A replay plays the team's phases for it
+	if (bSearching || !TurnManager || !TurnManager->Map || TurnManager->GetActiveTeam() != Team || TurnManager->IsAnimating()
+		|| TurnManager->IsReplaying())
+	{
+		return;
+	}
+
+	// the team has one phase a turn
+	if (ActedTurn != TurnManager->GetTurn())
+	{
+		ActedUnitIDs.Reset();
+		ActedTurn = TurnManager->GetTurn();
+	}
+
+	int32 NumUnitsToAct = 0;
+	TurnManager->Map->GetTeamUnits(Team, TeamUnits);
+	for (AUnit* Unit : TeamUnits)
+	{
+		if (!ActedUnitIDs.Contains(Unit->GetMapUnitID()) && (TurnManager->CanMove(Unit) || TurnManager->CanAttack(Unit)))
+		{
+			NumUnitsToAct++;
+		}
+		else
+		{
+			ActedUnitIDs.AddUnique(Unit->GetMapUnitID());
+		}
+	}
+
+	if (NumUnitsToAct == 0)
+	{
+		TurnManager->EndTeamPhase();
+		return;
+	}
+	StartSearch(NumUnitsToAct);
+}
+
+void AAIOpponent::StartSearch(int32 NumUnitsToAct)
+{
+	if (!Decision.IsValid())
+	{
+		Decision = MakeShared<FAIDecision, ESPMode::ThreadSafe>();
+	}
+
+	FAIAttackRules Rules;
+	Rules.RawDamage = AttackDamage;
+	Rules.bMagicDamage = bMagicDamage;
+	// the range is the turn manager's, which refuses attacks outside it
+	Rules.MinRange = TurnManager->AttackMinRange;
+	Rules.MaxRange = TurnManager->AttackMaxRange;
+	Decision->Board.Build(TurnManager->Map->GetSimulation(), Rules, TurnManager->TeamOrder, TurnManager->TeamOrder.IndexOfByKey(Team), ActedUnitIDs);
+
+	Decision->Settings.TimeBudgetSeconds = TimeBudgetSeconds / NumUnitsToAct;
+	Decision->Settings.NumWorkers = NumWorkers;
+	Decision->Settings.RolloutDepth = RolloutDepth;
+	Decision->Settings.ExplorationConstant = ExplorationConstant;
+	Decision->Settings.Seed = FMath::Rand();
+	bSearching = true;
+
+	// the worker only touches the decision, never the map or this actor
+	TSharedPtr<FAIDecision, ESPMode::ThreadSafe> Task = Decision;
+	TWeakObjectPtr<AAIOpponent> WeakThis(this);
+	FFunctionGraphTask::CreateAndDispatchWhenReady([Task, WeakThis]()
+	{
+		Task->Result = Task->Search.Search(Task->Board, Task->Settings, &Task->bCancelled);
+
+		AsyncTask(ENamedThreads::GameThread, [Task, WeakThis]()
+		{
+			AAIOpponent* This = WeakThis.Get();
+			if (This && !Task->bCancelled)
+			{
+				This->FinishSearch();
+			}
+		});
+	}, TStatId(), nullptr, ENamedThreads::AnyThread);
+}
+
+void AAIOpponent::FinishSearch()
+{
+	bSearching = false;
+	LastResult = Decision->Result;
+	UE_LOG(LogTileBasedGame, Log, TEXT("AI team %d ran %d rollouts in %.2f s (%.0f rollouts per second), action scored %.2f"),
+		Team, LastResult.NumRollouts, LastResult.Seconds, LastResult.GetRolloutsPerSecond(), LastResult.Value);
+
+	// the phase may have been ended for the team, or a replay started, while it was thinking
+	if (!TurnManager || !TurnManager->Map || TurnManager->GetActiveTeam() != Team || TurnManager->GetTurn() != ActedTurn
+		|| TurnManager->IsReplaying())
+	{
+		return;
+	}
+
+	// with no action found the rest of the team stays where it is
+	const FAIBoardState& RootState = Decision->Board.GetRootState();
+	const FAIAction& Action = LastResult.Action;
+	if (!RootState.Units.IsValidIndex(Action.UnitIndex))
+	{
+		TurnManager->EndTeamPhase();
+		return;
+	}
+
+	const FPathGraph& Graph = Decision->Board.GetGraph();
+	const FAIUnit& ActingUnit = RootState.Units[Action.UnitIndex];
+	ActedUnitIDs.AddUnique(ActingUnit.SourceUnitID);
+
+	AUnit* Unit = TurnManager->Map->GetUnitAt(Graph.ToPosition(ActingUnit.Cell));
+	if (!Unit)
+	{
+		return;
+	}
+	// the attack was only checked from the tile the search moved to. If the turn manager refuses the move the unit has
+	// still acted, but doesn't attack from where it is
+	const bool bMoved = Action.MoveCell == ActingUnit.Cell || TurnManager->MoveUnit(Unit, Graph.ToPosition(Action.MoveCell));
+	if (bMoved && Action.TargetUnit != INDEX_NONE)
+	{
+		const FIntVector TargetPosition = Graph.ToPosition(RootState.Units[Action.TargetUnit].Cell);
+		TurnManager->Attack(Unit, TargetPosition, FTileStencils::ManhattanRing(0, 0), AttackDamage, bMagicDamage);
+	}
+}
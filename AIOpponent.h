@@ -0,0 +1,100 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "MctsSearch.h"
+#include "AIOpponent.generated.h"
+
+class ATurnManager;
+class AUnit;
+
+// state shared between the game thread and the worker running a search
+struct FAIDecision
+{
+	FAIBoard Board;
+	FMctsSettings Settings;
+	FMctsResult Result;
+
+	// kept between decisions so the workers' scratch memory is reused
+	FMctsSearch Search;
+
+	// set to stop the search. The result is never delivered once it is
+	FThreadSafeBool bCancelled;
+};
+
+// ---------- AI Opponent ---------- //
+// plays a team through the turn manager. In each of the team's phases it takes its units' actions one at a time, searching
+// for each with a monte carlo tree search on worker threads over a copy of the map's simulation, so the game thread
+// carries on while it thinks. The phase's time budget is shared between the units still to act
+
+UCLASS()
+class TILEBASEDGAME_API AAIOpponent : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	// ctor
+	AAIOpponent();
+
+	// the turn manager of the game to play in
+	UPROPERTY(EditAnywhere, Category = AI)
+	ATurnManager* TurnManager;
+
+	// team played
+	UPROPERTY(EditAnywhere, Category = AI)
+	int32 Team;
+
+	// time spent searching in each of the team's phases
+	UPROPERTY(EditAnywhere, Category = AI, meta = (ClampMin = "0.01"))
+	float TimeBudgetSeconds;
+
+	// number of trees searched at once, 0 for one per core
+	UPROPERTY(EditAnywhere, Category = AI, meta = (ClampMin = "0"))
+	int32 NumWorkers;
+
+	// number of team phases each rollout plays past the end of the tree
+	UPROPERTY(EditAnywhere, Category = AI, meta = (ClampMin = "1"))
+	int32 RolloutDepth;
+
+	// weight of exploring little visited actions over the best ones so far
+	UPROPERTY(EditAnywhere, Category = AI, meta = (ClampMin = "0.0"))
+	float ExplorationConstant;
+
+	// raw damage of the attack the team's units use, before their damage stat and tile modifiers
+	UPROPERTY(EditAnywhere, Category = AI)
+	int32 AttackDamage;
+
+	UPROPERTY(EditAnywhere, Category = AI)
+	bool bMagicDamage;
+
+	virtual void Tick(float DeltaSeconds) override;
+
+	// the last search, including how many rollouts it ran per second
+	FORCEINLINE const FMctsResult& GetLastResult() const { return LastResult; }
+
+protected:
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	// the current or last search. Only read on the game thread while no search is running
+	TSharedPtr<FAIDecision, ESPMode::ThreadSafe> Decision;
+	bool bSearching;
+
+	FMctsResult LastResult;
+
+	// occupancy IDs of the units that have taken their action in the team's phase, and the turn of the phase
+	TArray<int32> ActedUnitIDs;
+	int32 ActedTurn;
+
+	// scratch buffer for the team's units
+	UPROPERTY()
+	TArray<AUnit*> TeamUnits;
+
+	// start a search for the next unit's action on a worker thread
+	void StartSearch(int32 NumUnitsToAct);
+
+	// carry out the action found by the search
+	void FinishSearch();
+};
@@ -0,0 +1,74 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/ThreadSafeBool.h"
+#include "Misc/ScopeLock.h"
+#include "TilePathfinder.h"
+
+// called on the game thread when an asynchronous path query finishes. The path is empty if the target can't be reached
+DECLARE_DELEGATE_OneParam(FOnAsyncPathFound, const TArray<FIntVector>& /*Path*/);
+
+// called on the game thread when an asynchronous path tree has been built. The tree can be moved out of by the receiver
+DECLARE_DELEGATE_OneParam(FOnAsyncPathTreeBuilt, FPathTree& /*Tree*/);
+
+// ---------- Async Path Query ---------- //
+// state shared between the game thread and the worker running a path query
+// holding the handle keeps the query alive, cancelling it stops the search early and the result is never delivered
+
+class FAsyncPathQuery
+{
+public:
+	FAsyncPathQuery()
+		: GraphVersion(0)
+	{}
+
+	// stop the query. Safe to call from the game thread at any time, including after it has completed
+	void Cancel() { bCancelled = true; }
+	bool IsCancelled() const { return bCancelled; }
+
+	// whether the search has finished on the worker (the result may not have been delivered yet)
+	bool IsComplete() const { return bComplete; }
+
+	// version of the path graph the query was run against
+	uint32 GetGraphVersion() const { return GraphVersion; }
+
+private:
+	friend class ATileMap;
+
+	FThreadSafeBool bCancelled;
+	FThreadSafeBool bComplete;
+	uint32 GraphVersion;
+
+	// results, written on the worker and read on the game thread once complete
+	TArray<FIntVector> Path;
+	FPathTree Tree;
+};
+
+typedef TSharedPtr<FAsyncPathQuery, ESPMode::ThreadSafe> FAsyncPathQueryHandle;
+
+// ---------- Pathfinder Pool ---------- //
+// pathfinders for worker threads to borrow, so each async query doesn't have to allocate its own scratch memory
+
+class FPathfinderPool
+{
+public:
+	// take a pathfinder from the pool, creating one if they are all in use
+	TUniquePtr<FTilePathfinder> Acquire()
+	{
+		FScopeLock Lock(&PoolLock);
+		return FreePathfinders.Num() > 0 ? FreePathfinders.Pop(false) : MakeUnique<FTilePathfinder>();
+	}
+
+	// give a pathfinder back to the pool
+	void Release(TUniquePtr<FTilePathfinder>&& Pathfinder)
+	{
+		FScopeLock Lock(&PoolLock);
+		FreePathfinders.Add(MoveTemp(Pathfinder));
+	}
+
+private:
+	FCriticalSection PoolLock;
+	TArray<TUniquePtr<FTilePathfinder>> FreePathfinders;
+};
@@ -0,0 +1,84 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CombatBatch.h"
+#include "TileMap.h"
+#include "Unit.h"
+#include "Async/ParallelFor.h"
+
+// below this many hits mitigation is worked out on the calling thread, as starting the parallel pass costs more than it saves
+static const int32 MinHitsForParallelMitigation = 64;
+
+void FCombatBatch::Reset()
+{
+	Hits.Reset();
+	KilledUnits.Reset();
+}
+
+void FCombatBatch::AddHit(AUnit* Target, int32 RawDamage, bool bMagicDamage)
+{
+	if (!Target)
+	{
+		return;
+	}
+	FCombatHit& Hit = Hits.AddDefaulted_GetRef();
+	Hit.Target = Target;
+	Hit.RawDamage = RawDamage;
+	Hit.bMagicDamage = bMagicDamage;
+	Hit.DamageTaken = 0;
+}
+
+int32 FCombatBatch::AddAreaHits(const ATileMap& Map, const FIntVector& SourcePosition, const TArray<FIntVector>& Stencil, int32 RawDamage, bool bMagicDamage)
+{
+	UnitsInArea.Reset();
+	Map.GetUnitsInStencil(SourcePosition, Stencil, UnitsInArea);
+	const int32 NumHitsBefore = Hits.Num();
+	for (AUnit* Unit : UnitsInArea)
+	{
+		// units with an untargetable buff are passed over by area attacks too
+		if (Unit->IsTargetable())
+		{
+			AddHit(Unit, RawDamage, bMagicDamage);
+		}
+	}
+	return Hits.Num() - NumHitsBefore;
+}
+
+void FCombatBatch::Resolve(ATileMap& Map)
+{
+	KilledUnits.Reset();
+
+	// work out the damage each hit does. Nothing is written but the hit itself
+	const FTileSimulation& Simulation = Map.GetSimulation();
+	ParallelFor(Hits.Num(), [this, &Map, &Simulation](int32 HitIndex)
+	{
+		FCombatHit& Hit = Hits[HitIndex];
+		if (Map.IsUnitOnMap(Hit.Target))
+		{
+			Hit.DamageTaken = Simulation.GetDamageTaken(Hit.Target->GetMapUnitID(), Hit.RawDamage, Hit.bMagicDamage);
+		}
+		else
+		{
+			const int32 Mitigation = Hit.bMagicDamage ? Hit.Target->GetMagicResist() : Hit.Target->GetArmour();
+			Hit.DamageTaken = FMath::Max(Hit.RawDamage - Mitigation, 0);
+		}
+	}, Hits.Num() < MinHitsForParallelMitigation);
+
+	// apply the damage in order. Units are only marked as dead here, so later hits on them still find them
+	for (const FCombatHit& Hit : Hits)
+	{
+		if (Hit.Target->ReduceHitPoints(Hit.DamageTaken))
+		{
+			KilledUnits.Add(Hit.Target);
+		}
+	}
+
+	// take every unit killed off the map together, then destroy them
+	if (KilledUnits.Num() > 0)
+	{
+		Map.RemoveUnits(KilledUnits);
+		for (AUnit* Unit : KilledUnits)
+		{
+			Unit->TriggerDeath();
+		}
+	}
+}
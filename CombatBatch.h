@@ -0,0 +1,53 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class AUnit;
+class ATileMap;
+
+// one hit on a unit from an action
+struct FCombatHit
+{
+	AUnit* Target;
+	int32 RawDamage;
+	bool bMagicDamage;
+
+	// damage left after the target's armour or magic resist and the defense modifier of its tile. Set by Resolve
+	int32 DamageTaken;
+};
+
+// ---------- Combat Batch ---------- //
+// resolves every hit of an action together. Damage mitigation only reads the units and the map, so it is worked out for
+// every hit in one parallel pass. The damage is then applied in the order the hits were added, and units killed are
+// only removed from the map and destroyed once every hit has landed, so nothing is destroyed while the hits are applied
+
+class FCombatBatch
+{
+public:
+	// forget every hit
+	void Reset();
+
+	// add a hit on a unit. A unit can be hit more than once in a batch
+	void AddHit(AUnit* Target, int32 RawDamage, bool bMagicDamage);
+
+	// add a hit on every targetable unit in a stencil around a position. Returns the number of hits added
+	int32 AddAreaHits(const ATileMap& Map, const FIntVector& SourcePosition, const TArray<FIntVector>& Stencil, int32 RawDamage, bool bMagicDamage);
+
+	// work out and apply the damage of every hit, then remove the units killed from the map and destroy them
+	// the hits stay readable with their damage taken until the batch is reset
+	void Resolve(ATileMap& Map);
+
+	FORCEINLINE const TArray<FCombatHit>& GetHits() const { return Hits; }
+
+	// units killed by the last Resolve. They have been destroyed, so only compare against these
+	FORCEINLINE const TArray<AUnit*>& GetKilledUnits() const { return KilledUnits; }
+
+private:
+	TArray<FCombatHit> Hits;
+	TArray<AUnit*> KilledUnits;
+
+	// scratch buffer for AddAreaHits
+	TArray<AUnit*> UnitsInArea;
+};
@@ -0,0 +1,159 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CookedTileMap.h"
+#include "TileBasedGame.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Async/MappedFileHandle.h"
+#include "Misc/FileHelper.h"
+
+FCookedTileMap::FCookedTileMap()
+	: Data(nullptr)
+	, DataSize(0)
+	, TypeInstanceStartOffset(0)
+	, TypeIDsOffset(0)
+	, TileExistsOffset(0)
+	, InstanceCellsOffset(0)
+{
+}
+
+FCookedTileMap::~FCookedTileMap()
+{
+	Close();
+}
+
+int64 FCookedTileMap::ComputeLayout(const FCookedTileMapHeader& Header, int64& OutTypeInstanceStart, int64& OutTypeIDs, int64& OutTileExists, int64& OutInstanceCells)
+{
+	const int64 NumCells = (int64)Header.Size.X * Header.Size.Y * Header.Size.Z;
+	OutTypeInstanceStart = Align(sizeof(FCookedTileMapHeader), 4);
+	OutTypeIDs = OutTypeInstanceStart + (Header.NumTypes + 1) * sizeof(uint32);
+	OutTileExists = Align(OutTypeIDs + NumCells, 4);
+	OutInstanceCells = OutTileExists + FMath::DivideAndRoundUp<int64>(NumCells, NumBitsPerDWORD) * sizeof(uint32);
+	return OutInstanceCells + Header.NumTiles * sizeof(int32);
+}
+
+bool FCookedTileMap::Cook(const FTileGrid& Grid, const FVector& TileSpacing, uint32 SourceHash, const FString& Filename)
+{
+	FCookedTileMapHeader Header;
+	Header.Magic = Magic;
+	Header.Version = Version;
+	Header.Size = Grid.GetSize();
+	Header.TileSpacing = TileSpacing;
+	Header.SourceHash = SourceHash;
+	Header.NumTiles = Grid.NumTiles();
+	Header.NumTypes = MAX_uint8 + 1;
+
+	int64 TypeInstanceStart, TypeIDs, TileExists, InstanceCells;
+	const int64 FileSize = ComputeLayout(Header, TypeInstanceStart, TypeIDs, TileExists, InstanceCells);
+
+	TArray<uint8> FileData;
+	FileData.SetNumZeroed(FileSize);
+	FMemory::Memcpy(FileData.GetData(), &Header, sizeof(Header));
+
+	// count the tiles of each type to find where each type's cells start
+	uint32* TypeStarts = reinterpret_cast<uint32*>(FileData.GetData() + TypeInstanceStart);
+	Grid.ForEachTile([TypeStarts](int32 CellIndex, int32 TileTypeID)
+	{
+		TypeStarts[TileTypeID + 1]++;
+	});
+	for (int32 TileTypeID = 0; TileTypeID < Header.NumTypes; TileTypeID++)
+	{
+		TypeStarts[TileTypeID + 1] += TypeStarts[TileTypeID];
+	}
+
+	// then place each cell into its type's run, which keeps every run in cell order
+	TArray<uint32> TypeCursors;
+	TypeCursors.Append(TypeStarts, Header.NumTypes);
+	int32* Cells = reinterpret_cast<int32*>(FileData.GetData() + InstanceCells);
+	Grid.ForEachTile([Cells, &TypeCursors](int32 CellIndex, int32 TileTypeID)
+	{
+		Cells[TypeCursors[TileTypeID]++] = CellIndex;
+	});
+
+	// the grid itself goes in as it is stored
+	if (Grid.NumCells() > 0)
+	{
+		FMemory::Memcpy(FileData.GetData() + TypeIDs, Grid.GetTypeIDs().GetData(), Grid.NumCells());
+		FMemory::Memcpy(FileData.GetData() + TileExists, Grid.GetTileExists().GetData(), FMath::DivideAndRoundUp(Grid.NumCells(), NumBitsPerDWORD) * sizeof(uint32));
+	}
+
+	return FFileHelper::SaveArrayToFile(FileData, *Filename);
+}
+
+bool FCookedTileMap::Open(const FString& Filename)
+{
+	Close();
+
+	// map the file if possible so the contents are paged in straight from disk without being copied
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	MappedFile.Reset(PlatformFile.OpenMapped(*Filename));
+	if (MappedFile.IsValid())
+	{
+		MappedRegion.Reset(MappedFile->MapRegion(0, MappedFile->GetFileSize()));
+	}
+	if (MappedRegion.IsValid())
+	{
+		Data = MappedRegion->GetMappedPtr();
+		DataSize = MappedRegion->GetMappedSize();
+	}
+	else if (FFileHelper::LoadFileToArray(FileData, *Filename, FILEREAD_Silent))
+	{
+		Data = FileData.GetData();
+		DataSize = FileData.Num();
+	}
+	else
+	{
+		Close();
+		return false;
+	}
+
+	// make sure the file is one we can read before trusting any of the offsets in it
+	if (DataSize < (int64)sizeof(FCookedTileMapHeader))
+	{
+		Close();
+		return false;
+	}
+	const FCookedTileMapHeader& Header = GetHeader();
+	if (Header.Magic != Magic || Header.Version != Version)
+	{
+		UE_LOG(LogTileBasedGame, Warning, TEXT("%s is not a cooked tile map of the current version and must be cooked again"), *Filename);
+		Close();
+		return false;
+	}
+	if (Header.Size.X < 0 || Header.Size.Y < 0 || Header.Size.Z < 0 || Header.NumTiles < 0 || Header.NumTypes < 0
+		|| ComputeLayout(Header, TypeInstanceStartOffset, TypeIDsOffset, TileExistsOffset, InstanceCellsOffset) > DataSize)
+	{
+		UE_LOG(LogTileBasedGame, Warning, TEXT("Cooked tile map %s is truncated"), *Filename);
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void FCookedTileMap::Close()
+{
+	// the region has to be released before the file it maps
+	MappedRegion.Reset();
+	MappedFile.Reset();
+	FileData.Empty();
+	Data = nullptr;
+	DataSize = 0;
+}
+
+void FCookedTileMap::ReadGrid(FTileGrid& OutGrid) const
+{
+	check(IsOpen());
+	OutGrid.SetFromRaw(GetHeader().Size, Data + TypeIDsOffset, reinterpret_cast<const uint32*>(Data + TileExistsOffset), GetHeader().NumTiles);
+}
+
+TArrayView<const int32> FCookedTileMap::GetTypeInstances(int32 TileTypeID) const
+{
+	check(IsOpen());
+	if (TileTypeID < 0 || TileTypeID >= GetHeader().NumTypes)
+	{
+		return TArrayView<const int32>();
+	}
+	const uint32* TypeStarts = reinterpret_cast<const uint32*>(Data + TypeInstanceStartOffset);
+	const uint32 Start = FMath::Min<uint32>(TypeStarts[TileTypeID], GetHeader().NumTiles);
+	const uint32 End = FMath::Clamp<uint32>(TypeStarts[TileTypeID + 1], Start, GetHeader().NumTiles);
+	return TArrayView<const int32>(reinterpret_cast<const int32*>(Data + InstanceCellsOffset) + Start, End - Start);
+}
@@ -0,0 +1,88 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TileGrid.h"
+
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+// ---------- Cooked Tile Map ---------- //
+// binary map file produced once from a source image, so loading a level doesn't have to decode the texture.
+// Holds the dense tile grid exactly as FTileGrid stores it, the tile spacing, a hash of the sources it was made from, and the
+// cells of each tile type in order so the instanced meshes can be filled without scanning the grid. The file is memory
+// mapped where the platform supports it and read straight from the mapping, falling back to reading it into memory otherwise.
+//
+// Layout (native byte order), each section starting on a 4 byte boundary:
+//   FCookedTileMapHeader
+//   uint32 TypeInstanceStart[NumTypes + 1]   index of the first instance cell of each type, plus the total
+//   uint8  TypeIDs[NumCells]                 tile type of each cell, padded to 4 bytes
+//   uint32 TileExists[(NumCells + 31) / 32]  bit per cell set where there is a tile
+//   int32  InstanceCells[NumTiles]           cell index of each tile, grouped by type
+
+struct FCookedTileMapHeader
+{
+	uint32 Magic;
+	uint32 Version;
+	FIntVector Size;
+	FVector TileSpacing;
+	// hash of the images and tile colours the map was imported from, so a file cooked from older sources can be told apart
+	uint32 SourceHash;
+	int32 NumTiles;
+	int32 NumTypes;
+};
+
+class FCookedTileMap
+{
+public:
+	// version of the layout. Files with any other version are rejected and should be cooked again
+	enum { Magic = 0x50414D54, Version = 3 };
+
+	// ctor and dtor
+	FCookedTileMap();
+	~FCookedTileMap();
+
+	// write a grid to a cooked map file. Returns false if the file couldn't be written
+	static bool Cook(const FTileGrid& Grid, const FVector& TileSpacing, uint32 SourceHash, const FString& Filename);
+
+	// open a cooked map file, replacing any file that was open. Returns false and leaves nothing open if the file is missing,
+	// from a different version or truncated
+	bool Open(const FString& Filename);
+
+	// release the file
+	void Close();
+
+	bool IsOpen() const { return Data != nullptr; }
+
+	// the contents of the open file. Only valid while it stays open
+	const FCookedTileMapHeader& GetHeader() const { return *reinterpret_cast<const FCookedTileMapHeader*>(Data); }
+	int32 NumCells() const { return GetHeader().Size.X * GetHeader().Size.Y * GetHeader().Size.Z; }
+
+	// copy the tiles into a grid
+	void ReadGrid(FTileGrid& OutGrid) const;
+
+	// cell indices of every tile of a type, in cell order
+	TArrayView<const int32> GetTypeInstances(int32 TileTypeID) const;
+
+private:
+	// mapped file, if the platform supports mapping
+	TUniquePtr<IMappedFileHandle> MappedFile;
+	TUniquePtr<IMappedFileRegion> MappedRegion;
+
+	// the file read into memory when it can't be mapped
+	TArray<uint8> FileData;
+
+	// start of the file contents, wherever they are
+	const uint8* Data;
+	int64 DataSize;
+
+	// offsets of each section from the start of the file
+	int64 TypeInstanceStartOffset;
+	int64 TypeIDsOffset;
+	int64 TileExistsOffset;
+	int64 InstanceCellsOffset;
+
+	// work out where each section starts for a header. Returns the total size of the file
+	static int64 ComputeLayout(const FCookedTileMapHeader& Header, int64& OutTypeInstanceStart, int64& OutTypeIDs, int64& OutTileExists, int64& OutInstanceCells);
+};
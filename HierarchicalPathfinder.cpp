@@ -0,0 +1,452 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "HierarchicalPathfinder.h"
+#include "HAL/PlatformTime.h"
+#include "Algo/Reverse.h"
+
+namespace
+{
+	// runs of open border cells at least this long get an entrance at each end rather than one in the middle
+	const int32 LongEntranceLength = 6;
+
+	// entry in the abstract open set. Stale entries are skipped when popped rather than removed
+	struct FAbstractOpenEntry
+	{
+		int32 Cell;
+		int32 Score;
+	};
+
+	struct FAbstractOpenEntryPredicate
+	{
+		bool operator()(const FAbstractOpenEntry& A, const FAbstractOpenEntry& B) const
+		{
+			return A.Score < B.Score;
+		}
+	};
+
+	FORCEINLINE int32 ManhattanDistance(const FIntVector& A, const FIntVector& B)
+	{
+		const FIntVector Delta = B - A;
+		return FMath::Abs(Delta.X) + FMath::Abs(Delta.Y) + FMath::Abs(Delta.Z);
+	}
+}
+
+FHierarchicalPathfinder::FHierarchicalPathfinder()
+	: ClusterSize(16)
+	, GraphSize(0, 0, 0)
+	, NumClustersX(0)
+	, NumClustersY(0)
+	, bAllDirty(true)
+{
+}
+
+void FHierarchicalPathfinder::SetClusterSize(int32 NewClusterSize)
+{
+	// clusters need to be large enough for the entrances on each border not to overlap
+	NewClusterSize = FMath::Max(NewClusterSize, 4);
+	if (NewClusterSize != ClusterSize)
+	{
+		ClusterSize = NewClusterSize;
+		MarkAllDirty();
+	}
+}
+
+void FHierarchicalPathfinder::MarkPositionDirty(const FIntVector& MapPosition)
+{
+	const int32 ClusterIndex = GetClusterIndex(MapPosition);
+	if (ClusterIndex != INDEX_NONE)
+	{
+		Clusters[ClusterIndex].bDirty = true;
+	}
+}
+
+void FHierarchicalPathfinder::MarkAllDirty()
+{
+	bAllDirty = true;
+}
+
+bool FHierarchicalPathfinder::FindPath(const FPathGraph& Graph, const FIntVector& Start, const FIntVector& Target, int32 Team, FTilePathfinder& Refiner, TArray<FIntVector>& OutPath)
+{
+	const double StartTime = FPlatformTime::Seconds();
+	LastQueryStats = FPathQueryStats();
+	OutPath.Reset();
+
+	UpdateAbstractGraph(Graph, Refiner);
+
+	if (!Graph.IsValidPosition(Start) || !Graph.IsValidPosition(Target) || Start == Target)
+	{
+		LastQueryStats.QuerySeconds = FPlatformTime::Seconds() - StartTime;
+		return false;
+	}
+
+	const int32 StartCell = Graph.ToIndex(Start);
+	const int32 TargetCell = Graph.ToIndex(Target);
+	const FCluster& StartCluster = Clusters[GetClusterIndex(Start)];
+	const FCluster& TargetCluster = Clusters[GetClusterIndex(Target)];
+
+	// if both ends are in the same cluster a local search is usually enough
+	if (&StartCluster == &TargetCluster)
+	{
+		const bool bFoundLocally = Refiner.FindPathWithinBounds(Graph, Start, Target, Team, StartCluster.Min, StartCluster.Max, OutPath);
+		LastQueryStats.NodesExpanded += Refiner.GetNumExpanded();
+		if (bFoundLocally)
+		{
+			LastQueryStats.QuerySeconds = FPlatformTime::Seconds() - StartTime;
+			return true;
+		}
+	}
+
+	// connect the start and target to the entrances of their clusters
+	TArray<int32> StartCosts;
+	Refiner.FindCostsWithinBounds(Graph, Start, FPathGraph::IgnoreUnits, StartCluster.Min, StartCluster.Max, false, StartCluster.NodeCells, StartCosts);
+	LastQueryStats.NodesExpanded += Refiner.GetNumExpanded();
+
+	TArray<int32> TargetCosts;
+	Refiner.FindCostsWithinBounds(Graph, Target, FPathGraph::IgnoreUnits, TargetCluster.Min, TargetCluster.Max, true, TargetCluster.NodeCells, TargetCosts);
+	LastQueryStats.NodesExpanded += Refiner.GetNumExpanded();
+
+	// ---------- A* over the abstract graph ---------- //
+
+	const int32 HeuristicScale = FMath::Max(Graph.MinMoveCost, 0);
+	TMap<int32, FAbstractSearchNode> SearchNodes;
+	TArray<FAbstractOpenEntry> OpenSet;
+
+	// open a cell or reparent it if it has been reached more cheaply
+	auto Relax = [&](int32 Cell, int32 ParentCell, int32 Cost)
+	{
+		FAbstractSearchNode* SearchNode = SearchNodes.Find(Cell);
+		if (!SearchNode)
+		{
+			SearchNode = &SearchNodes.Add(Cell, FAbstractSearchNode{ MAX_int32, INDEX_NONE, false });
+		}
+		if (!SearchNode->bClosed && Cost < SearchNode->CostToHere)
+		{
+			SearchNode->CostToHere = Cost;
+			SearchNode->Parent = ParentCell;
+			OpenSet.HeapPush(FAbstractOpenEntry{ Cell, Cost + ManhattanDistance(Graph.ToPosition(Cell), Target) * HeuristicScale }, FAbstractOpenEntryPredicate());
+		}
+	};
+
+	Relax(StartCell, INDEX_NONE, 0);
+	bool bReachedTarget = false;
+	while (OpenSet.Num() > 0)
+	{
+		FAbstractOpenEntry Entry;
+		OpenSet.HeapPop(Entry, FAbstractOpenEntryPredicate(), false);
+
+		FAbstractSearchNode& Current = SearchNodes.FindChecked(Entry.Cell);
+		if (Current.bClosed)
+		{
+			continue;
+		}
+		Current.bClosed = true;
+		const int32 CurrentCost = Current.CostToHere;
+
+		if (Entry.Cell == TargetCell)
+		{
+			bReachedTarget = true;
+			break;
+		}
+		LastQueryStats.NodesExpanded++;
+
+		// the start connects to the entrances of its cluster
+		if (Entry.Cell == StartCell)
+		{
+			for (int32 i = 0; i < StartCluster.NodeCells.Num(); i++)
+			{
+				if (StartCosts[i] != MAX_int32)
+				{
+					Relax(StartCluster.NodeCells[i], Entry.Cell, CurrentCost + StartCosts[i]);
+				}
+			}
+		}
+
+		if (const FAbstractNode* Node = Nodes.Find(Entry.Cell))
+		{
+			for (const FAbstractEdge& Edge : Node->IntraEdges)
+			{
+				Relax(Edge.ToCell, Entry.Cell, CurrentCost + Edge.Cost);
+			}
+			for (int32 InterCell : Node->InterCells)
+			{
+				Relax(InterCell, Entry.Cell, CurrentCost + Graph.MoveCosts[InterCell]);
+			}
+
+			// entrances of the target's cluster connect to the target
+			if (&Clusters[Node->Cluster] == &TargetCluster)
+			{
+				const int32 NodeIndex = TargetCluster.NodeCells.Find(Entry.Cell);
+				if (NodeIndex != INDEX_NONE && TargetCosts[NodeIndex] != MAX_int32)
+				{
+					Relax(TargetCell, Entry.Cell, CurrentCost + TargetCosts[NodeIndex]);
+				}
+			}
+		}
+	}
+
+	// ---------- refine the abstract path ---------- //
+
+	bool bRefined = bReachedTarget;
+	if (bReachedTarget)
+	{
+		TArray<int32> Waypoints;
+		for (int32 Cell = TargetCell; Cell != INDEX_NONE; Cell = SearchNodes.FindChecked(Cell).Parent)
+		{
+			Waypoints.Add(Cell);
+		}
+		Algo::Reverse(Waypoints);
+
+		TArray<FIntVector> Segment;
+		for (int32 i = 1; i < Waypoints.Num() && bRefined; i++)
+		{
+			const FIntVector From = Graph.ToPosition(Waypoints[i - 1]);
+			const FIntVector To = Graph.ToPosition(Waypoints[i]);
+
+			// the abstract graph ignores units so an entrance may be blocked
+			if (Waypoints[i] != TargetCell && !Graph.CanEnter(Waypoints[i], Team))
+			{
+				bRefined = false;
+			}
+			// steps across a border are a single move
+			else if (ManhattanDistance(From, To) == 1 && GetClusterIndex(From) != GetClusterIndex(To))
+			{
+				OutPath.Add(To);
+			}
+			// everything else is a path within a single cluster
+			else
+			{
+				const FCluster& Cluster = Clusters[GetClusterIndex(From)];
+				bRefined = Refiner.FindPathWithinBounds(Graph, From, To, Team, Cluster.Min, Cluster.Max, Segment);
+				LastQueryStats.NodesExpanded += Refiner.GetNumExpanded();
+				OutPath.Append(Segment);
+			}
+		}
+	}
+
+	// units blocking the abstract path (or a border that the entrances don't fully represent) mean a full search is needed
+	if (!bRefined)
+	{
+		Refiner.FindPath(Graph, Start, Target, Team, OutPath);
+		LastQueryStats.NodesExpanded += Refiner.GetNumExpanded();
+	}
+
+	LastQueryStats.QuerySeconds = FPlatformTime::Seconds() - StartTime;
+	return OutPath.Num() > 0;
+}
+
+void FHierarchicalPathfinder::UpdateAbstractGraph(const FPathGraph& Graph, FTilePathfinder& Refiner)
+{
+	if (bAllDirty || Graph.Size != GraphSize)
+	{
+		ResetClusters(Graph);
+	}
+
+	// a tile changing alters the borders of its cluster, which changes the entrances of the neighbouring clusters too
+	TSet<int32> BordersToRebuild; // cluster index * 2 + axis
+	TSet<int32> ClustersToRebuild;
+	for (int32 ClusterIndex = 0; ClusterIndex < Clusters.Num(); ClusterIndex++)
+	{
+		if (!Clusters[ClusterIndex].bDirty)
+		{
+			continue;
+		}
+		ClustersToRebuild.Add(ClusterIndex);
+		for (int32 Axis = 0; Axis < 2; Axis++)
+		{
+			BordersToRebuild.Add(ClusterIndex * 2 + Axis);
+
+			const int32 Previous = GetNeighbourCluster(ClusterIndex, Axis, -1);
+			if (Previous != INDEX_NONE)
+			{
+				BordersToRebuild.Add(Previous * 2 + Axis);
+				ClustersToRebuild.Add(Previous);
+			}
+			const int32 Next = GetNeighbourCluster(ClusterIndex, Axis, 1);
+			if (Next != INDEX_NONE)
+			{
+				ClustersToRebuild.Add(Next);
+			}
+		}
+	}
+
+	for (int32 Border : BordersToRebuild)
+	{
+		RemoveBorder(Border / 2, Border % 2);
+	}
+	for (int32 Border : BordersToRebuild)
+	{
+		BuildBorder(Graph, Border / 2, Border % 2);
+	}
+	for (int32 ClusterIndex : ClustersToRebuild)
+	{
+		BuildIntraEdges(Graph, ClusterIndex, Refiner);
+		Clusters[ClusterIndex].bDirty = false;
+	}
+}
+
+void FHierarchicalPathfinder::ResetClusters(const FPathGraph& Graph)
+{
+	bAllDirty = false;
+	GraphSize = Graph.Size;
+	Nodes.Reset();
+
+	NumClustersX = (GraphSize.X + ClusterSize - 1) / ClusterSize;
+	NumClustersY = (GraphSize.Y + ClusterSize - 1) / ClusterSize;
+
+	// clusters cover every layer of the map
+	Clusters.Reset();
+	Clusters.SetNum(NumClustersX * NumClustersY);
+	for (int32 Y = 0; Y < NumClustersY; Y++)
+	{
+		for (int32 X = 0; X < NumClustersX; X++)
+		{
+			FCluster& Cluster = Clusters[X + Y * NumClustersX];
+			Cluster.Min = FIntVector(X * ClusterSize, Y * ClusterSize, 0);
+			Cluster.Max = FIntVector(FMath::Min((X + 1) * ClusterSize, GraphSize.X), FMath::Min((Y + 1) * ClusterSize, GraphSize.Y), GraphSize.Z);
+			Cluster.bDirty = true;
+		}
+	}
+}
+
+void FHierarchicalPathfinder::BuildBorder(const FPathGraph& Graph, int32 ClusterIndex, int32 Axis)
+{
+	if (GetNeighbourCluster(ClusterIndex, Axis, 1) == INDEX_NONE)
+	{
+		return;
+	}
+	const FCluster& Cluster = Clusters[ClusterIndex];
+
+	// positions either side of the border at a point along it
+	auto GetInside = [&](int32 Along, int32 Z)
+	{
+		return Axis == 0 ? FIntVector(Cluster.Max.X - 1, Along, Z) : FIntVector(Along, Cluster.Max.Y - 1, Z);
+	};
+	auto GetOutside = [&](int32 Along, int32 Z)
+	{
+		return Axis == 0 ? FIntVector(Cluster.Max.X, Along, Z) : FIntVector(Along, Cluster.Max.Y, Z);
+	};
+	auto AddEntrance = [&](int32 Along, int32 Z)
+	{
+		const int32 InsideCell = Graph.ToIndex(GetInside(Along, Z));
+		const int32 OutsideCell = Graph.ToIndex(GetOutside(Along, Z));
+		Clusters[ClusterIndex].BorderEntrances[Axis].Add(FEntrance{ InsideCell, OutsideCell });
+		AddLink(InsideCell, ClusterIndex, OutsideCell);
+		AddLink(OutsideCell, GetNeighbourCluster(ClusterIndex, Axis, 1), InsideCell);
+	};
+
+	const int32 AlongMin = Axis == 0 ? Cluster.Min.Y : Cluster.Min.X;
+	const int32 AlongMax = Axis == 0 ? Cluster.Max.Y : Cluster.Max.X;
+	for (int32 Z = 0; Z < GraphSize.Z; Z++)
+	{
+		// find each run of cells which are open on both sides of the border
+		int32 RunStart = INDEX_NONE;
+		for (int32 Along = AlongMin; Along <= AlongMax; Along++)
+		{
+			const bool bOpen = Along < AlongMax
+				&& Graph.MoveCosts[Graph.ToIndex(GetInside(Along, Z))] != INDEX_NONE
+				&& Graph.MoveCosts[Graph.ToIndex(GetOutside(Along, Z))] != INDEX_NONE;
+
+			if (bOpen && RunStart == INDEX_NONE)
+			{
+				RunStart = Along;
+			}
+			else if (!bOpen && RunStart != INDEX_NONE)
+			{
+				// short runs get one entrance in the middle, long ones one at each end
+				const int32 RunEnd = Along - 1;
+				if (RunEnd - RunStart + 1 < LongEntranceLength)
+				{
+					AddEntrance((RunStart + RunEnd) / 2, Z);
+				}
+				else
+				{
+					AddEntrance(RunStart, Z);
+					AddEntrance(RunEnd, Z);
+				}
+				RunStart = INDEX_NONE;
+			}
+		}
+	}
+}
+
+void FHierarchicalPathfinder::RemoveBorder(int32 ClusterIndex, int32 Axis)
+{
+	TArray<FEntrance>& Entrances = Clusters[ClusterIndex].BorderEntrances[Axis];
+	for (const FEntrance& Entrance : Entrances)
+	{
+		RemoveLink(Entrance.InsideCell, Entrance.OutsideCell);
+		RemoveLink(Entrance.OutsideCell, Entrance.InsideCell);
+	}
+	Entrances.Reset();
+}
+
+void FHierarchicalPathfinder::BuildIntraEdges(const FPathGraph& Graph, int32 ClusterIndex, FTilePathfinder& Refiner)
+{
+	const FCluster& Cluster = Clusters[ClusterIndex];
+
+	// one flood per entrance gives its cost to every other entrance of the cluster
+	TArray<int32> Costs;
+	for (int32 i = 0; i < Cluster.NodeCells.Num(); i++)
+	{
+		FAbstractNode& Node = Nodes.FindChecked(Cluster.NodeCells[i]);
+		Node.IntraEdges.Reset();
+
+		Refiner.FindCostsWithinBounds(Graph, Graph.ToPosition(Cluster.NodeCells[i]), FPathGraph::IgnoreUnits, Cluster.Min, Cluster.Max, false, Cluster.NodeCells, Costs);
+		for (int32 j = 0; j < Cluster.NodeCells.Num(); j++)
+		{
+			if (j != i && Costs[j] != MAX_int32)
+			{
+				Node.IntraEdges.Add(FAbstractEdge{ Cluster.NodeCells[j], Costs[j] });
+			}
+		}
+	}
+}
+
+void FHierarchicalPathfinder::AddLink(int32 Cell, int32 ClusterIndex, int32 OtherCell)
+{
+	FAbstractNode* Node = Nodes.Find(Cell);
+	if (!Node)
+	{
+		Node = &Nodes.Add(Cell);
+		Node->Cluster = ClusterIndex;
+		Clusters[ClusterIndex].NodeCells.Add(Cell);
+	}
+	Node->InterCells.Add(OtherCell);
+}
+
+void FHierarchicalPathfinder::RemoveLink(int32 Cell, int32 OtherCell)
+{
+	FAbstractNode* Node = Nodes.Find(Cell);
+	if (!Node)
+	{
+		return;
+	}
+	Node->InterCells.RemoveSingleSwap(OtherCell);
+
+	// an entrance with no links to other clusters is no longer an entrance
+	if (Node->InterCells.Num() == 0)
+	{
+		Clusters[Node->Cluster].NodeCells.RemoveSingleSwap(Cell);
+		Nodes.Remove(Cell);
+	}
+}
+
+int32 FHierarchicalPathfinder::GetClusterIndex(const FIntVector& MapPosition) const
+{
+	if (MapPosition.X < 0 || MapPosition.X >= GraphSize.X || MapPosition.Y < 0 || MapPosition.Y >= GraphSize.Y || Clusters.Num() == 0)
+	{
+		return INDEX_NONE;
+	}
+	return MapPosition.X / ClusterSize + (MapPosition.Y / ClusterSize) * NumClustersX;
+}
+
+int32 FHierarchicalPathfinder::GetNeighbourCluster(int32 ClusterIndex, int32 Axis, int32 Direction) const
+{
+	const int32 X = ClusterIndex % NumClustersX + (Axis == 0 ? Direction : 0);
+	const int32 Y = ClusterIndex / NumClustersX + (Axis == 1 ? Direction : 0);
+	if (X < 0 || X >= NumClustersX || Y < 0 || Y >= NumClustersY)
+	{
+		return INDEX_NONE;
+	}
+	return X + Y * NumClustersX;
+}
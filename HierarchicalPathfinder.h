@@ -0,0 +1,122 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TilePathfinder.h"
+
+// ---------- Hierarchical Pathfinder ---------- //
+// HPA* search for very large maps. The map is split into square clusters and the cells where neighbouring clusters connect
+// (entrances) form an abstract graph, with the cost of crossing each cluster between its entrances precomputed from the terrain.
+// Long queries are answered on the abstract graph first and each abstract step is then refined with a search that is
+// confined to a single cluster. Paths are near optimal rather than optimal.
+// The abstract graph only considers terrain, units are taken into account when refining. When tiles change only the
+// clusters around them are recomputed.
+
+class FHierarchicalPathfinder
+{
+public:
+	// ctor
+	FHierarchicalPathfinder();
+
+	// size of the square clusters the map is split into. Changing it rebuilds the whole abstract graph
+	void SetClusterSize(int32 NewClusterSize);
+	int32 GetClusterSize() const { return ClusterSize; }
+
+	// flag the cluster containing a map position so its entrances and costs are recomputed before the next query
+	void MarkPositionDirty(const FIntVector& MapPosition);
+
+	// flag every cluster so the whole abstract graph is rebuilt before the next query
+	void MarkAllDirty();
+
+	// find a path from start to target for a unit of the given team, following the same rules as FTilePathfinder::FindPath
+	// the refiner is used for the searches within clusters. Returns false and leaves the path empty if the target can't be reached
+	bool FindPath(const FPathGraph& Graph, const FIntVector& Start, const FIntVector& Target, int32 Team, FTilePathfinder& Refiner, TArray<FIntVector>& OutPath);
+
+	// nodes expanded and time taken by the last query (including refinement)
+	const FPathQueryStats& GetLastQueryStats() const { return LastQueryStats; }
+
+	// number of entrance nodes in the abstract graph
+	int32 GetNumAbstractNodes() const { return Nodes.Num(); }
+
+private:
+	// a precomputed path between two entrances of the same cluster
+	struct FAbstractEdge
+	{
+		int32 ToCell;
+		int32 Cost;
+	};
+
+	// an entrance cell of a cluster
+	struct FAbstractNode
+	{
+		int32 Cluster; // index of the cluster the cell is in
+		TArray<FAbstractEdge> IntraEdges; // paths to the other entrances of the same cluster
+		TArray<int32> InterCells; // adjacent entrance cells of neighbouring clusters
+	};
+
+	// a pair of adjacent cells either side of a cluster border
+	struct FEntrance
+	{
+		int32 InsideCell;
+		int32 OutsideCell;
+	};
+
+	struct FCluster
+	{
+		FIntVector Min; // inclusive
+		FIntVector Max; // exclusive
+		TArray<int32> NodeCells; // entrance cells of this cluster
+		TArray<FEntrance> BorderEntrances[2]; // entrances on the +X (0) and +Y (1) borders, shared with the neighbouring cluster
+		bool bDirty;
+	};
+
+	// state of an abstract node during a query
+	struct FAbstractSearchNode
+	{
+		int32 CostToHere;
+		int32 Parent;
+		bool bClosed;
+	};
+
+	int32 ClusterSize;
+
+	// size of the graph the clusters were built for
+	FIntVector GraphSize;
+
+	// number of clusters in x and y
+	int32 NumClustersX;
+	int32 NumClustersY;
+
+	TArray<FCluster> Clusters;
+
+	// abstract graph, keyed by cell index
+	TMap<int32, FAbstractNode> Nodes;
+
+	bool bAllDirty;
+
+	FPathQueryStats LastQueryStats;
+
+	// recompute the parts of the abstract graph that have been flagged dirty
+	void UpdateAbstractGraph(const FPathGraph& Graph, FTilePathfinder& Refiner);
+
+	// split the graph into clusters with no entrances, every cluster flagged dirty
+	void ResetClusters(const FPathGraph& Graph);
+
+	// find the entrances along one border of a cluster and link them into the abstract graph
+	void BuildBorder(const FPathGraph& Graph, int32 ClusterIndex, int32 Axis);
+
+	// unlink the entrances along one border of a cluster, removing any nodes which no longer connect anywhere
+	void RemoveBorder(int32 ClusterIndex, int32 Axis);
+
+	// recompute the paths between each pair of entrances within a cluster
+	void BuildIntraEdges(const FPathGraph& Graph, int32 ClusterIndex, FTilePathfinder& Refiner);
+
+	// connect an entrance cell to an entrance of a neighbouring cluster, creating the node if needed
+	void AddLink(int32 Cell, int32 ClusterIndex, int32 OtherCell);
+	void RemoveLink(int32 Cell, int32 OtherCell);
+
+	// index of the cluster containing a position, or of the neighbouring cluster in x or y
+	int32 GetClusterIndex(const FIntVector& MapPosition) const;
+	int32 GetNeighbourCluster(int32 ClusterIndex, int32 Axis, int32 Direction) const;
+};
@@ -0,0 +1,435 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "MatchLog.h"
+#include "TileSimulation.h"
+#include "Algo/BinarySearch.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+// reading the packed commands. The offset is moved past what is read, or set to INDEX_NONE if the data runs out. Reads
+// from INDEX_NONE give 0, so a command cut short is only checked for once it has been read
+static uint32 ReadUnsigned(const TArray<uint8>& Data, int32& Offset)
+{
+	uint32 Value = 0;
+	for (int32 Shift = 0; Shift < 35; Shift += 7)
+	{
+		if (Offset < 0 || Offset >= Data.Num())
+		{
+			Offset = INDEX_NONE;
+			return 0;
+		}
+		const uint8 Byte = Data[Offset++];
+		Value |= (uint32)(Byte & 0x7f) << Shift;
+		if (!(Byte & 0x80))
+		{
+			break;
+		}
+	}
+	return Value;
+}
+
+static int32 ReadSigned(const TArray<uint8>& Data, int32& Offset)
+{
+	const uint32 Value = ReadUnsigned(Data, Offset);
+	return (int32)(Value >> 1) ^ -(int32)(Value & 1);
+}
+
+static FIntVector ReadPosition(const TArray<uint8>& Data, int32& Offset)
+{
+	FIntVector Position;
+	Position.X = ReadSigned(Data, Offset);
+	Position.Y = ReadSigned(Data, Offset);
+	Position.Z = ReadSigned(Data, Offset);
+	return Position;
+}
+
+static void ReadStats(const TArray<uint8>& Data, int32& Offset, FUnitStatBlock& OutStats)
+{
+	for (int32& Stat : OutStats.Stats)
+	{
+		Stat = ReadSigned(Data, Offset);
+	}
+	OutStats.bTargetable = ReadUnsigned(Data, Offset) != 0;
+}
+
+FMatchLog::FMatchLog()
+	: KeyframeInterval(10)
+	, bRecording(false)
+	, CommandCount(0)
+	, Turn(0)
+	, ActiveTeamIndex(0)
+{
+}
+
+void FMatchLog::Begin(const TArray<int32>& NewTeamOrder, FTileSimulation& Simulation, int32 NewKeyframeInterval)
+{
+	Empty();
+	TeamOrder = NewTeamOrder;
+	KeyframeInterval = FMath::Max(NewKeyframeInterval, 1);
+	bRecording = true;
+	TakeKeyframe(Simulation);
+}
+
+void FMatchLog::Empty()
+{
+	TeamOrder.Reset();
+	bRecording = false;
+	Data.Reset();
+	CommandCount = 0;
+	Turn = 0;
+	ActiveTeamIndex = 0;
+	Keyframes.Reset();
+}
+
+// ---------- Recording ---------- //
+
+void FMatchLog::RecordAddUnit(int32 UnitID, int32 Team, const FIntVector& MapPosition, const FUnitStatBlock& Stats, int32 HitPoints, int32 AbilityPoints)
+{
+	if (!bRecording)
+	{
+		return;
+	}
+	WriteCommandType(EMatchCommand::AddUnit);
+	WriteUnsigned(UnitID);
+	WriteSigned(Team);
+	WritePosition(MapPosition);
+	WriteStats(Stats);
+	WriteSigned(HitPoints);
+	WriteSigned(AbilityPoints);
+}
+
+void FMatchLog::RecordRemoveUnit(int32 UnitID)
+{
+	if (!bRecording)
+	{
+		return;
+	}
+	WriteCommandType(EMatchCommand::RemoveUnit);
+	WriteUnsigned(UnitID);
+}
+
+void FMatchLog::RecordMoveUnit(int32 UnitID, const FIntVector& MapPosition)
+{
+	if (!bRecording)
+	{
+		return;
+	}
+	WriteCommandType(EMatchCommand::MoveUnit);
+	WriteUnsigned(UnitID);
+	WritePosition(MapPosition);
+}
+
+void FMatchLog::RecordAttack(int32 UnitID, const FIntVector& TargetPosition, const TArray<FIntVector>& Stencil, int32 RawDamage, bool bMagicDamage)
+{
+	if (!bRecording)
+	{
+		return;
+	}
+	WriteCommandType(EMatchCommand::Attack);
+	WriteUnsigned(UnitID);
+	WritePosition(TargetPosition);
+	WriteSigned(RawDamage);
+	WriteUnsigned(bMagicDamage ? 1 : 0);
+	WriteUnsigned(Stencil.Num());
+	for (const FIntVector& Offset : Stencil)
+	{
+		WritePosition(Offset);
+	}
+}
+
+void FMatchLog::RecordDamage(int32 UnitID, int32 RawDamage, bool bMagicDamage)
+{
+	if (!bRecording)
+	{
+		return;
+	}
+	WriteCommandType(EMatchCommand::Damage);
+	WriteUnsigned(UnitID);
+	WriteSigned(RawDamage);
+	WriteUnsigned(bMagicDamage ? 1 : 0);
+}
+
+void FMatchLog::RecordHeal(int32 UnitID, int32 Amount)
+{
+	if (!bRecording)
+	{
+		return;
+	}
+	WriteCommandType(EMatchCommand::Heal);
+	WriteUnsigned(UnitID);
+	WriteSigned(Amount);
+}
+
+void FMatchLog::RecordStats(int32 UnitID, const FUnitStatBlock& Stats)
+{
+	if (!bRecording)
+	{
+		return;
+	}
+	WriteCommandType(EMatchCommand::SetStats);
+	WriteUnsigned(UnitID);
+	WriteStats(Stats);
+}
+
+void FMatchLog::RecordEndPhase(FTileSimulation& Simulation)
+{
+	if (!bRecording)
+	{
+		return;
+	}
+	WriteCommandType(EMatchCommand::EndPhase);
+
+	ActiveTeamIndex++;
+	if (ActiveTeamIndex >= TeamOrder.Num())
+	{
+		ActiveTeamIndex = 0;
+		Turn++;
+		if (Turn % KeyframeInterval == 0)
+		{
+			TakeKeyframe(Simulation);
+		}
+	}
+}
+
+void FMatchLog::TakeKeyframe(FTileSimulation& Simulation)
+{
+	FKeyframe& Keyframe = Keyframes.AddDefaulted_GetRef();
+	Keyframe.Turn = Turn;
+	Keyframe.DataOffset = Data.Num();
+
+	FMemoryWriter Writer(Keyframe.Snapshot);
+	Simulation.SerializeUnits(Writer);
+}
+
+void FMatchLog::WriteCommandType(EMatchCommand Type)
+{
+	Data.Add((uint8)Type);
+	CommandCount++;
+}
+
+void FMatchLog::WriteUnsigned(uint32 Value)
+{
+	// 7 bits to a byte, the high bit set on every byte but the last
+	while (Value >= 0x80)
+	{
+		Data.Add((uint8)(Value | 0x80));
+		Value >>= 7;
+	}
+	Data.Add((uint8)Value);
+}
+
+void FMatchLog::WriteSigned(int32 Value)
+{
+	WriteUnsigned(((uint32)Value << 1) ^ (uint32)(Value >> 31));
+}
+
+void FMatchLog::WritePosition(const FIntVector& Position)
+{
+	WriteSigned(Position.X);
+	WriteSigned(Position.Y);
+	WriteSigned(Position.Z);
+}
+
+void FMatchLog::WriteStats(const FUnitStatBlock& Stats)
+{
+	for (int32 Stat : Stats.Stats)
+	{
+		WriteSigned(Stat);
+	}
+	WriteUnsigned(Stats.bTargetable ? 1 : 0);
+}
+
+// ---------- Playback ---------- //
+
+int32 FMatchLog::ReadCommand(int32 Offset, FMatchCommand& OutCommand) const
+{
+	if (Offset < 0 || Offset >= Data.Num())
+	{
+		return INDEX_NONE;
+	}
+
+	OutCommand.Type = (EMatchCommand)Data[Offset++];
+	if (OutCommand.Type >= EMatchCommand::Num)
+	{
+		return INDEX_NONE;
+	}
+	if (OutCommand.Type != EMatchCommand::EndPhase)
+	{
+		OutCommand.UnitID = ReadUnsigned(Data, Offset);
+	}
+
+	switch (OutCommand.Type)
+	{
+	case EMatchCommand::AddUnit:
+		OutCommand.Team = ReadSigned(Data, Offset);
+		OutCommand.Position = ReadPosition(Data, Offset);
+		ReadStats(Data, Offset, OutCommand.Stats);
+		OutCommand.HitPoints = ReadSigned(Data, Offset);
+		OutCommand.AbilityPoints = ReadSigned(Data, Offset);
+		break;
+
+	case EMatchCommand::SetStats:
+		ReadStats(Data, Offset, OutCommand.Stats);
+		break;
+
+	case EMatchCommand::MoveUnit:
+		OutCommand.Position = ReadPosition(Data, Offset);
+		break;
+
+	case EMatchCommand::Attack:
+	{
+		OutCommand.Position = ReadPosition(Data, Offset);
+		OutCommand.RawDamage = ReadSigned(Data, Offset);
+		OutCommand.bMagicDamage = ReadUnsigned(Data, Offset) != 0;
+		// each offset takes at least 3 bytes, which bounds a stencil size read from a damaged log
+		const uint32 StencilSize = ReadUnsigned(Data, Offset);
+		if (Offset == INDEX_NONE || StencilSize > (uint32)(Data.Num() - Offset) / 3)
+		{
+			return INDEX_NONE;
+		}
+		OutCommand.Stencil.Reset(StencilSize);
+		for (uint32 StencilIndex = 0; StencilIndex < StencilSize; StencilIndex++)
+		{
+			OutCommand.Stencil.Add(ReadPosition(Data, Offset));
+		}
+		break;
+	}
+
+	case EMatchCommand::Damage:
+		OutCommand.RawDamage = ReadSigned(Data, Offset);
+		OutCommand.bMagicDamage = ReadUnsigned(Data, Offset) != 0;
+		break;
+
+	case EMatchCommand::Heal:
+		OutCommand.Amount = ReadSigned(Data, Offset);
+		break;
+
+	default:
+		break;
+	}
+	return Offset;
+}
+
+void FMatchLog::ApplyCommand(const FMatchCommand& Command, const TArray<int32>& TeamOrder, FTileSimulation& Simulation, int32& InOutTurn, int32& InOutActiveTeamIndex)
+{
+	const FUnitOccupancy& Units = Simulation.GetUnits();
+	switch (Command.Type)
+	{
+	case EMatchCommand::AddUnit:
+	{
+		// IDs are handed out in the same order as they were in the game
+		const int32 UnitID = Simulation.AddUnit(Command.Team, Command.Position, Command.Stats, Command.HitPoints, Command.AbilityPoints);
+		ensure(UnitID == Command.UnitID);
+		break;
+	}
+
+	case EMatchCommand::RemoveUnit:
+		Simulation.RemoveUnit(Command.UnitID);
+		break;
+
+	case EMatchCommand::MoveUnit:
+		Simulation.MoveUnit(Command.UnitID, Command.Position);
+		break;
+
+	case EMatchCommand::Attack:
+	{
+		// as ATurnManager::Attack and FCombatBatch::Resolve: every hit is mitigated before any damage is taken, and the
+		// units killed are taken off by the RemoveUnit commands that follow
+		const int32 DamageDealt = Simulation.GetDamageDealt(Command.UnitID, Command.RawDamage);
+		TArray<TPair<int32, int32>, TInlineAllocator<16>> Hits;
+		for (const FIntVector& Offset : Command.Stencil)
+		{
+			const int32 TargetID = Units.GetUnitAt(Command.Position + Offset);
+			if (TargetID != INDEX_NONE && Simulation.GetUnit(TargetID).Stats.bTargetable)
+			{
+				Hits.Emplace(TargetID, Simulation.GetDamageTaken(TargetID, DamageDealt, Command.bMagicDamage));
+			}
+		}
+		for (const TPair<int32, int32>& Hit : Hits)
+		{
+			Simulation.ReduceHitPoints(Hit.Key, Hit.Value);
+		}
+		break;
+	}
+
+	case EMatchCommand::Damage:
+		Simulation.ReduceHitPoints(Command.UnitID, Simulation.GetDamageTaken(Command.UnitID, Command.RawDamage, Command.bMagicDamage));
+		break;
+
+	case EMatchCommand::Heal:
+		Simulation.Heal(Command.UnitID, Command.Amount);
+		break;
+
+	case EMatchCommand::SetStats:
+		Simulation.SetUnitStats(Command.UnitID, Command.Stats);
+		break;
+
+	case EMatchCommand::EndPhase:
+		InOutActiveTeamIndex++;
+		if (InOutActiveTeamIndex >= TeamOrder.Num())
+		{
+			InOutActiveTeamIndex = 0;
+			InOutTurn++;
+		}
+		// the units of the next team start their turn
+		if (TeamOrder.IsValidIndex(InOutActiveTeamIndex))
+		{
+			for (int32 UnitID : Units.GetTeamUnits(TeamOrder[InOutActiveTeamIndex]))
+			{
+				Simulation.StartUnitTurn(UnitID);
+			}
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+bool FMatchLog::FastForward(int32 TargetTurn, FTileSimulation& Simulation) const
+{
+	if (TargetTurn < 0 || TargetTurn > Turn || Keyframes.Num() == 0)
+	{
+		return false;
+	}
+
+	// keyframes are in turn order, so the last one at or before the turn is found by binary search
+	const int32 KeyframeIndex = Algo::UpperBoundBy(Keyframes, TargetTurn, [](const FKeyframe& Keyframe) { return Keyframe.Turn; }) - 1;
+	const FKeyframe& Keyframe = Keyframes[KeyframeIndex];
+	FMemoryReader Reader(Keyframe.Snapshot);
+	Simulation.SerializeUnits(Reader);
+
+	// play the commands after the keyframe until the turn starts
+	int32 CurrentTurn = Keyframe.Turn;
+	int32 CurrentTeamIndex = 0;
+	int32 Offset = Keyframe.DataOffset;
+	FMatchCommand Command;
+	while (CurrentTurn < TargetTurn)
+	{
+		Offset = ReadCommand(Offset, Command);
+		if (Offset == INDEX_NONE)
+		{
+			return false;
+		}
+		ApplyCommand(Command, TeamOrder, Simulation, CurrentTurn, CurrentTeamIndex);
+	}
+	return true;
+}
+
+FArchive& operator<<(FArchive& Ar, FMatchLog& Log)
+{
+	Ar << Log.TeamOrder;
+	Ar << Log.KeyframeInterval;
+	Ar << Log.Data;
+	Ar << Log.CommandCount;
+	Ar << Log.Turn;
+	Ar << Log.ActiveTeamIndex;
+	Ar << Log.Keyframes;
+
+	// a loaded log is for playing back, not adding to
+	if (Ar.IsLoading())
+	{
+		Log.bRecording = false;
+	}
+	return Ar;
+}
@@ -0,0 +1,152 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UnitStatBlock.h"
+
+class FTileSimulation;
+
+// the kinds of command in a match log
+enum class EMatchCommand : uint8
+{
+	AddUnit,    // a unit was placed on the map
+	RemoveUnit, // a unit was taken off the map, such as when it is killed
+	MoveUnit,   // a unit moved to a new tile
+	Attack,     // a unit attacked every unit in a stencil around a position
+	Damage,     // a unit took damage from outside an attack, such as a damage over time buff. Mitigated when applied
+	Heal,       // a unit was healed
+	SetStats,   // a unit's stats changed, such as when a buff was applied or ran out
+	EndPhase,   // the active team's phase ended and the next team's started
+	Num
+};
+
+// one command read back from a match log. Only the fields used by the type of command are set
+struct FMatchCommand
+{
+	EMatchCommand Type;
+	int32 UnitID;
+
+	// AddUnit
+	int32 Team;
+	int32 HitPoints;
+	int32 AbilityPoints;
+
+	// where a unit was added or moved to, or the position an attack was centred on
+	FIntVector Position;
+
+	// Attack and Damage
+	int32 RawDamage;
+	bool bMagicDamage;
+	TArray<FIntVector> Stencil;
+
+	// Heal
+	int32 Amount;
+
+	// AddUnit and SetStats
+	FUnitStatBlock Stats;
+};
+
+// ---------- Match Log ---------- //
+// append-only record of everything that changes the units of a match, as commands on unit IDs of the map's simulation.
+// Commands are packed as variable length integers, so most take a handful of bytes. At the start of every KeyframeInterval
+// turns a snapshot of the simulation's units is kept with the offset of the next command, so the state at the start of any
+// turn is found by loading the last keyframe at or before it and applying the few commands after it to a bare simulation,
+// with no actors involved. Only the units are recorded: the tiles must be those of the match when the log is played back
+
+class FMatchLog
+{
+public:
+	// ctor
+	FMatchLog();
+
+	// forget the match and start recording a new one from the units of a simulation at the start of turn 0
+	// the simulation is only saved from, but serializing it goes through the same two-way archive as loading does
+	void Begin(const TArray<int32>& NewTeamOrder, FTileSimulation& Simulation, int32 NewKeyframeInterval);
+
+	// forget the match and stop recording
+	void Empty();
+
+	// whether a match is being recorded
+	FORCEINLINE bool IsRecording() const { return bRecording; }
+
+	// stop recording, keeping what has been recorded
+	FORCEINLINE void StopRecording() { bRecording = false; }
+
+	// ---------- Recording ---------- //
+	// each of these does nothing unless a match is being recorded
+
+	void RecordAddUnit(int32 UnitID, int32 Team, const FIntVector& MapPosition, const FUnitStatBlock& Stats, int32 HitPoints, int32 AbilityPoints);
+	void RecordRemoveUnit(int32 UnitID);
+	void RecordMoveUnit(int32 UnitID, const FIntVector& MapPosition);
+	void RecordAttack(int32 UnitID, const FIntVector& TargetPosition, const TArray<FIntVector>& Stencil, int32 RawDamage, bool bMagicDamage);
+	void RecordDamage(int32 UnitID, int32 RawDamage, bool bMagicDamage);
+	void RecordHeal(int32 UnitID, int32 Amount);
+	void RecordStats(int32 UnitID, const FUnitStatBlock& Stats);
+
+	// the active team's phase has ended and the next team's has started, with every effect of the change already recorded
+	// the simulation is snapshotted if this starts a turn due a keyframe
+	void RecordEndPhase(FTileSimulation& Simulation);
+
+	// ---------- Playback ---------- //
+
+	// teams in the order they take their phases
+	FORCEINLINE const TArray<int32>& GetTeamOrder() const { return TeamOrder; }
+
+	// the turn and team phase at the end of the log
+	FORCEINLINE int32 GetTurn() const { return Turn; }
+	FORCEINLINE int32 GetActiveTeamIndex() const { return ActiveTeamIndex; }
+
+	FORCEINLINE int32 NumCommands() const { return CommandCount; }
+	FORCEINLINE int32 NumBytes() const { return Data.Num(); }
+	FORCEINLINE int32 NumKeyframes() const { return Keyframes.Num(); }
+
+	// read the command at a byte offset, starting from 0. Returns the offset of the next command, INDEX_NONE if there is no
+	// command at the offset or the log ends partway through it
+	int32 ReadCommand(int32 Offset, FMatchCommand& OutCommand) const;
+
+	// apply a command to a simulation the way the game applied it, advancing the turn and team phase on EndPhase
+	static void ApplyCommand(const FMatchCommand& Command, const TArray<int32>& TeamOrder, FTileSimulation& Simulation, int32& InOutTurn, int32& InOutActiveTeamIndex);
+
+	// set the units of a simulation to how they were at the start of a turn, before any team acted in it
+	// the simulation's tiles must already be the match's. Returns false if the log doesn't reach the turn
+	bool FastForward(int32 TargetTurn, FTileSimulation& Simulation) const;
+
+	friend FArchive& operator<<(FArchive& Ar, FMatchLog& Log);
+
+private:
+	TArray<int32> TeamOrder;
+	int32 KeyframeInterval;
+	bool bRecording;
+
+	// the commands, packed
+	TArray<uint8> Data;
+	int32 CommandCount;
+
+	// turn and team phase at the end of the log
+	int32 Turn;
+	int32 ActiveTeamIndex;
+
+	// the units at the start of a turn and where the commands after it start
+	struct FKeyframe
+	{
+		int32 Turn;
+		int32 DataOffset;
+		TArray<uint8> Snapshot;
+
+		friend FArchive& operator<<(FArchive& Ar, FKeyframe& Keyframe)
+		{
+			return Ar << Keyframe.Turn << Keyframe.DataOffset << Keyframe.Snapshot;
+		}
+	};
+	TArray<FKeyframe> Keyframes;
+
+	void TakeKeyframe(FTileSimulation& Simulation);
+
+	// append to the packed commands. Signed values are zigzag encoded so small negative numbers stay small
+	void WriteCommandType(EMatchCommand Type);
+	void WriteUnsigned(uint32 Value);
+	void WriteSigned(int32 Value);
+	void WritePosition(const FIntVector& Position);
+	void WriteStats(const FUnitStatBlock& Stats);
+};
@@ -0,0 +1,678 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "MctsSearch.h"
+#include "TileSimulation.h"
+#include "Async/ParallelFor.h"
+#include "Async/TaskGraphInterfaces.h"
+#include "Math/RandomStream.h"
+
+// most nodes a worker's tree grows to. Past this rollouts still run from the leaves but no more nodes are added
+static const int32 MaxNodesPerWorker = 1 << 18;
+
+// ---------- Zobrist Keys ---------- //
+// the random key of each feature of a state is made by mixing the feature and its values (splitmix64) rather than read
+// from a table, so there is a key for every unit, cell and HP without tables sized to the map
+
+enum class EZobristFeature : uint64
+{
+	UnitCell,
+	UnitHitPoints,
+	UnitActed,
+	ActiveTeam
+};
+
+static FORCEINLINE uint64 ZobristKey(EZobristFeature Feature, uint32 A, uint32 B = 0)
+{
+	uint64 Key = ((uint64)A << 32 | B) + 0x9E3779B97F4A7C15ull * ((uint64)Feature + 1);
+	Key = (Key ^ (Key >> 30)) * 0xBF58476D1CE4E5B9ull;
+	Key = (Key ^ (Key >> 27)) * 0x94D049BB133111EBull;
+	return Key ^ (Key >> 31);
+}
+
+// ---------- AI Board State ---------- //
+
+void FAIBoardState::MakeAction(const FAIBoard& Board, const FAIAction& Action, FAIUndo& OutUndo)
+{
+	FAIUnit& Unit = Units[Action.UnitIndex];
+	OutUndo.Action = Action;
+	OutUndo.PreviousCell = Unit.Cell;
+	OutUndo.PreviousActedPhase = Unit.ActedPhase;
+	OutUndo.ActingUnit = ActingUnit;
+	OutUndo.ActiveTeamIndex = ActiveTeamIndex;
+	OutUndo.PhasesPlayed = PhasesPlayed;
+	OutUndo.Hash = Hash;
+
+	if (Action.MoveCell != Unit.Cell)
+	{
+		Hash ^= ZobristKey(EZobristFeature::UnitCell, Action.UnitIndex, Unit.Cell) ^ ZobristKey(EZobristFeature::UnitCell, Action.UnitIndex, Action.MoveCell);
+		Unit.Cell = Action.MoveCell;
+	}
+
+	if (Action.TargetUnit != INDEX_NONE)
+	{
+		FAIUnit& Target = Units[Action.TargetUnit];
+		OutUndo.TargetHitPoints = Target.HitPoints;
+		OutUndo.TargetCell = Target.Cell;
+
+		const int32 NewHitPoints = FMath::Max(Target.HitPoints - Board.GetDamage(Unit, Unit.Cell, Target), 0);
+		Hash ^= ZobristKey(EZobristFeature::UnitHitPoints, Action.TargetUnit, Target.HitPoints) ^ ZobristKey(EZobristFeature::UnitHitPoints, Action.TargetUnit, NewHitPoints);
+		Target.HitPoints = NewHitPoints;
+		if (NewHitPoints == 0)
+		{
+			Hash ^= ZobristKey(EZobristFeature::UnitCell, Action.TargetUnit, Target.Cell);
+			Target.Cell = INDEX_NONE;
+		}
+	}
+
+	Unit.ActedPhase = PhasesPlayed;
+	Hash ^= ZobristKey(EZobristFeature::UnitActed, Action.UnitIndex);
+	AdvanceActingUnit();
+}
+
+void FAIBoardState::UnmakeAction(const FAIUndo& Undo)
+{
+	FAIUnit& Unit = Units[Undo.Action.UnitIndex];
+	Unit.Cell = Undo.PreviousCell;
+	Unit.ActedPhase = Undo.PreviousActedPhase;
+
+	if (Undo.Action.TargetUnit != INDEX_NONE)
+	{
+		FAIUnit& Target = Units[Undo.Action.TargetUnit];
+		Target.HitPoints = Undo.TargetHitPoints;
+		Target.Cell = Undo.TargetCell;
+	}
+
+	// ending a phase only moves the phase on, so nothing more is needed to go back to an earlier phase
+	ActingUnit = Undo.ActingUnit;
+	ActiveTeamIndex = Undo.ActiveTeamIndex;
+	PhasesPlayed = Undo.PhasesPlayed;
+	Hash = Undo.Hash;
+}
+
+void FAIBoardState::AdvanceActingUnit()
+{
+	// the game is over once only one team in the turn order has units left
+	int32 TeamsLeft = 0;
+	for (int32 Team : TeamOrder)
+	{
+		if (Units.ContainsByPredicate([Team](const FAIUnit& Unit) { return Unit.Team == Team && Unit.Cell != INDEX_NONE; }))
+		{
+			TeamsLeft++;
+		}
+	}
+	if (TeamsLeft < 2)
+	{
+		ActingUnit = INDEX_NONE;
+		return;
+	}
+
+	// units of the active team act in the order they are in the state
+	for (;;)
+	{
+		const int32 Team = GetActiveTeam();
+		for (int32 UnitIndex = 0; UnitIndex < Units.Num(); UnitIndex++)
+		{
+			const FAIUnit& Unit = Units[UnitIndex];
+			if (Unit.Team == Team && Unit.Cell != INDEX_NONE && !HasActed(Unit))
+			{
+				ActingUnit = UnitIndex;
+				return;
+			}
+		}
+
+		// moving on a phase is enough for every unit to have not acted in it
+		for (int32 UnitIndex = 0; UnitIndex < Units.Num(); UnitIndex++)
+		{
+			if (HasActed(Units[UnitIndex]))
+			{
+				Hash ^= ZobristKey(EZobristFeature::UnitActed, UnitIndex);
+			}
+		}
+		const int32 NextTeamIndex = (ActiveTeamIndex + 1) % TeamOrder.Num();
+		Hash ^= ZobristKey(EZobristFeature::ActiveTeam, ActiveTeamIndex) ^ ZobristKey(EZobristFeature::ActiveTeam, NextTeamIndex);
+		ActiveTeamIndex = NextTeamIndex;
+		PhasesPlayed++;
+	}
+}
+
+uint64 FAIBoardState::ComputeHash() const
+{
+	uint64 NewHash = ZobristKey(EZobristFeature::ActiveTeam, ActiveTeamIndex);
+	for (int32 UnitIndex = 0; UnitIndex < Units.Num(); UnitIndex++)
+	{
+		const FAIUnit& Unit = Units[UnitIndex];
+		if (Unit.Cell != INDEX_NONE)
+		{
+			NewHash ^= ZobristKey(EZobristFeature::UnitCell, UnitIndex, Unit.Cell);
+		}
+		NewHash ^= ZobristKey(EZobristFeature::UnitHitPoints, UnitIndex, Unit.HitPoints);
+		if (HasActed(Unit))
+		{
+			NewHash ^= ZobristKey(EZobristFeature::UnitActed, UnitIndex);
+		}
+	}
+	return NewHash;
+}
+
+// ---------- AI Board ---------- //
+
+void FAIBoard::Build(const FTileSimulation& Simulation, const FAIAttackRules& NewRules, const TArray<int32>& TeamOrder, int32 ActiveTeamIndex, const TArray<int32>& ActedUnitIDs)
+{
+	Simulation.BuildPathGraph(Graph);
+	Rules = NewRules;
+
+	// the graph has the same layout as the tile grid so cells map across directly
+	const FTileTypeTable& TileTypes = Simulation.GetTileTypes();
+	AttackModifiers.Init(0, Graph.Num());
+	DefenseModifiers.Init(0, Graph.Num());
+	Simulation.GetTiles().ForEachTile([this, &TileTypes](int32 CellIndex, int32 TileTypeID)
+	{
+		if (const FTileTypeInfo* TypeInfo = TileTypes.Find(TileTypeID))
+		{
+			AttackModifiers[CellIndex] = TypeInfo->AttackModifier;
+			DefenseModifiers[CellIndex] = TypeInfo->DefenseModifier;
+		}
+	});
+
+	RootState = FAIBoardState();
+	RootState.TeamOrder = TeamOrder;
+	RootState.ActiveTeamIndex = ActiveTeamIndex;
+
+	const FUnitOccupancy& Occupancy = Simulation.GetUnits();
+	Occupancy.ForEachUnit([this, &Simulation, &Occupancy, &ActedUnitIDs](int32 UnitID)
+	{
+		const FSimUnit& SimUnit = Simulation.GetUnit(UnitID);
+		FAIUnit& Unit = RootState.Units.AddDefaulted_GetRef();
+		Unit.Cell = Graph.ToIndex(Occupancy.GetUnitPosition(UnitID));
+		Unit.Team = Occupancy.GetUnitTeam(UnitID);
+		Unit.HitPoints = SimUnit.HitPoints;
+		Unit.Movement = SimUnit.Stats.Get(ESimStat::Movement);
+		Unit.Damage = SimUnit.Stats.Get(ESimStat::Damage);
+		Unit.Armour = SimUnit.Stats.Get(ESimStat::Armour);
+		Unit.MagicResist = SimUnit.Stats.Get(ESimStat::MagicResist);
+		Unit.SourceUnitID = UnitID;
+		Unit.ActedPhase = ActedUnitIDs.Contains(UnitID) ? 0 : INDEX_NONE;
+	});
+
+	RootState.Hash = RootState.ComputeHash();
+	if (RootState.TeamOrder.IsValidIndex(ActiveTeamIndex))
+	{
+		RootState.AdvanceActingUnit();
+	}
+}
+
+int32 FAIBoard::GetDamage(const FAIUnit& Attacker, int32 AttackerCell, const FAIUnit& Target) const
+{
+	// the same rules as FTileSimulation::GetDamageDealt and GetDamageTaken
+	const int32 DamageDealt = Rules.RawDamage + Attacker.Damage + AttackModifiers[AttackerCell];
+	const int32 Mitigation = (Rules.bMagicDamage ? Target.MagicResist : Target.Armour) + DefenseModifiers[Target.Cell];
+	return FMath::Max(DamageDealt - Mitigation, 0);
+}
+
+int32 FAIBoard::GetDistance(int32 CellA, int32 CellB) const
+{
+	const FIntVector Offset = Graph.ToPosition(CellA) - Graph.ToPosition(CellB);
+	return FMath::Abs(Offset.X) + FMath::Abs(Offset.Y) + FMath::Abs(Offset.Z);
+}
+
+float FAIBoard::Evaluate(const FAIBoardState& State, int32 Team)
+{
+	int32 TeamHitPoints = 0;
+	int32 TotalHitPoints = 0;
+	for (const FAIUnit& Unit : State.Units)
+	{
+		if (Unit.Cell != INDEX_NONE)
+		{
+			TotalHitPoints += Unit.HitPoints;
+			if (Unit.Team == Team)
+			{
+				TeamHitPoints += Unit.HitPoints;
+			}
+		}
+	}
+
+	if (State.IsGameOver())
+	{
+		return TeamHitPoints > 0 ? 1.f : 0.f;
+	}
+	return TotalHitPoints > 0 ? (float)TeamHitPoints / TotalHitPoints : 0.f;
+}
+
+// ---------- MCTS Worker ---------- //
+// grows one tree from the root state. Owns everything it writes to, so workers never wait on each other
+
+class FMctsSearch::FWorker
+{
+public:
+	struct FNode
+	{
+		FAIAction Action; // the action that leads to this node from its parent
+		int32 Team; // team of the unit that took the action
+		int32 FirstChild; // children are contiguous, INDEX_NONE until the node is expanded
+		int32 NumChildren;
+		int32 NumUntried; // the last NumUntried children have not been visited yet
+		int32 Visits;
+		float TotalValue; // sum of the scores of the rollouts through the node, for the searching team
+		uint64 Hash; // hash of the state at the node, set once it has been visited
+	};
+
+	// the tree, the root first
+	TArray<FNode> Nodes;
+
+	int32 NumRollouts;
+
+	// search until the end time or until cancelled
+	void Run(const FAIBoard& InBoard, FTranspositionTable& InTable, const FMctsSettings& Settings, int32 Seed, double EndTime, const FThreadSafeBool* CancelFlag);
+
+private:
+	const FAIBoard* Board;
+
+	// shared with the other workers
+	FTranspositionTable* Table;
+
+	// copy of the board's graph with the units of the current state on it
+	FPathGraph Graph;
+	FTilePathfinder Pathfinder;
+	FMovementRange Range;
+	FRandomStream Random;
+
+	// the state the worker is at, reached from the root by the actions in the undo stack
+	FAIBoardState State;
+	TArray<FAIUndo> UndoStack;
+
+	// scratch buffers
+	TArray<FAIAction> Actions;
+	TArray<int32> StopCells;
+	TArray<int32> VisitedNodes;
+
+	// carry out an action on the current state, or take back the last one
+	void MakeAction(const FAIAction& Action);
+	void UnmakeAction();
+
+	// find the cells the acting unit can end its move on, starting with the cell it is on
+	void GatherStopCells();
+
+	// every action the acting unit can take
+	void GatherActions();
+
+	// add the children of a node for every action the acting unit can take, in a random order
+	void ExpandNode(int32 NodeIndex);
+
+	// the child of a fully expanded node with the best upper confidence bound for the team choosing
+	// a child's score is taken from the transposition table where more visits have been made to its state there
+	int32 SelectChild(int32 NodeIndex, int32 SearchTeam, float ExplorationConstant) const;
+
+	// the action a rollout takes for the acting unit: the attack that does the most damage, preferring kills, or
+	// failing that a move towards the nearest enemy
+	FAIAction ChooseRolloutAction();
+};
+
+void FMctsSearch::FWorker::Run(const FAIBoard& InBoard, FTranspositionTable& InTable, const FMctsSettings& Settings, int32 Seed, double EndTime, const FThreadSafeBool* CancelFlag)
+{
+	Board = &InBoard;
+	Table = InTable.IsEmpty() ? nullptr : &InTable;
+	Graph = InBoard.GetGraph();
+	State = InBoard.GetRootState();
+	UndoStack.Reset();
+	Random.Initialize(Seed);
+	NumRollouts = 0;
+
+	Nodes.Reset();
+	FNode& Root = Nodes.AddDefaulted_GetRef();
+	Root.Team = INDEX_NONE;
+	Root.FirstChild = INDEX_NONE;
+	Root.NumChildren = 0;
+	Root.NumUntried = 0;
+	Root.Visits = 0;
+	Root.TotalValue = 0.f;
+	Root.Hash = State.Hash;
+
+	const int32 SearchTeam = InBoard.GetRootState().GetActiveTeam();
+	while (FPlatformTime::Seconds() < EndTime && !(CancelFlag && *CancelFlag))
+	{
+		// go back up to the root
+		while (UndoStack.Num() > 0)
+		{
+			UnmakeAction();
+		}
+		VisitedNodes.Reset();
+		int32 NodeIndex = 0;
+		VisitedNodes.Add(NodeIndex);
+
+		// selection: walk down through nodes whose children have all been tried
+		while (!State.IsGameOver() && Nodes[NodeIndex].NumChildren > 0 && Nodes[NodeIndex].NumUntried == 0)
+		{
+			NodeIndex = SelectChild(NodeIndex, SearchTeam, Settings.ExplorationConstant);
+			MakeAction(Nodes[NodeIndex].Action);
+			VisitedNodes.Add(NodeIndex);
+		}
+
+		// expansion: try one new action
+		if (!State.IsGameOver())
+		{
+			if (Nodes[NodeIndex].FirstChild == INDEX_NONE && Nodes.Num() < MaxNodesPerWorker)
+			{
+				ExpandNode(NodeIndex);
+			}
+			if (Nodes[NodeIndex].NumUntried > 0)
+			{
+				const int32 ChildIndex = Nodes[NodeIndex].FirstChild + Nodes[NodeIndex].NumChildren - Nodes[NodeIndex].NumUntried;
+				Nodes[NodeIndex].NumUntried--;
+				MakeAction(Nodes[ChildIndex].Action);
+				Nodes[ChildIndex].Hash = State.Hash;
+				VisitedNodes.Add(ChildIndex);
+			}
+		}
+
+		// rollout: play on for a few team phases and score where the game ends up
+		const int32 EndPhase = State.PhasesPlayed + Settings.RolloutDepth;
+		while (!State.IsGameOver() && State.PhasesPlayed < EndPhase)
+		{
+			MakeAction(ChooseRolloutAction());
+		}
+		const float Value = FAIBoard::Evaluate(State, SearchTeam);
+
+		for (int32 VisitedIndex : VisitedNodes)
+		{
+			Nodes[VisitedIndex].Visits++;
+			Nodes[VisitedIndex].TotalValue += Value;
+			if (Table)
+			{
+				Table->AddVisit(Nodes[VisitedIndex].Hash, Value);
+			}
+		}
+		NumRollouts++;
+	}
+}
+
+void FMctsSearch::FWorker::MakeAction(const FAIAction& Action)
+{
+	FAIUndo& Undo = UndoStack.AddDefaulted_GetRef();
+	State.MakeAction(*Board, Action, Undo);
+	checkSlow(State.Hash == State.ComputeHash());
+
+	// keep the units on the graph in step with the state
+	const FAIUnit& Unit = State.Units[Action.UnitIndex];
+	if (Unit.Cell != Undo.PreviousCell)
+	{
+		Graph.OccupantTeams[Undo.PreviousCell] = INDEX_NONE;
+		Graph.OccupantTeams[Unit.Cell] = Unit.Team;
+	}
+	if (Action.TargetUnit != INDEX_NONE && State.Units[Action.TargetUnit].Cell == INDEX_NONE)
+	{
+		Graph.OccupantTeams[Undo.TargetCell] = INDEX_NONE;
+	}
+}
+
+void FMctsSearch::FWorker::UnmakeAction()
+{
+	const FAIUndo& Undo = UndoStack.Last();
+	const FAIUnit& Unit = State.Units[Undo.Action.UnitIndex];
+	if (Unit.Cell != Undo.PreviousCell)
+	{
+		Graph.OccupantTeams[Unit.Cell] = INDEX_NONE;
+		Graph.OccupantTeams[Undo.PreviousCell] = Unit.Team;
+	}
+	if (Undo.Action.TargetUnit != INDEX_NONE && State.Units[Undo.Action.TargetUnit].Cell == INDEX_NONE)
+	{
+		Graph.OccupantTeams[Undo.TargetCell] = State.Units[Undo.Action.TargetUnit].Team;
+	}
+
+	State.UnmakeAction(Undo);
+	UndoStack.Pop(false);
+}
+
+void FMctsSearch::FWorker::GatherStopCells()
+{
+	const FAIUnit& Unit = State.Units[State.ActingUnit];
+	Pathfinder.FindReachableTiles(Graph, Graph.ToPosition(Unit.Cell), Unit.Team, Unit.Movement, Range);
+
+	StopCells.Reset();
+	StopCells.Add(Unit.Cell);
+	for (const FReachableTile& Tile : Range.Tiles)
+	{
+		// tiles held by allies can be moved through but not ended on
+		if (Tile.bCanStop)
+		{
+			StopCells.Add(Graph.ToIndex(Tile.MapPosition));
+		}
+	}
+}
+
+void FMctsSearch::FWorker::GatherActions()
+{
+	GatherStopCells();
+
+	Actions.Reset();
+	const int32 Team = State.Units[State.ActingUnit].Team;
+	for (int32 StopCell : StopCells)
+	{
+		FAIAction& Move = Actions.AddDefaulted_GetRef();
+		Move.UnitIndex = State.ActingUnit;
+		Move.MoveCell = StopCell;
+
+		for (int32 TargetIndex = 0; TargetIndex < State.Units.Num(); TargetIndex++)
+		{
+			const FAIUnit& Target = State.Units[TargetIndex];
+			if (Target.Team != Team && Target.Cell != INDEX_NONE && Board->IsInRange(StopCell, Target.Cell))
+			{
+				FAIAction& Attack = Actions.AddDefaulted_GetRef();
+				Attack.UnitIndex = State.ActingUnit;
+				Attack.MoveCell = StopCell;
+				Attack.TargetUnit = TargetIndex;
+			}
+		}
+	}
+}
+
+void FMctsSearch::FWorker::ExpandNode(int32 NodeIndex)
+{
+	GatherActions();
+
+	// shuffle so the untried children are tried in a random order
+	for (int32 ActionIndex = Actions.Num() - 1; ActionIndex > 0; ActionIndex--)
+	{
+		Actions.Swap(ActionIndex, Random.RandRange(0, ActionIndex));
+	}
+
+	const int32 Team = State.Units[State.ActingUnit].Team;
+	const int32 FirstChild = Nodes.Num();
+	for (const FAIAction& Action : Actions)
+	{
+		FNode& Child = Nodes.AddDefaulted_GetRef();
+		Child.Action = Action;
+		Child.Team = Team;
+		Child.FirstChild = INDEX_NONE;
+		Child.NumChildren = 0;
+		Child.NumUntried = 0;
+		Child.Visits = 0;
+		Child.TotalValue = 0.f;
+		Child.Hash = 0;
+	}
+
+	FNode& Node = Nodes[NodeIndex];
+	Node.FirstChild = FirstChild;
+	Node.NumChildren = Actions.Num();
+	Node.NumUntried = Actions.Num();
+}
+
+int32 FMctsSearch::FWorker::SelectChild(int32 NodeIndex, int32 SearchTeam, float ExplorationConstant) const
+{
+	const FNode& Node = Nodes[NodeIndex];
+	const float LogVisits = FMath::Loge((float)Node.Visits);
+
+	int32 BestChild = Node.FirstChild;
+	float BestScore = -MAX_flt;
+	for (int32 ChildIndex = Node.FirstChild; ChildIndex < Node.FirstChild + Node.NumChildren; ChildIndex++)
+	{
+		// every other team is played as if it were trying to beat the searching team
+		const FNode& Child = Nodes[ChildIndex];
+		float Value = Child.TotalValue / Child.Visits;
+
+		// the table has every worker's visits to the state, from any line of play that reached it
+		int32 SharedVisits;
+		float SharedTotalValue;
+		if (Table && Table->Find(Child.Hash, SharedVisits, SharedTotalValue) && SharedVisits > Child.Visits)
+		{
+			Value = SharedTotalValue / SharedVisits;
+		}
+
+		const float Score = (Child.Team == SearchTeam ? Value : 1.f - Value) + ExplorationConstant * FMath::Sqrt(LogVisits / Child.Visits);
+		if (Score > BestScore)
+		{
+			BestScore = Score;
+			BestChild = ChildIndex;
+		}
+	}
+	return BestChild;
+}
+
+FAIAction FMctsSearch::FWorker::ChooseRolloutAction()
+{
+	GatherStopCells();
+
+	const FAIUnit& Unit = State.Units[State.ActingUnit];
+	FAIAction Action;
+	Action.UnitIndex = State.ActingUnit;
+	Action.MoveCell = Unit.Cell;
+
+	// the attack that does the most damage, counting a kill above any damage
+	int32 BestAttackScore = -1;
+	int32 NumBest = 0;
+	for (int32 StopCell : StopCells)
+	{
+		for (int32 TargetIndex = 0; TargetIndex < State.Units.Num(); TargetIndex++)
+		{
+			const FAIUnit& Target = State.Units[TargetIndex];
+			if (Target.Team == Unit.Team || Target.Cell == INDEX_NONE || !Board->IsInRange(StopCell, Target.Cell))
+			{
+				continue;
+			}
+			const int32 Damage = Board->GetDamage(Unit, StopCell, Target);
+			const int32 Score = Damage >= Target.HitPoints ? MAX_int32 : Damage;
+
+			// ties are broken at random, keeping each of them with equal chance
+			if (Score > BestAttackScore)
+			{
+				BestAttackScore = Score;
+				NumBest = 1;
+			}
+			else if (Score < BestAttackScore || Random.RandRange(0, NumBest++) != 0)
+			{
+				continue;
+			}
+			Action.MoveCell = StopCell;
+			Action.TargetUnit = TargetIndex;
+		}
+	}
+	if (Action.TargetUnit != INDEX_NONE)
+	{
+		return Action;
+	}
+
+	// nothing to attack, so mostly close in on the nearest enemy and sometimes wander
+	if (Random.FRand() < 0.25f)
+	{
+		Action.MoveCell = StopCells[Random.RandRange(0, StopCells.Num() - 1)];
+		return Action;
+	}
+	int32 BestDistance = MAX_int32;
+	for (int32 StopCell : StopCells)
+	{
+		for (const FAIUnit& Target : State.Units)
+		{
+			if (Target.Team != Unit.Team && Target.Cell != INDEX_NONE)
+			{
+				const int32 Distance = Board->GetDistance(StopCell, Target.Cell);
+				if (Distance < BestDistance)
+				{
+					BestDistance = Distance;
+					Action.MoveCell = StopCell;
+				}
+			}
+		}
+	}
+	return Action;
+}
+
+// ---------- MCTS Search ---------- //
+
+FMctsSearch::FMctsSearch()
+{
+}
+
+FMctsSearch::~FMctsSearch()
+{
+}
+
+FMctsResult FMctsSearch::Search(const FAIBoard& Board, const FMctsSettings& Settings, const FThreadSafeBool* CancelFlag)
+{
+	FMctsResult Result;
+	if (Board.GetRootState().IsGameOver())
+	{
+		return Result;
+	}
+
+	// the thread running the search works on a tree as well as the task graph's workers
+	const int32 NumWorkers = Settings.NumWorkers > 0 ? Settings.NumWorkers : FTaskGraphInterface::Get().GetNumWorkerThreads() + 1;
+	while (Workers.Num() < NumWorkers)
+	{
+		Workers.Add(MakeUnique<FWorker>());
+	}
+
+	// unit indices, and so the hashes, mean something different on every board
+	TranspositionTable.Reset(Settings.TranspositionTableBits);
+
+	const double StartTime = FPlatformTime::Seconds();
+	const double EndTime = StartTime + Settings.TimeBudgetSeconds;
+	ParallelFor(NumWorkers, [this, &Board, &Settings, EndTime, CancelFlag](int32 WorkerIndex)
+	{
+		Workers[WorkerIndex]->Run(Board, TranspositionTable, Settings, Settings.Seed + WorkerIndex, EndTime, CancelFlag);
+	});
+	Result.Seconds = FPlatformTime::Seconds() - StartTime;
+
+	// add up the visits to each action at the root of every tree. The trees shuffle their children, so match them by action
+	TArray<FAIAction> RootActions;
+	TArray<int32> RootVisits;
+	TArray<float> RootValues;
+	for (int32 WorkerIndex = 0; WorkerIndex < NumWorkers; WorkerIndex++)
+	{
+		const FWorker& Worker = *Workers[WorkerIndex];
+		Result.NumRollouts += Worker.NumRollouts;
+
+		const FWorker::FNode& Root = Worker.Nodes[0];
+		for (int32 ChildIndex = Root.FirstChild; ChildIndex < Root.FirstChild + Root.NumChildren; ChildIndex++)
+		{
+			const FWorker::FNode& Child = Worker.Nodes[ChildIndex];
+			if (Child.Visits == 0)
+			{
+				continue;
+			}
+			int32 ActionIndex = RootActions.IndexOfByKey(Child.Action);
+			if (ActionIndex == INDEX_NONE)
+			{
+				ActionIndex = RootActions.Add(Child.Action);
+				RootVisits.Add(0);
+				RootValues.Add(0.f);
+			}
+			RootVisits[ActionIndex] += Child.Visits;
+			RootValues[ActionIndex] += Child.TotalValue;
+		}
+	}
+
+	// the most visited action is the most robust choice
+	int32 BestAction = INDEX_NONE;
+	for (int32 ActionIndex = 0; ActionIndex < RootActions.Num(); ActionIndex++)
+	{
+		if (BestAction == INDEX_NONE || RootVisits[ActionIndex] > RootVisits[BestAction])
+		{
+			BestAction = ActionIndex;
+		}
+	}
+	if (BestAction != INDEX_NONE)
+	{
+		Result.Action = RootActions[BestAction];
+		Result.Value = RootValues[BestAction] / RootVisits[BestAction];
+	}
+	return Result;
+}
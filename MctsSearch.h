@@ -0,0 +1,256 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/ThreadSafeBool.h"
+#include "TilePathfinder.h"
+#include "TranspositionTable.h"
+
+class FTileSimulation;
+
+// how units attack when played by the AI. The game leaves the damage and shape of an attack to the caller, but the range
+// must be the turn manager's, which refuses attacks outside it
+struct FAIAttackRules
+{
+	FAIAttackRules()
+		: RawDamage(3)
+		, bMagicDamage(false)
+		, MinRange(1)
+		, MaxRange(1)
+	{}
+
+	int32 RawDamage;
+	bool bMagicDamage;
+
+	// manhattan distance to the target, through the layers as well
+	int32 MinRange;
+	int32 MaxRange;
+};
+
+// ---------- AI Board ---------- //
+
+// a unit in a board state
+struct FAIUnit
+{
+	int32 Cell; // cell the unit is on, INDEX_NONE once it has been killed
+	int32 Team;
+	int32 HitPoints;
+	int32 Movement;
+	int32 Damage;
+	int32 Armour;
+	int32 MagicResist;
+	int32 SourceUnitID; // occupancy ID of the unit in the simulation the board was copied from
+	int32 ActedPhase; // PhasesPlayed when the unit last took its action, INDEX_NONE if it hasn't since the board was copied
+};
+
+// what one unit does with its action: move to a cell, then attack another unit
+struct FAIAction
+{
+	FAIAction()
+		: UnitIndex(INDEX_NONE)
+		, MoveCell(INDEX_NONE)
+		, TargetUnit(INDEX_NONE)
+	{}
+
+	int32 UnitIndex; // index of the acting unit in the board state
+	int32 MoveCell; // cell the unit ends its move on, the cell it is on to stay put
+	int32 TargetUnit; // index of the unit attacked, INDEX_NONE to not attack
+
+	FORCEINLINE bool operator==(const FAIAction& Other) const
+	{
+		return UnitIndex == Other.UnitIndex && MoveCell == Other.MoveCell && TargetUnit == Other.TargetUnit;
+	}
+};
+
+class FAIBoard;
+
+// what an action changed, for it to be taken back
+struct FAIUndo
+{
+	FAIAction Action;
+
+	// the acting unit's cell and when it last acted before the action
+	int32 PreviousCell;
+	int32 PreviousActedPhase;
+
+	// the target's HP and cell before the attack
+	int32 TargetHitPoints;
+	int32 TargetCell;
+
+	// the rest of the state before the action
+	int32 ActingUnit;
+	int32 ActiveTeamIndex;
+	int32 PhasesPlayed;
+	uint64 Hash;
+};
+
+// the parts of a game that change as it is played. Actions are made and unmade in place, recording only what they change,
+// so a search can go back up its tree without copying the state. Every change also updates a 64-bit zobrist hash of the
+// state, so states reached along different lines of play can be recognised as the same in a few cycles
+struct FAIBoardState
+{
+	FAIBoardState()
+		: ActiveTeamIndex(0)
+		, ActingUnit(INDEX_NONE)
+		, PhasesPlayed(0)
+		, Hash(0)
+	{}
+
+	TArray<FAIUnit> Units;
+
+	// teams in the order they take their phases
+	TArray<int32> TeamOrder;
+	int32 ActiveTeamIndex;
+
+	// index of the unit whose action is next, INDEX_NONE once the game is over
+	int32 ActingUnit;
+
+	// number of team phases that have ended since the state was copied from the game
+	int32 PhasesPlayed;
+
+	// zobrist hash of each unit's cell, HP and whether it has acted this phase, and of the active team
+	// PhasesPlayed is left out, as it doesn't change how the game can go on
+	uint64 Hash;
+
+	FORCEINLINE bool IsGameOver() const { return ActingUnit == INDEX_NONE; }
+	FORCEINLINE int32 GetActiveTeam() const { return TeamOrder[ActiveTeamIndex]; }
+
+	// whether a unit has taken its action in the current team phase
+	FORCEINLINE bool HasActed(const FAIUnit& Unit) const { return Unit.ActedPhase == PhasesPlayed; }
+
+	// carry out an action of the acting unit and move on to the next unit to act, recording what changed in the undo
+	void MakeAction(const FAIBoard& Board, const FAIAction& Action, FAIUndo& OutUndo);
+
+	// take back an action. Actions must be unmade in the reverse of the order they were made
+	void UnmakeAction(const FAIUndo& Undo);
+
+	// move on to the next unit to act, ending team phases with no units left to act, or to the end of the game
+	void AdvanceActingUnit();
+
+	// work the hash out from scratch rather than from the changes
+	uint64 ComputeHash() const;
+};
+
+// the parts of a game that don't change as it is played, shared by every board state searched from it
+// units move through allies but not enemies and attacks use the attack and defense modifiers of the tiles, as in the game
+class FAIBoard
+{
+public:
+	// copy the terrain and the units of a game. The active team's units with their IDs in ActedUnitIDs have already acted
+	void Build(const FTileSimulation& Simulation, const FAIAttackRules& NewRules, const TArray<int32>& TeamOrder, int32 ActiveTeamIndex, const TArray<int32>& ActedUnitIDs);
+
+	// the state of the game when the board was built
+	FORCEINLINE const FAIBoardState& GetRootState() const { return RootState; }
+
+	// the terrain. The units on each cell are those of the root state
+	FORCEINLINE const FPathGraph& GetGraph() const { return Graph; }
+
+	FORCEINLINE const FAIAttackRules& GetRules() const { return Rules; }
+
+	// damage an attack does to a unit if the attacker is on a cell, after every modifier
+	int32 GetDamage(const FAIUnit& Attacker, int32 AttackerCell, const FAIUnit& Target) const;
+
+	// manhattan distance between two cells, through the layers as well
+	int32 GetDistance(int32 CellA, int32 CellB) const;
+
+	// whether a unit on one cell can attack a unit on another
+	FORCEINLINE bool IsInRange(int32 FromCell, int32 ToCell) const
+	{
+		const int32 Distance = GetDistance(FromCell, ToCell);
+		return Distance >= Rules.MinRange && Distance <= Rules.MaxRange;
+	}
+
+	// score of a state for a team between 0 and 1: 1 if the team has won, 0 if it has lost, otherwise its share of the HP
+	// of every unit left
+	static float Evaluate(const FAIBoardState& State, int32 Team);
+
+private:
+	FPathGraph Graph;
+	FAIAttackRules Rules;
+
+	// attack and defense modifiers of the tile on each cell
+	TArray<int32> AttackModifiers;
+	TArray<int32> DefenseModifiers;
+
+	FAIBoardState RootState;
+};
+
+// ---------- MCTS Search ---------- //
+
+struct FMctsSettings
+{
+	FMctsSettings()
+		: TimeBudgetSeconds(1.f)
+		, NumWorkers(0)
+		, RolloutDepth(4)
+		, ExplorationConstant(1.41f)
+		, Seed(0)
+		, TranspositionTableBits(18)
+	{}
+
+	// how long to search for
+	float TimeBudgetSeconds;
+
+	// number of trees searched at once, 0 for one per core
+	int32 NumWorkers;
+
+	// number of team phases a rollout plays past the end of the tree before the state is scored
+	int32 RolloutDepth;
+
+	// weight of exploring little visited actions over the best ones so far
+	float ExplorationConstant;
+
+	// seed of the first worker's random stream, the others follow on from it
+	int32 Seed;
+
+	// the workers share statistics through a table of 2^TranspositionTableBits states, 0 for no table
+	int32 TranspositionTableBits;
+};
+
+struct FMctsResult
+{
+	FMctsResult()
+		: Value(0.f)
+		, NumRollouts(0)
+		, Seconds(0.0)
+	{}
+
+	// the most visited action at the root, for the unit whose action is next. Invalid if the game is over
+	FAIAction Action;
+
+	// average score of the action for the searching team
+	float Value;
+
+	int32 NumRollouts;
+	double Seconds;
+
+	FORCEINLINE float GetRolloutsPerSecond() const { return Seconds > 0.0 ? (float)(NumRollouts / Seconds) : 0.f; }
+};
+
+// monte carlo tree search for the next action of the active team, played from a board's root state.
+// Every worker grows its own tree from the root for the whole time budget (root parallelism), each with its own copy of the
+// graph, pathfinder and random stream. Workers walk their one board state down the tree and back with make and unmake.
+// The scores of the states each rollout passes through also go into a transposition table shared by every worker, and
+// actions are chosen by the score of the state they lead to across all the trees once it has been visited more there than
+// in the worker's own tree. The visits to each action at the root are summed across the trees to pick the action.
+// Rollouts attack where they can and otherwise close in on the enemy.
+// One search runs at a time. The scratch memory of the workers and the table are kept between searches
+
+class FMctsSearch
+{
+public:
+	// ctor
+	FMctsSearch();
+	~FMctsSearch();
+
+	// search for the best action for the unit whose action is next in the board's root state
+	// the search gives up early and returns what it has so far once the cancel flag is set
+	FMctsResult Search(const FAIBoard& Board, const FMctsSettings& Settings, const FThreadSafeBool* CancelFlag = nullptr);
+
+private:
+	class FWorker;
+	TArray<TUniquePtr<FWorker>> Workers;
+
+	FTranspositionTable TranspositionTable;
+};
@@ -15,6 +15,9 @@ APlayerPawn::APlayerPawn(const FObjectInitializer& ObjectInitializer)
 	: Super(ObjectInitializer)
 {
 	StartTilePosition = FIntVector(0,0,0);
+	PreviewedTilePosition = FIntVector(0,0,0);
+	bHasPreviewedTile = false;
+	bPickWithGridRaycast = true;
 	AutoPossessPlayer = EAutoReceiveInput::Player0;
 }
 
@@ -25,6 +28,9 @@ void APlayerPawn::Tick(float DeltaSeconds)
 	// only do tracing for tiles if there is a map connected
 	if (Map)
 	{
+		// the camera looks straight down on the pawn, so stream the map in around it
+		Map->UpdateStreaming(GetActorLocation());
+
 		if (APlayerController* PC = Cast<APlayerController>(GetController()))
 		{
 			if (UHeadMountedDisplayFunctionLibrary::IsHeadMountedDisplayEnabled())
@@ -70,10 +76,47 @@ void APlayerPawn::OnResetVR()
 void APlayerPawn::TriggerClick()
 {
 	StartTilePosition = Map->FocusedTile.MapPosition;
+
+	// search out from the new start tile once, every hover then reads its path from this tree
+	// the old tree no longer applies so the preview is empty until the new one arrives
+	PathPreviewTree.Reset();
+	Map->ClearHighlightLayer(ETileHighlightLayer::Path);
+	ResetPathPreview();
+	RequestPathPreviewTree();
 }
 
 void APlayerPawn::TraceForBlock(const FVector& Start, const FVector& End, bool bDrawDebugHelpers)
 {
+	FIntVector HitTilePosition;
+	if (PickTile(Start, End, bDrawDebugHelpers, HitTilePosition))
+	{
+		PreviewPathTo(HitTilePosition);
+		return;
+	}
+
+	// not hovering over a tile so clear the preview
+	if (bHasPreviewedTile)
+	{
+		Map->ClearHighlightLayer(ETileHighlightLayer::Path);
+		ResetPathPreview();
+	}
+	Map->UnsetFocusTile();
+}
+
+bool APlayerPawn::PickTile(const FVector& Start, const FVector& End, bool bDrawDebugHelpers, FIntVector& OutTilePosition) const
+{
+	if (bPickWithGridRaycast)
+	{
+		const bool bHit = Map->PickTile(Start, End, OutTilePosition);
+		if (bDrawDebugHelpers)
+		{
+			const FVector HitLocation = bHit ? Map->MapToWorldCoordinates(OutTilePosition) : End;
+			DrawDebugLine(GetWorld(), Start, HitLocation, FColor::Red);
+			DrawDebugSolidBox(GetWorld(), HitLocation, FVector(20.0f), FColor::Red);
+		}
+		return bHit;
+	}
+
 	FHitResult HitResult;
 	GetWorld()->LineTraceSingleByChannel(HitResult, Start, End, ECC_GameTraceChannel1);
 	if (bDrawDebugHelpers)
@@ -83,30 +126,58 @@ void APlayerPawn::TraceForBlock(const FVector& Start, const FVector& End, bool b
 	}
 	if (HitResult.Actor.IsValid())
 	{
-		FIntVector HitTilePosition = Map->WorldToMapCoordinates(HitResult.ImpactPoint);
-		Map->ClearHighlightedTiles();
-		if (Map->Tiles.Contains(HitTilePosition))
-		{
-			Map->SelectFocusTile(*Map->Tiles.Find(HitTilePosition));
+		OutTilePosition = Map->WorldToMapCoordinates(HitResult.ImpactPoint);
+		return Map->HasTile(OutTilePosition);
+	}
+	return false;
+}
 
-			TArray<FIntVector> Path = Map->GetShortestPath(StartTilePosition, HitTilePosition, 0);
+void APlayerPawn::PreviewPathTo(const FIntVector& HoveredTilePosition)
+{
+	// the tree is out of date if tiles or units have changed since it was built. Keep showing the old one until the new one arrives
+	const bool bTreeOutOfDate = !PathPreviewTree.IsValid() || PathPreviewTree.GraphVersion != Map->GetPathGraphVersion();
+	const bool bRequestOutOfDate = !PathPreviewQuery.IsValid() || PathPreviewQuery->GetGraphVersion() != Map->GetPathGraphVersion();
+	if (bTreeOutOfDate && bRequestOutOfDate)
+	{
+		RequestPathPreviewTree();
+	}
 
-			for (auto Pos : Path)
-			{
-				FTile* PotentialTile = Map->Tiles.Find(Pos);
-				if (PotentialTile)
-				{
-					Map->AddMoveableTile(*PotentialTile);
-				}
-			}
-		}
-		else
-		{
-			Map->UnsetFocusTile();
-		}
+	// nothing to do while the cursor stays on the same tile
+	if (bHasPreviewedTile && PreviewedTilePosition == HoveredTilePosition)
+	{
+		return;
 	}
-	else
+	PreviewedTilePosition = HoveredTilePosition;
+	bHasPreviewedTile = true;
+
+	FTile HoveredTile;
+	Map->GetTile(HoveredTilePosition, HoveredTile);
+	Map->SelectFocusTile(HoveredTile);
+
+	// consecutive paths mostly share tiles, so the highlight layer only moves the instances that changed
+	PathPreviewTree.GetPathTo(HoveredTilePosition, PathPreviewTiles);
+	Map->SetHighlightedTiles(ETileHighlightLayer::Path, PathPreviewTiles);
+}
+
+void APlayerPawn::ResetPathPreview()
+{
+	bHasPreviewedTile = false;
+}
+
+void APlayerPawn::RequestPathPreviewTree()
+{
+	// a newer request always supersedes an older one
+	if (PathPreviewQuery.IsValid())
 	{
-		Map->UnsetFocusTile();
+		PathPreviewQuery->Cancel();
 	}
-}
\ No newline at end of file
+	PathPreviewQuery = Map->BuildPathTreeAsync(StartTilePosition, 0, FOnAsyncPathTreeBuilt::CreateUObject(this, &APlayerPawn::OnPathPreviewTreeBuilt));
+}
+
+void APlayerPawn::OnPathPreviewTreeBuilt(FPathTree& Tree)
+{
+	PathPreviewTree = MoveTemp(Tree);
+
+	// redraw the preview for the hovered tile on the next tick
+	ResetPathPreview();
+}
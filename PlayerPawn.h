@@ -4,6 +4,8 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Pawn.h"
+#include "TilePathfinder.h"
+#include "AsyncPathQuery.h"
 #include "PlayerPawn.generated.h"
 
 UCLASS(config=Game)
@@ -16,6 +18,9 @@ public:
 	class ATileMap* Map;
 	UPROPERTY(VisibleAnywhere)
 	FIntVector StartTilePosition;
+	// find the hovered tile by walking the cursor ray through the tile grid rather than tracing against the tile meshes
+	UPROPERTY(EditAnywhere)
+	bool bPickWithGridRaycast;
 
 	virtual void Tick(float DeltaSeconds) override;
 
@@ -28,6 +33,34 @@ protected:
 	void TriggerClick();
 	void TraceForBlock(const FVector& Start, const FVector& End, bool bDrawDebugHelpers);
 
+	// find the tile under the segment from Start to End. Returns false if there isn't one
+	bool PickTile(const FVector& Start, const FVector& End, bool bDrawDebugHelpers, FIntVector& OutTilePosition) const;
+
+	// show the path from the start tile to the hovered tile. Does nothing if the hovered tile hasn't changed
+	void PreviewPathTo(const FIntVector& HoveredTilePosition);
+
+	// forget the hovered tile so the next hover redraws the path preview
+	void ResetPathPreview();
+
+	// start building the path preview tree from the start tile on a worker thread, superseding any build in progress
+	void RequestPathPreviewTree();
+
+	// receives the path preview tree on the game thread
+	void OnPathPreviewTreeBuilt(FPathTree& Tree);
+
+	// path preview tree build in progress, if any
+	FAsyncPathQueryHandle PathPreviewQuery;
+
+	// shortest path tree from the start tile, built asynchronously when the start tile is set. Hover paths are read from it
+	FPathTree PathPreviewTree;
+
+	// tile the current path preview leads to
+	FIntVector PreviewedTilePosition;
+	bool bHasPreviewedTile;
+
+	// tiles of the previewed path, kept between hovers to avoid reallocating
+	TArray<FIntVector> PathPreviewTiles;
+
 	//UPROPERTY(EditInstanceOnly, BlueprintReadWrite)
 	//class ATile* CurrentTileFocus;
 };
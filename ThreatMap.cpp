@@ -0,0 +1,216 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ThreatMap.h"
+#include "TileSimulation.h"
+
+FThreatMap::FThreatMap()
+	: Size(0, 0, 0)
+	, bAllDirty(true)
+	, RawDamage(0)
+	, Stamp(0)
+{
+}
+
+void FThreatMap::SetAttack(const TArray<FIntVector>& NewAttackStencil, int32 NewRawDamage)
+{
+	AttackStencil = NewAttackStencil;
+	RawDamage = NewRawDamage;
+	MarkAllDirty();
+}
+
+void FThreatMap::MarkUnitDirty(int32 UnitID)
+{
+	if (UnitID < 0)
+	{
+		return;
+	}
+	if (UnitID >= Footprints.Num())
+	{
+		Footprints.SetNum(UnitID + 1);
+	}
+	if (!Footprints[UnitID].bDirty)
+	{
+		Footprints[UnitID].bDirty = true;
+		DirtyUnits.Add(UnitID);
+	}
+}
+
+void FThreatMap::MarkCellChanged(const FIntVector& MapPosition)
+{
+	for (int32 UnitID = 0; UnitID < Footprints.Num(); UnitID++)
+	{
+		const FFootprint& Footprint = Footprints[UnitID];
+		if (!Footprint.bDirty
+			&& MapPosition.X >= Footprint.ReachMin.X && MapPosition.X <= Footprint.ReachMax.X
+			&& MapPosition.Y >= Footprint.ReachMin.Y && MapPosition.Y <= Footprint.ReachMax.Y
+			&& MapPosition.Z >= Footprint.ReachMin.Z && MapPosition.Z <= Footprint.ReachMax.Z)
+		{
+			MarkUnitDirty(UnitID);
+		}
+	}
+}
+
+void FThreatMap::MarkAllDirty()
+{
+	bAllDirty = true;
+}
+
+void FThreatMap::Update(const FTileSimulation& Simulation, const FPathGraph& Graph, FTilePathfinder& Pathfinder)
+{
+	// every cell index changes with the size of the map
+	if (Graph.Size != Size)
+	{
+		Reset(Graph.Size);
+	}
+
+	const FUnitOccupancy& Units = Simulation.GetUnits();
+	if (bAllDirty)
+	{
+		bAllDirty = false;
+
+		// the units with a footprint may have left, and the units on the map may not have one yet
+		for (int32 UnitID = 0; UnitID < Footprints.Num(); UnitID++)
+		{
+			if (Footprints[UnitID].Team != INDEX_NONE)
+			{
+				MarkUnitDirty(UnitID);
+			}
+		}
+		Units.ForEachUnit([this](int32 UnitID)
+		{
+			MarkUnitDirty(UnitID);
+		});
+	}
+
+	for (int32 UnitID : DirtyUnits)
+	{
+		FFootprint& Footprint = Footprints[UnitID];
+		ApplyFootprint(Footprint, -1);
+		if (Units.IsValidUnit(UnitID))
+		{
+			BuildFootprint(Simulation, Graph, Pathfinder, UnitID, Footprint);
+			ApplyFootprint(Footprint, 1);
+		}
+		else
+		{
+			Footprint = FFootprint();
+		}
+		Footprint.bDirty = false;
+	}
+	DirtyUnits.Reset();
+}
+
+int32 FThreatMap::GetThreat(int32 Team, const FIntVector& MapPosition) const
+{
+	const FTeamGrids* Grids = TeamGrids.Find(Team);
+	return Grids && IsValidPosition(MapPosition) ? Grids->Threat[ToIndex(MapPosition)] : 0;
+}
+
+int32 FThreatMap::GetInfluence(int32 Team, const FIntVector& MapPosition) const
+{
+	const FTeamGrids* Grids = TeamGrids.Find(Team);
+	return Grids && IsValidPosition(MapPosition) ? Grids->Influence[ToIndex(MapPosition)] : 0;
+}
+
+const TArray<int32>* FThreatMap::GetThreatGrid(int32 Team) const
+{
+	const FTeamGrids* Grids = TeamGrids.Find(Team);
+	return Grids ? &Grids->Threat : nullptr;
+}
+
+const TArray<int32>* FThreatMap::GetInfluenceGrid(int32 Team) const
+{
+	const FTeamGrids* Grids = TeamGrids.Find(Team);
+	return Grids ? &Grids->Influence : nullptr;
+}
+
+void FThreatMap::Reset(const FIntVector& NewSize)
+{
+	Size = NewSize;
+	TeamGrids.Reset();
+	Footprints.Reset();
+	DirtyUnits.Reset();
+	CellStamps.Init(0, Size.X * Size.Y * Size.Z);
+	Stamp = 0;
+	bAllDirty = true;
+}
+
+void FThreatMap::ApplyFootprint(const FFootprint& Footprint, int32 Sign)
+{
+	if (Footprint.Team == INDEX_NONE)
+	{
+		return;
+	}
+
+	FTeamGrids& Grids = TeamGrids.FindOrAdd(Footprint.Team);
+	if (Grids.Threat.Num() == 0)
+	{
+		Grids.Threat.Init(0, CellStamps.Num());
+		Grids.Influence.Init(0, CellStamps.Num());
+	}
+
+	const int32 Damage = Footprint.Damage * Sign;
+	for (int32 CellIndex : Footprint.Cells)
+	{
+		Grids.Threat[CellIndex] += Sign;
+		Grids.Influence[CellIndex] += Damage;
+	}
+}
+
+void FThreatMap::BuildFootprint(const FTileSimulation& Simulation, const FPathGraph& Graph, FTilePathfinder& Pathfinder, int32 UnitID, FFootprint& OutFootprint)
+{
+	const FUnitOccupancy& Units = Simulation.GetUnits();
+	const FTileGrid& Tiles = Simulation.GetTiles();
+	const FSimUnit& Unit = Simulation.GetUnit(UnitID);
+	const FIntVector Start = Units.GetUnitPosition(UnitID);
+
+	// the unit's damage doesn't include the attack modifier of its tile, as it could attack from any of the tiles it reaches
+	OutFootprint.Team = Units.GetUnitTeam(UnitID);
+	OutFootprint.Damage = FMath::Max(RawDamage + Unit.Stats.Get(ESimStat::Damage), 0);
+	OutFootprint.Cells.Reset();
+
+	// a new stamp marks every cell as not yet in this footprint, clearing the stamps only when it wraps around
+	if (++Stamp == 0)
+	{
+		FMemory::Memzero(CellStamps.GetData(), CellStamps.Num() * sizeof(uint32));
+		Stamp = 1;
+	}
+
+	auto AddAttacksFrom = [this, &Tiles, &OutFootprint](const FIntVector& SourcePosition)
+	{
+		for (const FIntVector& Offset : AttackStencil)
+		{
+			const FIntVector MapPosition = SourcePosition + Offset;
+			if (Tiles.HasTile(MapPosition))
+			{
+				const int32 CellIndex = ToIndex(MapPosition);
+				if (CellStamps[CellIndex] != Stamp)
+				{
+					CellStamps[CellIndex] = Stamp;
+					OutFootprint.Cells.Add(CellIndex);
+				}
+			}
+		}
+	};
+
+	// the unit can attack from where it is or from any tile it can stop on
+	AddAttacksFrom(Start);
+	Pathfinder.FindReachableTiles(Graph, Start, OutFootprint.Team, Unit.Stats.Get(ESimStat::Movement), MovementRange);
+
+	FIntVector ReachMin = Start;
+	FIntVector ReachMax = Start;
+	for (const FReachableTile& Tile : MovementRange.Tiles)
+	{
+		// tiles held by allies are passed through, so they bound the reach even though they can't be attacked from
+		ReachMin = FIntVector(FMath::Min(ReachMin.X, Tile.MapPosition.X), FMath::Min(ReachMin.Y, Tile.MapPosition.Y), FMath::Min(ReachMin.Z, Tile.MapPosition.Z));
+		ReachMax = FIntVector(FMath::Max(ReachMax.X, Tile.MapPosition.X), FMath::Max(ReachMax.Y, Tile.MapPosition.Y), FMath::Max(ReachMax.Z, Tile.MapPosition.Z));
+		if (Tile.bCanStop)
+		{
+			AddAttacksFrom(Tile.MapPosition);
+		}
+	}
+
+	// the cells next to the reach are where a unit leaving could open up a path, or a unit arriving could block one
+	OutFootprint.ReachMin = ReachMin - FIntVector(1, 1, 1);
+	OutFootprint.ReachMax = ReachMax + FIntVector(1, 1, 1);
+}
@@ -0,0 +1,130 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TilePathfinder.h"
+
+class FTileSimulation;
+
+// ---------- Threat Map ---------- //
+// for each team, how many of its units could attack each tile next turn (the threat) and how much damage they could deal
+// there between them (the influence). A unit's footprint is every tile its attack reaches from anywhere it can move to. The
+// footprint of each unit is kept, so when a unit moves, dies or changes stats its old footprint is taken off the grids and
+// its new one added, and the rest of the board is left alone. Moving one unit can open up or block the paths of the units
+// around it, so a change to a cell also refreshes every unit whose movement reached next to that cell.
+// Changes are only flagged as they happen. The footprints are worked out when Update is next called, so a turn of several
+// changes costs one refresh per unit. Reading a tile is then a single array read
+
+class FThreatMap
+{
+public:
+	// ctor
+	FThreatMap();
+
+	// the attack every unit is assumed to have: the tiles it reaches as a stencil from FTileStencils, and its raw damage
+	// before the unit's damage stat. Refreshes every unit
+	void SetAttack(const TArray<FIntVector>& NewAttackStencil, int32 NewRawDamage);
+
+	// flag a unit for refreshing, such as after its movement or damage stat changes
+	void MarkUnitDirty(int32 UnitID);
+
+	// flag every unit whose movement reached next to a cell, after the unit or tile on it changes
+	void MarkCellChanged(const FIntVector& MapPosition);
+
+	// flag every unit, such as after the tiles are rebuilt
+	void MarkAllDirty();
+
+	// refresh the footprint of every flagged unit from the simulation and its path graph. Units that have left the
+	// simulation have their footprint taken away
+	void Update(const FTileSimulation& Simulation, const FPathGraph& Graph, FTilePathfinder& Pathfinder);
+
+	// whether there are changes that Update has not applied yet
+	FORCEINLINE bool IsDirty() const { return bAllDirty || DirtyUnits.Num() > 0; }
+
+	// ---------- Queries ---------- //
+	// these read the grids as of the last Update
+
+	// number of the team's units that could attack a tile next turn. 0 outside the map
+	int32 GetThreat(int32 Team, const FIntVector& MapPosition) const;
+
+	// total damage the team's units could deal to a tile next turn, before the target's mitigation. 0 outside the map
+	int32 GetInfluence(int32 Team, const FIntVector& MapPosition) const;
+
+	// the team's grids, in the layout of the tile grid, for reading many tiles. nullptr if the team has no units
+	const TArray<int32>* GetThreatGrid(int32 Team) const;
+	const TArray<int32>* GetInfluenceGrid(int32 Team) const;
+
+private:
+	// the grids of one team, indexed by cell
+	struct FTeamGrids
+	{
+		TArray<int32> Threat;
+		TArray<int32> Influence;
+	};
+
+	// what a unit has added to its team's grids
+	struct FFootprint
+	{
+		FFootprint()
+			: Team(INDEX_NONE)
+			, Damage(0)
+			, ReachMin(0, 0, 0)
+			, ReachMax(-1, -1, -1)
+			, bDirty(false)
+		{}
+
+		int32 Team;
+		int32 Damage;
+
+		// box around every cell the unit's movement reached, grown by a cell. Changes outside it can't alter the footprint
+		FIntVector ReachMin;
+		FIntVector ReachMax;
+
+		// cells the unit could attack, each once
+		TArray<int32> Cells;
+
+		bool bDirty;
+	};
+
+	FIntVector Size;
+	TMap<int32, FTeamGrids> TeamGrids;
+
+	// footprint of each unit, indexed by occupancy ID
+	TArray<FFootprint> Footprints;
+
+	// units flagged since the last Update
+	TArray<int32> DirtyUnits;
+	bool bAllDirty;
+
+	TArray<FIntVector> AttackStencil;
+	int32 RawDamage;
+
+	// stamp of the last footprint each cell was added to, so a cell reached from several tiles is only counted once
+	TArray<uint32> CellStamps;
+	uint32 Stamp;
+
+	// scratch memory for the movement range of the unit being refreshed
+	FMovementRange MovementRange;
+
+	// size the grids to the map, forgetting every footprint
+	void Reset(const FIntVector& NewSize);
+
+	// add or take away a footprint from its team's grids
+	void ApplyFootprint(const FFootprint& Footprint, int32 Sign);
+
+	// work out a unit's footprint from where it can move to
+	void BuildFootprint(const FTileSimulation& Simulation, const FPathGraph& Graph, FTilePathfinder& Pathfinder, int32 UnitID, FFootprint& OutFootprint);
+
+	FORCEINLINE bool IsValidPosition(const FIntVector& MapPosition) const
+	{
+		return MapPosition.X >= 0 && MapPosition.X < Size.X
+			&& MapPosition.Y >= 0 && MapPosition.Y < Size.Y
+			&& MapPosition.Z >= 0 && MapPosition.Z < Size.Z;
+	}
+
+	FORCEINLINE int32 ToIndex(const FIntVector& MapPosition) const
+	{
+		return MapPosition.Z + (MapPosition.X + MapPosition.Y * Size.X) * Size.Z;
+	}
+};
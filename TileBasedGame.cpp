@@ -3,4 +3,6 @@
 #include "TileBasedGame.h"
 #include "Modules/ModuleManager.h"
 
+DEFINE_LOG_CATEGORY(LogTileBasedGame);
+
 IMPLEMENT_PRIMARY_GAME_MODULE(FDefaultGameModuleImpl, TileBasedGame, "TileBasedGame");
@@ -0,0 +1,112 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "TileChunks.h"
+#include "TileTypeTable.h"
+
+FTileChunks::FTileChunks()
+	: ChunkSize(1)
+	, GridSize(0, 0, 0)
+	, NumChunks(0, 0)
+{
+}
+
+void FTileChunks::Reset(const FIntVector& NewGridSize, int32 NewChunkSize)
+{
+	ChunkSize = FMath::Max(NewChunkSize, 1);
+	GridSize = NewGridSize;
+	NumChunks = FIntPoint(FMath::DivideAndRoundUp(GridSize.X, ChunkSize), FMath::DivideAndRoundUp(GridSize.Y, ChunkSize));
+
+	Summaries.Reset();
+	Summaries.SetNum(NumChunks.X * NumChunks.Y);
+	DirtySummaries.Init(true, Summaries.Num());
+}
+
+void FTileChunks::MarkPositionDirty(const FIntVector& MapPosition)
+{
+	const FIntPoint Chunk = ToChunk(MapPosition);
+	if (IsValidChunk(Chunk))
+	{
+		DirtySummaries[ToChunkIndex(Chunk)] = true;
+	}
+}
+
+void FTileChunks::MarkAllDirty()
+{
+	DirtySummaries.Init(true, Summaries.Num());
+}
+
+const FTileChunkSummary& FTileChunks::GetSummary(const FIntPoint& Chunk, const FTileGrid& Grid, const FTileTypeTable& TypeTable)
+{
+	check(IsValidChunk(Chunk));
+	const int32 ChunkIndex = ToChunkIndex(Chunk);
+	FTileChunkSummary& Summary = Summaries[ChunkIndex];
+	if (!DirtySummaries[ChunkIndex])
+	{
+		return Summary;
+	}
+	DirtySummaries[ChunkIndex] = false;
+
+	Summary = FTileChunkSummary();
+	const int32 MaxX = FMath::Min((Chunk.X + 1) * ChunkSize, Grid.GetSize().X);
+	const int32 MaxY = FMath::Min((Chunk.Y + 1) * ChunkSize, Grid.GetSize().Y);
+	for (int32 Z = 0; Z < Grid.GetSize().Z; Z++)
+	{
+		for (int32 Y = Chunk.Y * ChunkSize; Y < MaxY; Y++)
+		{
+			for (int32 X = Chunk.X * ChunkSize; X < MaxX; X++)
+			{
+				const int32 TileTypeID = Grid.GetTileTypeID(FIntVector(X, Y, Z));
+				if (TileTypeID == INDEX_NONE)
+				{
+					continue;
+				}
+				Summary.NumTiles++;
+				const int32 MoveCost = TypeTable.GetMoveCost(TileTypeID);
+				if (MoveCost != INDEX_NONE)
+				{
+					Summary.NumPassable++;
+					Summary.MinMoveCost = Summary.MinMoveCost == INDEX_NONE ? MoveCost : FMath::Min(Summary.MinMoveCost, MoveCost);
+				}
+			}
+		}
+	}
+	return Summary;
+}
+
+void FTileChunks::CopyChunkTypes(const FIntPoint& Chunk, const FTileGrid& Grid, TArray<int32>& OutTypeIDs) const
+{
+	OutTypeIDs.Reset(ChunkSize * ChunkSize * FMath::Max(Grid.GetSize().Z, 1));
+	for (int32 Z = 0; Z < Grid.GetSize().Z; Z++)
+	{
+		for (int32 Y = Chunk.Y * ChunkSize; Y < (Chunk.Y + 1) * ChunkSize; Y++)
+		{
+			for (int32 X = Chunk.X * ChunkSize; X < (Chunk.X + 1) * ChunkSize; X++)
+			{
+				OutTypeIDs.Add(Grid.GetTileTypeID(FIntVector(X, Y, Z)));
+			}
+		}
+	}
+}
+
+void FTileChunks::BuildInstances(const FIntPoint& Chunk, int32 ChunkSize, const TArray<int32>& TypeIDs, const FVector& TileSpacing, FTileChunkInstances& OutInstances)
+{
+	OutInstances.TypeTransforms.Reset();
+	const int32 LayerSize = ChunkSize * ChunkSize;
+	for (int32 Index = 0; Index < TypeIDs.Num(); Index++)
+	{
+		const int32 TileTypeID = TypeIDs[Index];
+		if (TileTypeID == INDEX_NONE)
+		{
+			continue;
+		}
+		if (TileTypeID >= OutInstances.TypeTransforms.Num())
+		{
+			OutInstances.TypeTransforms.SetNum(TileTypeID + 1);
+		}
+		const FIntVector MapPosition(
+			Chunk.X * ChunkSize + Index % ChunkSize,
+			Chunk.Y * ChunkSize + (Index % LayerSize) / ChunkSize,
+			Index / LayerSize);
+		OutInstances.TypeTransforms[TileTypeID].Add(FTransform(FVector(MapPosition) * TileSpacing));
+	}
+}
@@ -0,0 +1,89 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TileGrid.h"
+
+class FTileTypeTable;
+
+// ---------- Tile Chunks ---------- //
+// the map split into square columns of ChunkSize x ChunkSize cells, used for streaming the tile meshes in and out around the
+// camera. Every chunk has a small summary of its tiles, kept whether or not the chunk is loaded, which is enough to answer
+// coarse questions (is there anything there, can anything walk through it, what does it cost at least) without the chunk
+
+// coarse description of the tiles in a chunk
+struct FTileChunkSummary
+{
+	FTileChunkSummary()
+		: NumTiles(0)
+		, NumPassable(0)
+		, MinMoveCost(INDEX_NONE)
+	{}
+
+	// number of tiles, and number that can be moved onto
+	int32 NumTiles;
+	int32 NumPassable;
+	// cheapest move cost of any tile, INDEX_NONE if none can be moved onto
+	int32 MinMoveCost;
+};
+
+// transforms of every tile in a chunk grouped by tile type, built off the game thread when a chunk is streamed in
+struct FTileChunkInstances
+{
+	// transforms for each tile type ID. Types with no tiles in the chunk have no transforms
+	TArray<TArray<FTransform>> TypeTransforms;
+};
+
+class FTileChunks
+{
+public:
+	// ctor
+	FTileChunks();
+
+	// split a grid of the given size into chunks. Every summary is recomputed on next use
+	void Reset(const FIntVector& GridSize, int32 NewChunkSize);
+
+	FORCEINLINE int32 GetChunkSize() const { return ChunkSize; }
+
+	// number of chunks in X and Y
+	FORCEINLINE const FIntPoint& GetNumChunks() const { return NumChunks; }
+
+	// the chunk a map position is in
+	FORCEINLINE FIntPoint ToChunk(const FIntVector& MapPosition) const
+	{
+		return FIntPoint(MapPosition.X / ChunkSize, MapPosition.Y / ChunkSize);
+	}
+
+	FORCEINLINE bool IsValidChunk(const FIntPoint& Chunk) const
+	{
+		return Chunk.X >= 0 && Chunk.X < NumChunks.X && Chunk.Y >= 0 && Chunk.Y < NumChunks.Y;
+	}
+
+	// flag the summary of the chunk containing a map position for recomputing
+	void MarkPositionDirty(const FIntVector& MapPosition);
+
+	// flag every summary for recomputing (e.g. when the tile types change)
+	void MarkAllDirty();
+
+	// summary of a chunk, recomputed from the grid first if it is out of date
+	const FTileChunkSummary& GetSummary(const FIntPoint& Chunk, const FTileGrid& Grid, const FTileTypeTable& TypeTable);
+
+	// copy the tile types of a chunk out of the grid, so its instances can be built on another thread while the grid changes
+	// cells with no tile are INDEX_NONE. Cells are ordered X, then Y, then Z within the chunk
+	void CopyChunkTypes(const FIntPoint& Chunk, const FTileGrid& Grid, TArray<int32>& OutTypeIDs) const;
+
+	// build the transforms of the tiles in a chunk from types copied by CopyChunkTypes. Safe to call on any thread
+	static void BuildInstances(const FIntPoint& Chunk, int32 ChunkSize, const TArray<int32>& TypeIDs, const FVector& TileSpacing, FTileChunkInstances& OutInstances);
+
+private:
+	int32 ChunkSize;
+	FIntVector GridSize;
+	FIntPoint NumChunks;
+
+	TArray<FTileChunkSummary> Summaries;
+	// whether each summary needs recomputing
+	TBitArray<> DirtySummaries;
+
+	FORCEINLINE int32 ToChunkIndex(const FIntPoint& Chunk) const { return Chunk.X + Chunk.Y * NumChunks.X; }
+};
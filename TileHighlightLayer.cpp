@@ -0,0 +1,121 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "TileHighlightLayer.h"
+#include "Components/InstancedStaticMeshComponent.h"
+
+FTileHighlightLayer::FTileHighlightLayer()
+	: Mesh(nullptr)
+{
+}
+
+void FTileHighlightLayer::SetMesh(UInstancedStaticMeshComponent* NewMesh)
+{
+	Mesh = NewMesh;
+	InstancePositions.Reset();
+	PositionInstances.Reset();
+	if (Mesh)
+	{
+		Mesh->ClearInstances();
+	}
+}
+
+void FTileHighlightLayer::SetTiles(const TArray<FIntVector>& MapPositions, const FVector& TileSpacing)
+{
+	if (!Mesh)
+	{
+		return;
+	}
+
+	// find the tiles that are newly highlighted
+	NewPositionSet.Reset();
+	AddedPositions.Reset();
+	for (const FIntVector& MapPosition : MapPositions)
+	{
+		bool bAlreadyInSet = false;
+		NewPositionSet.Add(MapPosition, &bAlreadyInSet);
+		if (!bAlreadyInSet && !PositionInstances.Contains(MapPosition))
+		{
+			AddedPositions.Add(MapPosition);
+		}
+	}
+
+	// and the instances of tiles that no longer are
+	FreedInstances.Reset();
+	for (int32 InstanceIndex = 0; InstanceIndex < InstancePositions.Num(); InstanceIndex++)
+	{
+		if (!NewPositionSet.Contains(InstancePositions[InstanceIndex]))
+		{
+			FreedInstances.Add(InstanceIndex);
+		}
+	}
+
+	if (AddedPositions.Num() == 0 && FreedInstances.Num() == 0)
+	{
+		return;
+	}
+
+	// move freed instances onto newly highlighted tiles first, so most changes are transform updates
+	const int32 NumReused = FMath::Min(AddedPositions.Num(), FreedInstances.Num());
+	for (int32 i = 0; i < NumReused; i++)
+	{
+		const int32 InstanceIndex = FreedInstances[i];
+		PositionInstances.Remove(InstancePositions[InstanceIndex]);
+		InstancePositions[InstanceIndex] = AddedPositions[i];
+		PositionInstances.Add(AddedPositions[i], InstanceIndex);
+		Mesh->UpdateInstanceTransform(InstanceIndex, FTransform(FVector(AddedPositions[i]) * TileSpacing), false, false);
+	}
+
+	// add any remaining new tiles in one batch
+	if (AddedPositions.Num() > NumReused)
+	{
+		AddedTransforms.Reset();
+		for (int32 i = NumReused; i < AddedPositions.Num(); i++)
+		{
+			PositionInstances.Add(AddedPositions[i], InstancePositions.Add(AddedPositions[i]));
+			AddedTransforms.Add(FTransform(FVector(AddedPositions[i]) * TileSpacing));
+		}
+		Mesh->AddInstances(AddedTransforms, false);
+	}
+
+	// remove the remaining freed instances, highest first so that each removal only moves the last instance into the gap
+	for (int32 i = FreedInstances.Num() - 1; i >= NumReused; i--)
+	{
+		const int32 InstanceIndex = FreedInstances[i];
+		const int32 LastIndex = InstancePositions.Num() - 1;
+		PositionInstances.Remove(InstancePositions[InstanceIndex]);
+		if (InstanceIndex != LastIndex)
+		{
+			const FIntVector MovedPosition = InstancePositions[LastIndex];
+			InstancePositions[InstanceIndex] = MovedPosition;
+			PositionInstances.Add(MovedPosition, InstanceIndex);
+			Mesh->UpdateInstanceTransform(InstanceIndex, FTransform(FVector(MovedPosition) * TileSpacing), false, false);
+		}
+		InstancePositions.RemoveAt(LastIndex, 1, false);
+		Mesh->RemoveInstance(LastIndex);
+	}
+
+	// the transform updates above skip marking the render state, so do it once for the whole diff
+	Mesh->MarkRenderStateDirty();
+}
+
+void FTileHighlightLayer::AddTile(const FIntVector& MapPosition, const FVector& TileSpacing)
+{
+	if (!Mesh || PositionInstances.Contains(MapPosition))
+	{
+		return;
+	}
+	PositionInstances.Add(MapPosition, InstancePositions.Add(MapPosition));
+	Mesh->AddInstance(FTransform(FVector(MapPosition) * TileSpacing));
+}
+
+void FTileHighlightLayer::Clear()
+{
+	// an empty layer has nothing to send
+	if (!Mesh || InstancePositions.Num() == 0)
+	{
+		return;
+	}
+	InstancePositions.Reset();
+	PositionInstances.Reset();
+	Mesh->ClearInstances();
+}
@@ -0,0 +1,60 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UInstancedStaticMeshComponent;
+
+// the kinds of highlight that can be drawn over the map. Each is drawn by its own instanced mesh
+enum class ETileHighlightLayer : uint8
+{
+	Moveable,
+	Attackable,
+	Path,
+	AreaPreview,
+	Num
+};
+
+// ---------- Tile Highlight Layer ---------- //
+// a set of highlighted tiles drawn by one instanced mesh. Setting the highlighted tiles diffs them against the current ones:
+// instances of tiles that are no longer highlighted are moved to the newly highlighted tiles, new instances are added in one
+// batch and only the leftovers are removed. When nothing has changed nothing is sent to the renderer
+
+class FTileHighlightLayer
+{
+public:
+	// ctor
+	FTileHighlightLayer();
+
+	// the mesh that draws the highlights. Any existing instances are cleared
+	void SetMesh(UInstancedStaticMeshComponent* NewMesh);
+
+	// highlight exactly the given tiles. Duplicates are ignored
+	void SetTiles(const TArray<FIntVector>& MapPositions, const FVector& TileSpacing);
+
+	// highlight one more tile
+	void AddTile(const FIntVector& MapPosition, const FVector& TileSpacing);
+
+	// remove every highlight
+	void Clear();
+
+	// whether a tile is highlighted
+	FORCEINLINE bool Contains(const FIntVector& MapPosition) const { return PositionInstances.Contains(MapPosition); }
+
+	// the highlighted tiles, in instance order
+	FORCEINLINE const TArray<FIntVector>& GetTiles() const { return InstancePositions; }
+
+private:
+	UInstancedStaticMeshComponent* Mesh;
+
+	// tile drawn by each instance, and the instance drawing each tile
+	TArray<FIntVector> InstancePositions;
+	TMap<FIntVector, int32> PositionInstances;
+
+	// scratch buffers kept between updates so diffing doesn't allocate
+	TSet<FIntVector> NewPositionSet;
+	TArray<FIntVector> AddedPositions;
+	TArray<int32> FreedInstances;
+	TArray<FTransform> AddedTransforms;
+};
@@ -0,0 +1,75 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "TileInstanceIndex.h"
+
+FTileInstanceIndex::FTileInstanceIndex()
+	: Size(0, 0, 0)
+{
+}
+
+void FTileInstanceIndex::Empty()
+{
+	CellInstances.Init(INDEX_NONE, CellInstances.Num());
+	TypeInstancePositions.Reset();
+}
+
+void FTileInstanceIndex::Resize(const FIntVector& NewSize)
+{
+	Size = FIntVector(FMath::Max(NewSize.X, 0), FMath::Max(NewSize.Y, 0), FMath::Max(NewSize.Z, 0));
+	CellInstances.Init(INDEX_NONE, Size.X * Size.Y * Size.Z);
+
+	// cell indices change with the size, so the per-cell index is rebuilt from the positions of the instances
+	for (const TArray<FIntVector>& InstancePositions : TypeInstancePositions)
+	{
+		for (int32 InstanceIndex = 0; InstanceIndex < InstancePositions.Num(); InstanceIndex++)
+		{
+			if (IsValidPosition(InstancePositions[InstanceIndex]))
+			{
+				CellInstances[ToIndex(InstancePositions[InstanceIndex])] = InstanceIndex;
+			}
+		}
+	}
+}
+
+int32 FTileInstanceIndex::AddInstance(int32 TileTypeID, const FIntVector& MapPosition)
+{
+	check(IsValidPosition(MapPosition));
+	if (TileTypeID >= TypeInstancePositions.Num())
+	{
+		TypeInstancePositions.SetNum(TileTypeID + 1);
+	}
+	const int32 InstanceIndex = TypeInstancePositions[TileTypeID].Add(MapPosition);
+	CellInstances[ToIndex(MapPosition)] = InstanceIndex;
+	return InstanceIndex;
+}
+
+bool FTileInstanceIndex::RemoveInstance(int32 TileTypeID, const FIntVector& MapPosition, int32& OutInstanceIndex, int32& OutLastIndex, FIntVector& OutMovedPosition)
+{
+	if (!IsValidPosition(MapPosition) || !TypeInstancePositions.IsValidIndex(TileTypeID))
+	{
+		return false;
+	}
+	const int32 CellIndex = ToIndex(MapPosition);
+	OutInstanceIndex = CellInstances[CellIndex];
+	if (OutInstanceIndex == INDEX_NONE)
+	{
+		return false;
+	}
+
+	// swap remove, pointing the cell of the last instance at the slot it moves into
+	TArray<FIntVector>& InstancePositions = TypeInstancePositions[TileTypeID];
+	OutLastIndex = InstancePositions.Num() - 1;
+	OutMovedPosition = InstancePositions[OutLastIndex];
+	InstancePositions.RemoveAtSwap(OutInstanceIndex, 1, false);
+	CellInstances[CellIndex] = INDEX_NONE;
+	if (OutInstanceIndex != OutLastIndex)
+	{
+		CellInstances[ToIndex(OutMovedPosition)] = OutInstanceIndex;
+	}
+	return true;
+}
+
+int32 FTileInstanceIndex::GetInstance(const FIntVector& MapPosition) const
+{
+	return IsValidPosition(MapPosition) ? CellInstances[ToIndex(MapPosition)] : INDEX_NONE;
+}
@@ -0,0 +1,54 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// ---------- Tile Instance Index ---------- //
+// records which instance of its type's instanced mesh each tile is drawn by, so a single tile can be replaced or removed
+// without rebuilding the mesh. Instances are removed by moving the last instance of the mesh into the freed slot, so the
+// index also records the tile drawn by each instance to fix up the one that moved
+
+class FTileInstanceIndex
+{
+public:
+	// ctor
+	FTileInstanceIndex();
+
+	// forget every instance
+	void Empty();
+
+	// resize the per-cell index for a new grid size, keeping every instance
+	void Resize(const FIntVector& NewSize);
+
+	// record an instance just appended to a type's mesh for the tile at a position. Returns its instance index
+	int32 AddInstance(int32 TileTypeID, const FIntVector& MapPosition);
+
+	// forget the instance drawing the tile at a position. The caller must remove instance OutLastIndex from the type's mesh
+	// after moving it into OutInstanceIndex, where the tile at OutMovedPosition is now drawn. Returns false if the tile has no instance
+	bool RemoveInstance(int32 TileTypeID, const FIntVector& MapPosition, int32& OutInstanceIndex, int32& OutLastIndex, FIntVector& OutMovedPosition);
+
+	// instance drawing the tile at a position, INDEX_NONE if there isn't one
+	int32 GetInstance(const FIntVector& MapPosition) const;
+
+private:
+	FIntVector Size;
+
+	// instance of each cell, INDEX_NONE for cells with no instance. Laid out like FTileGrid
+	TArray<int32> CellInstances;
+
+	// position of the tile drawn by each instance of each type's mesh
+	TArray<TArray<FIntVector>> TypeInstancePositions;
+
+	FORCEINLINE bool IsValidPosition(const FIntVector& MapPosition) const
+	{
+		return MapPosition.X >= 0 && MapPosition.X < Size.X
+			&& MapPosition.Y >= 0 && MapPosition.Y < Size.Y
+			&& MapPosition.Z >= 0 && MapPosition.Z < Size.Z;
+	}
+
+	FORCEINLINE int32 ToIndex(const FIntVector& MapPosition) const
+	{
+		return MapPosition.Z + (MapPosition.X + MapPosition.Y * Size.X) * Size.Z;
+	}
+};
@@ -1,18 +1,69 @@
 // Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
 
 #include "TileMap.h"
+#include "TileBasedGame.h"
 #include "Components/TextRenderComponent.h"
 #include "UObject/ConstructorHelpers.h"
 #include "Engine/Texture2D.h"
 #include "Engine/World.h"
-#include "MoveSequence.h"
+#include "HAL/PlatformTime.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "Async/TaskGraphInterfaces.h"
+#include "Async/Async.h"
+#include "Async/ParallelFor.h"
+#include "Serialization/CustomVersion.h"
+#include "Misc/Paths.h"
+#include "CookedTileMap.h"
+
+// ---------- Custom Version ---------- //
+// version of the data serialized by ATileMap::Serialize
+
+struct FTileMapCustomVersion
+{
+	enum Type
+	{
+		// tiles were stored as a tagged TMap property
+		BeforeCustomVersion = 0,
+		// tiles are stored in a dense FTileGrid
+		DenseTileGrid,
+		// the tile grid keeps each column of layers contiguous
+		ColumnContiguousTileGrid,
+
+		VersionPlusOne,
+		LatestVersion = VersionPlusOne - 1
+	};
+
+	static const FGuid GUID;
+};
+
+const FGuid FTileMapCustomVersion::GUID(0x6A3B5D1E, 0x4C2F4E8A, 0x9D7B1C35, 0xE2F08A64);
+FCustomVersionRegistration GRegisterTileMapCustomVersion(FTileMapCustomVersion::GUID, FTileMapCustomVersion::LatestVersion, TEXT("TileMapVer"));
 
 ATileMap::ATileMap() 
 	: bConstructed(false)
+	, bUnitsPlaced(false)
+	, bPathGraphDirty(true)
+	, PathGraphVersion(0)
+	, AsyncPathfinders(MakeShared<FPathfinderPool, ESPMode::ThreadSafe>())
 {
 	// Set defaults
 	MapSize = FIntVector(3, 3, 3);
 	TileSpacing = FVector(250.f, 250.f, 25.f);
+	bUseHierarchicalPathfinding = false;
+	PathClusterSize = 16;
+	ThreatAttackMinRange = 1;
+	ThreatAttackMaxRange = 1;
+	ThreatAttackDamage = 3;
+	bStreamChunks = false;
+	CookedSourceHash = 0;
+#if WITH_EDITORONLY_DATA
+	bSourceImageAlphaIsLayer = false;
+	MaxLayers = 16;
+#endif
+	ChunkSize = 64;
+	ChunkLoadRadius = 3;
+	ChunkUnloadRadius = 5;
+	MaxChunkLoadsPerUpdate = 4;
 
 	// Create dummy root scene component
 	DummyRoot = CreateDefaultSubobject<USceneComponent>(TEXT("Dummy0"));
@@ -39,12 +90,25 @@ ATileMap::ATileMap()
 	AttackableTilesMesh->SetRelativeScale3D(FVector(1.f, 1.f, 0.1f));
 	AttackableTilesMesh->SetRelativeLocation(FVector(0.f, 0.f, 0.f));
 	AttackableTilesMesh->SetupAttachment(DummyRoot);
+
+	PathTilesMesh = CreateDefaultSubobject<UInstancedStaticMeshComponent>(TEXT("Path Tiles Mesh"));
+	PathTilesMesh->SetRelativeScale3D(FVector(1.f, 1.f, 0.1f));
+	PathTilesMesh->SetRelativeLocation(FVector(0.f, 0.f, 0.f));
+	PathTilesMesh->SetupAttachment(DummyRoot);
+
+	AreaPreviewTilesMesh = CreateDefaultSubobject<UInstancedStaticMeshComponent>(TEXT("Area Preview Tiles Mesh"));
+	AreaPreviewTilesMesh->SetRelativeScale3D(FVector(1.f, 1.f, 0.1f));
+	AreaPreviewTilesMesh->SetRelativeLocation(FVector(0.f, 0.f, 0.f));
+	AreaPreviewTilesMesh->SetupAttachment(DummyRoot);
 }
 
 void ATileMap::PostInitProperties()
 {
 	Super::PostInitProperties();
 
+	BindTilePropertiesChanged();
+	TileTypeRows.Build(TileProperties, Simulation.GetTileTypes());
+
 	// set up the mesh
 // 	TileMesh->SetRelativeLocation(FVector(0.f, 0.f, 0.f));
 // 	TileMesh->SetupAttachment(DummyRoot);
@@ -52,6 +116,14 @@ void ATileMap::PostInitProperties()
 	
 }
 
+void ATileMap::PostLoad()
+{
+	Super::PostLoad();
+
+	BindTilePropertiesChanged();
+	TileTypeRows.Build(TileProperties, Simulation.GetTileTypes());
+}
+
 // creates the tiles on first construction
 void ATileMap::OnConstruction(const FTransform& Transform)
 {
@@ -96,6 +168,19 @@ void ATileMap::BeginPlay()
 {
 	Super::BeginPlay();
 
+	SetupHighlightLayers();
+	ThreatMap.SetAttack(FTileStencils::ManhattanRing(ThreatAttackMinRange, ThreatAttackMaxRange), ThreatAttackDamage);
+
+	// place the units that were set up in the editor
+	for (const auto& UnitPair : UnitPositions)
+	{
+		if (UnitPair.Value)
+		{
+			AddUnit(UnitPair.Value, UnitPair.Key);
+		}
+	}
+	bUnitsPlaced = true;
+	OnUnitsPlacedDelegate.Broadcast();
 }
 
 // recreates the tiles whenever the properties of the tile map are changed in the editor
@@ -110,10 +195,39 @@ void ATileMap::PostEditChangeChainProperty(struct FPropertyChangedChainEvent& Pr
 		FName PropertyName = Property->GetFName();
 		// if the changed property is any of these map member variables then recreate the map
 		if (PropertyName == GET_MEMBER_NAME_CHECKED(ATileMap, MapSize)
-			|| PropertyName == GET_MEMBER_NAME_CHECKED(ATileMap, TileSpacing))
+			|| PropertyName == GET_MEMBER_NAME_CHECKED(ATileMap, TileSpacing)
+			|| PropertyName == GET_MEMBER_NAME_CHECKED(ATileMap, bStreamChunks)
+			|| PropertyName == GET_MEMBER_NAME_CHECKED(ATileMap, ChunkSize))
 		{
 			CreateTiles();
 		}
+		// a different data table means different types
+		else if (PropertyName == GET_MEMBER_NAME_CHECKED(ATileMap, TileProperties))
+		{
+			BindTilePropertiesChanged();
+			OnTilePropertiesChanged();
+		}
+	}
+}
+
+void ATileMap::Serialize(FArchive& Ar)
+{
+	Super::Serialize(Ar);
+
+	Ar.UsingCustomVersion(FTileMapCustomVersion::GUID);
+	if (Ar.CustomVer(FTileMapCustomVersion::GUID) >= FTileMapCustomVersion::DenseTileGrid)
+	{
+		Ar << Simulation.GetTiles();
+		if (Ar.IsLoading() && Ar.CustomVer(FTileMapCustomVersion::GUID) < FTileMapCustomVersion::ColumnContiguousTileGrid)
+		{
+			Simulation.GetTiles().ConvertFromLayerMajor();
+		}
+	}
+
+	if (Ar.IsLoading())
+	{
+		OnTileGridResized();
+		HierarchicalPathfinder.MarkAllDirty();
 	}
 }
 
@@ -127,18 +241,185 @@ void ATileMap::Destroyed()
 
 void ATileMap::AddTile(int32 TileTypeID, FIntVector MapCoordinates)
 {
-	FTile NewTile;
-	NewTile.TileTypeID = TileTypeID;
-	NewTile.MapPosition = MapCoordinates;
+	ApplyTileEdits({ FTileEdit(MapCoordinates, TileTypeID) });
+}
+
+void ATileMap::RemoveTile(FIntVector MapCoordinates)
+{
+	ApplyTileEdits({ FTileEdit(MapCoordinates, INDEX_NONE) });
+}
+
+void ATileMap::ApplyTileEdits(const TArray<FTileEdit>& Edits)
+{
+	TSet<FIntPoint> ChunksToReload;
+	for (const FTileEdit& Edit : Edits)
+	{
+		ApplyTileEdit(Edit, ChunksToReload);
+	}
 
-	// add new tile data to the tiles TMap
-	Tiles.Add(NewTile.MapPosition, NewTile);
+	// each changed chunk is rebuilt once however many of its tiles changed
+	for (const FIntPoint& Chunk : ChunksToReload)
+	{
+		if (ResidentChunks.Contains(Chunk))
+		{
+			RequestChunkLoad(Chunk);
+		}
+	}
+}
 
-	FTransform NewTileTransform;
-	NewTileTransform.SetLocation(FVector(NewTile.MapPosition) * TileSpacing);
+void ATileMap::PaintTiles(const FIntVector& Centre, int32 Radius, int32 TileTypeID)
+{
+	const TArray<FIntVector>& Brush = Simulation.GetTiles().GetSize().Z > 1 ? FTileStencils::ManhattanRing3D(0, Radius) : FTileStencils::ManhattanRing(0, Radius);
+	TArray<FTileEdit> Edits;
+	Edits.Reserve(Brush.Num());
+	for (const FIntVector& Offset : Brush)
+	{
+		if (Simulation.GetTiles().IsValidPosition(Centre + Offset))
+		{
+			Edits.Add(FTileEdit(Centre + Offset, TileTypeID));
+		}
+	}
+	ApplyTileEdits(Edits);
+}
 
-	// Add the tile to its corresponding instanced mesh
-	TileMeshes[NewTile.TileTypeID]->AddInstance(NewTileTransform);
+void ATileMap::FillRegion(const FIntVector& Corner1, const FIntVector& Corner2, int32 TileTypeID)
+{
+	// the box is clipped to the map like the brush of PaintTiles, so filling past the edge doesn't grow the grid
+	const FIntVector& Size = Simulation.GetTiles().GetSize();
+	const FIntVector Min(FMath::Max(FMath::Min(Corner1.X, Corner2.X), 0), FMath::Max(FMath::Min(Corner1.Y, Corner2.Y), 0), FMath::Max(FMath::Min(Corner1.Z, Corner2.Z), 0));
+	const FIntVector Max(FMath::Min(FMath::Max(Corner1.X, Corner2.X), Size.X - 1), FMath::Min(FMath::Max(Corner1.Y, Corner2.Y), Size.Y - 1), FMath::Min(FMath::Max(Corner1.Z, Corner2.Z), Size.Z - 1));
+	if (Min.X > Max.X || Min.Y > Max.Y || Min.Z > Max.Z)
+	{
+		return;
+	}
+	TArray<FTileEdit> Edits;
+	Edits.Reserve((Max.X - Min.X + 1) * (Max.Y - Min.Y + 1) * (Max.Z - Min.Z + 1));
+	for (int32 Z = Min.Z; Z <= Max.Z; Z++)
+	{
+		for (int32 Y = Min.Y; Y <= Max.Y; Y++)
+		{
+			for (int32 X = Min.X; X <= Max.X; X++)
+			{
+				Edits.Add(FTileEdit(FIntVector(X, Y, Z), TileTypeID));
+			}
+		}
+	}
+	ApplyTileEdits(Edits);
+}
+
+void ATileMap::ApplyTileEdit(const FTileEdit& Edit, TSet<FIntPoint>& OutChunksToReload)
+{
+	const int32 OldTileTypeID = Simulation.GetTiles().GetTileTypeID(Edit.MapPosition);
+	if (OldTileTypeID == Edit.TileTypeID)
+	{
+		return;
+	}
+
+	// a unit standing on the cell would be left where it can't stand, so the tile under it can't be removed or made
+	// impassable. The unit has to be moved or removed first
+	if (Simulation.GetUnits().GetUnitAt(Edit.MapPosition) != INDEX_NONE && GetTileTypeTable().GetMoveCost(Edit.TileTypeID) == INDEX_NONE)
+	{
+		return;
+	}
+
+	// change the tile in the tile grid
+	if (Edit.TileTypeID == INDEX_NONE)
+	{
+		Simulation.GetTiles().RemoveTile(Edit.MapPosition);
+	}
+	else
+	{
+		if (!Simulation.GetTiles().SetTile(Edit.MapPosition, Edit.TileTypeID))
+		{
+			return;
+		}
+		// the grid may have grown to fit the tile, which rebuilds everything indexed by cell
+		if (Simulation.GetTiles().GetSize() != Simulation.GetUnits().GetSize())
+		{
+			OnTileGridResized();
+		}
+	}
+	HierarchicalPathfinder.MarkPositionDirty(Edit.MapPosition);
+	TileChunks.MarkPositionDirty(Edit.MapPosition);
+
+	// patch the cell in the path graph rather than rebuilding it
+	MovementRangeCache.Reset();
+	PathGraphVersion++;
+	// a tile can be attacked from further away than any unit's movement reaches, so every unit's threat is refreshed
+	ThreatMap.MarkAllDirty();
+	if (FPathGraph* Graph = GetPathGraphForPatching())
+	{
+		const FTileTypeTable& TypeTable = GetTileTypeTable();
+		const int32 CellIndex = Graph->ToIndex(Edit.MapPosition);
+		const int32 MoveCost = TypeTable.GetMoveCost(Edit.TileTypeID);
+		Graph->MoveCosts[CellIndex] = MoveCost;
+		if (MoveCost != INDEX_NONE)
+		{
+			Graph->MinMoveCost = FMath::Min(Graph->MinMoveCost, MoveCost);
+		}
+
+		// the climbs up from this cell and from the cell below both depend on this tile
+		const bool bHasCellAbove = Edit.MapPosition.Z + 1 < Graph->Size.Z;
+		Graph->ClimbCosts[CellIndex] = MoveCost != INDEX_NONE && bHasCellAbove && Graph->MoveCosts[CellIndex + 1] != INDEX_NONE
+			? TypeTable.GetClimbCost(Edit.TileTypeID) : INDEX_NONE;
+		if (Edit.MapPosition.Z > 0)
+		{
+			const int32 BelowTileTypeID = Simulation.GetTiles().GetTileTypeID(Edit.MapPosition - FIntVector(0, 0, 1));
+			Graph->ClimbCosts[CellIndex - 1] = MoveCost != INDEX_NONE && TypeTable.GetMoveCost(BelowTileTypeID) != INDEX_NONE
+				? TypeTable.GetClimbCost(BelowTileTypeID) : INDEX_NONE;
+		}
+	}
+
+	// when streaming the tile is shown by reloading its chunk
+	if (bStreamChunks)
+	{
+		OutChunksToReload.Add(TileChunks.ToChunk(Edit.MapPosition));
+		return;
+	}
+
+	// swap the tile's instance over to the new type's mesh
+	if (OldTileTypeID != INDEX_NONE)
+	{
+		RemoveTileInstance(OldTileTypeID, Edit.MapPosition);
+	}
+	if (Edit.TileTypeID != INDEX_NONE && TileMeshes.IsValidIndex(Edit.TileTypeID) && TileMeshes[Edit.TileTypeID])
+	{
+		TileMeshes[Edit.TileTypeID]->AddInstance(FTransform(FVector(Edit.MapPosition) * TileSpacing));
+		TileInstances.AddInstance(Edit.TileTypeID, Edit.MapPosition);
+	}
+}
+
+void ATileMap::RemoveTileInstance(int32 TileTypeID, const FIntVector& MapPosition)
+{
+	int32 InstanceIndex;
+	int32 LastIndex;
+	FIntVector MovedPosition;
+	if (!TileInstances.RemoveInstance(TileTypeID, MapPosition, InstanceIndex, LastIndex, MovedPosition))
+	{
+		return;
+	}
+
+	// removing anything but the last instance shifts every instance after it, so move the last one into the gap and remove that instead
+	UInstancedStaticMeshComponent* TileMesh = TileMeshes[TileTypeID];
+	if (InstanceIndex != LastIndex)
+	{
+		TileMesh->UpdateInstanceTransform(InstanceIndex, FTransform(FVector(MovedPosition) * TileSpacing), false, false);
+	}
+	TileMesh->RemoveInstance(LastIndex);
+}
+
+FPathGraph* ATileMap::GetPathGraphForPatching()
+{
+	if (bPathGraphDirty || !PathGraph.IsValid())
+	{
+		return nullptr;
+	}
+	// async queries may still be searching the current graph, so leave it untouched and update a copy
+	if (!PathGraph.IsUnique())
+	{
+		PathGraph = MakeShared<FPathGraph, ESPMode::ThreadSafe>(*PathGraph);
+	}
+	return PathGraph.Get();
 }
 
 void ATileMap::CreateTiles()
@@ -147,56 +428,301 @@ void ATileMap::CreateTiles()
 	ClearMap();
 
 	// only spawn if world exists
-	if (GetWorld())
+	if (GetWorld() && !LoadCookedMap())
+	{
+#if WITH_EDITOR
+		ImportSourceImage();
+#endif
+	}
+}
+
+void ATileMap::CookMap()
+{
+#if WITH_EDITOR
+	ClearMap();
+	ImportSourceImage();
+	// the level keeps the hash the file was cooked with, so it has to be saved again for packaged builds to load the file
+	Modify();
+	CookedSourceHash = GetSourceHash();
+	if (FCookedTileMap::Cook(Simulation.GetTiles(), TileSpacing, CookedSourceHash, GetCookedMapPath()))
+	{
+		UE_LOG(LogTileBasedGame, Log, TEXT("Cooked %d tiles to %s"), Simulation.GetTiles().NumTiles(), *GetCookedMapPath());
+	}
+	else
+	{
+		UE_LOG(LogTileBasedGame, Warning, TEXT("Failed to write cooked map %s"), *GetCookedMapPath());
+	}
+#endif
+}
+
+FString ATileMap::GetCookedMapPath() const
+{
+	return FPaths::Combine(FPaths::ProjectContentDir(), CookedMapFile);
+}
+
+bool ATileMap::LoadCookedMap()
+{
+	if (CookedMapFile.IsEmpty())
+	{
+		return false;
+	}
+	FCookedTileMap CookedMap;
+	if (!CookedMap.Open(GetCookedMapPath()))
+	{
+		return false;
+	}
+	// a stale file is rejected, so the editor imports the tiles again instead
+	if (!CookedMap.GetHeader().TileSpacing.Equals(TileSpacing))
+	{
+		UE_LOG(LogTileBasedGame, Warning, TEXT("Cooked map %s was made with a different tile spacing and must be cooked again"), *CookedMapFile);
+		return false;
+	}
+	if (CookedMap.GetHeader().SourceHash != GetSourceHash())
+	{
+		UE_LOG(LogTileBasedGame, Warning, TEXT("Cooked map %s was made from different source images or tile colours and must be cooked again"), *CookedMapFile);
+		return false;
+	}
+
+	// the grid is copied straight out of the file
+	CookedMap.ReadGrid(Simulation.GetTiles());
+	MapSize = Simulation.GetTiles().GetSize();
+	OnTileGridResized();
+	MarkPathGraphDirty();
+	HierarchicalPathfinder.MarkAllDirty();
+
+	// streamed maps create their meshes chunk by chunk as the camera moves
+	if (bStreamChunks)
+	{
+		return true;
+	}
+
+	// the file lists the cells of each type, so each instanced mesh is filled in one go without scanning the grid
+	TArray<FTransform> TypeTransforms;
+	for (int32 TileTypeID = 0; TileTypeID < TileMeshes.Num(); TileTypeID++)
+	{
+		const TArrayView<const int32> Cells = CookedMap.GetTypeInstances(TileTypeID);
+		if (Cells.Num() == 0 || !TileMeshes[TileTypeID])
+		{
+			continue;
+		}
+		TypeTransforms.Reset(Cells.Num());
+		for (int32 CellIndex : Cells)
+		{
+			const FIntVector MapPosition = Simulation.GetTiles().ToPosition(CellIndex);
+			TypeTransforms.Add(FTransform(FVector(MapPosition) * TileSpacing));
+			TileInstances.AddInstance(TileTypeID, MapPosition);
+		}
+		TileMeshes[TileTypeID]->AddInstances(TypeTransforms, false);
+	}
+	return true;
+}
+
+uint32 ATileMap::GetSourceHash() const
+{
+#if WITH_EDITOR
+	// without a source image there is nothing to import, so whatever was cooked last is what the map is
+	if (!SourceImage)
+	{
+		return CookedSourceHash;
+	}
+
+	// each image's source id changes whenever it is reimported, and the tile colours decide what its pixels become
+	uint32 Hash = HashCombine(GetTypeHash(bSourceImageAlphaIsLayer), GetTypeHash(SourceImage->Source.GetId()));
+	if (bSourceImageAlphaIsLayer)
+	{
+		Hash = HashCombine(Hash, GetTypeHash(MaxLayers));
+	}
+	else
+	{
+		for (const UTexture2D* LayerImage : UpperLayerImages)
+		{
+			Hash = HashCombine(Hash, LayerImage ? GetTypeHash(LayerImage->Source.GetId()) : 0);
+		}
+	}
+	const FTileTypeTable& TypeTable = GetTileTypeTable();
+	for (int32 TileTypeID = 0; TileTypeID < TypeTable.Num(); TileTypeID++)
+	{
+		const FTileType* TypeData = TileTypeRows.GetRow(TileTypeID);
+		Hash = HashCombine(Hash, TypeData ? TypeData->SourceImageColour.DWColor() : 0);
+	}
+	return Hash;
+#else
+	return CookedSourceHash;
+#endif
+}
+
+#if WITH_EDITOR
+void ATileMap::ImportSourceImage()
+{
+	// if there is no map source image then load no tiles
+	if (!SourceImage)
 	{
-		TMap<FString, int32> ColorToTileID; // map relating colors (as FString Hexadecimal RGBA) representing tiles on the map to the tile IDs
-		// get array holding all tile type data in the TileProperties data file
-		TArray<FTileType*> TileTypeData;
-		TileProperties->GetAllRows(FString(""), TileTypeData);
+		return;
+	}
 
-		for (auto TileType : TileTypeData)
+	// map relating the packed colours representing tiles in the source image to the tile IDs
+	const FTileTypeTable& TypeTable = GetTileTypeTable();
+	TMap<uint32, int32> ColorToTileID;
+	for (int32 TileTypeID = 0; TileTypeID < TypeTable.Num(); TileTypeID++)
+	{
+		if (const FTileType* TypeData = TileTypeRows.GetRow(TileTypeID))
 		{
-			ColorToTileID.Add(TileType->SourceImageColour.ToHex(), TileType->ID);
+			ColorToTileID.Add(TypeData->SourceImageColour.DWColor(), TileTypeID);
 		}
+	}
 
-		// if there is a map source image then load from the image, otherwise load no tiles
-		if (SourceImage)
+	// the map bounds in x and y are those of the source image
+	const int32 SizeX = SourceImage->GetSizeX();
+	const int32 SizeY = SourceImage->GetSizeY();
+	const int32 NumPixels = SizeX * SizeY;
+
+	// the image of each layer, bottom first. A heightmap is a single image with the layer of each tile in its alpha channel
+	TArray<UTexture2D*> LayerImages;
+	LayerImages.Add(SourceImage);
+	if (!bSourceImageAlphaIsLayer)
+	{
+		for (UTexture2D* LayerImage : UpperLayerImages)
 		{
-			// set the map bounds to be those of the source image
-			MapSize = FIntVector(SourceImage->GetSizeX(), SourceImage->GetSizeY(), 1);
+			if (LayerImage && LayerImage->GetSizeX() == SizeX && LayerImage->GetSizeY() == SizeY)
+			{
+				LayerImages.Add(LayerImage);
+			}
+			else
+			{
+				UE_LOG(LogTileBasedGame, Warning, TEXT("Skipped an upper layer image that is missing or a different size to the source image"));
+			}
+		}
+	}
+	const int32 NumImages = LayerImages.Num();
+
+	// tile type (INDEX_NONE for pixels that aren't a tile) and layer of each pixel of each image, and the transforms of the
+	// tiles of each type in each row of each image
+	const int32 NumTypes = TypeTable.Num();
+	TArray<int32> PixelTileTypes;
+	PixelTileTypes.SetNumUninitialized(NumPixels * NumImages);
+	TArray<int32> PixelLayers;
+	PixelLayers.SetNumUninitialized(NumPixels * NumImages);
+	TArray<TArray<FTransform>> RowTransforms;
+	RowTransforms.SetNum(NumImages * SizeY * NumTypes);
+
+	// tiles whose alpha is above the highest layer allowed, when the alpha is the layer
+	const int32 TopLayer = FMath::Clamp(MaxLayers, 1, 256) - 1;
+	FThreadSafeCounter NumClampedTiles;
+
+	for (int32 ImageIndex = 0; ImageIndex < NumImages; ImageIndex++)
+	{
+		UTexture2D* LayerImage = LayerImages[ImageIndex];
 
-			// set up the source image settings so that it allows finding rgb pixel colours
-			SourceImage->CompressionSettings = TextureCompressionSettings::TC_VectorDisplacementmap;
-			SourceImage->MipGenSettings = TextureMipGenSettings::TMGS_NoMipmaps;
-			SourceImage->SRGB = false;
-			SourceImage->UpdateResource();
+		// set up the image settings so that it allows finding rgb pixel colours
+		LayerImage->CompressionSettings = TextureCompressionSettings::TC_VectorDisplacementmap;
+		LayerImage->MipGenSettings = TextureMipGenSettings::TMGS_NoMipmaps;
+		LayerImage->SRGB = false;
+		LayerImage->UpdateResource();
 
-			// get pixel color array from the texture
-			const FColor* FormatedImageData = static_cast<const FColor*>(SourceImage->PlatformData->Mips[0].BulkData.LockReadOnly());
-			// iterate through the array and get each colour
-			for (int32 X = 0; X < SourceImage->GetSizeX(); X++)
+		// get pixel color array from the texture
+		const FColor* FormatedImageData = static_cast<const FColor*>(LayerImage->PlatformData->Mips[0].BulkData.LockReadOnly());
+		// the image is stored row by row, so each row is matched against the tile colours independently
+		ParallelFor(SizeY, [this, ImageIndex, SizeX, SizeY, NumPixels, NumTypes, TopLayer, FormatedImageData, &ColorToTileID, &PixelTileTypes, &PixelLayers, &RowTransforms, &NumClampedTiles](int32 Y)
+		{
+			for (int32 X = 0; X < SizeX; X++)
 			{
-				for (int32 Y = 0; Y < SourceImage->GetSizeY(); Y++)
+				FColor PixelColor = FormatedImageData[Y * SizeX + X];
+				int32 Layer = ImageIndex;
+				if (bSourceImageAlphaIsLayer)
+				{
+					// tile colours are matched as opaque
+					Layer = PixelColor.A;
+					PixelColor.A = 255;
+				}
+
+				const int32 PixelIndex = ImageIndex * NumPixels + Y * SizeX + X;
+				const int32* TileTypeID = ColorToTileID.Find(PixelColor.DWColor());
+				if (bSourceImageAlphaIsLayer && TileTypeID && Layer > TopLayer)
+				{
+					Layer = TopLayer;
+					NumClampedTiles.Increment();
+				}
+				PixelTileTypes[PixelIndex] = TileTypeID ? *TileTypeID : INDEX_NONE;
+				PixelLayers[PixelIndex] = Layer;
+				if (TileTypeID)
 				{
-					FString PixelColor = FormatedImageData[Y * SourceImage->GetSizeX() + X].ToHex();					
-					// if the colour of the pixel matches with a tile type from the data table then add a tile of that type to the map at the matching coordinate
-					if (ColorToTileID.Contains(PixelColor))
-					{
-						AddTile( *ColorToTileID.Find(PixelColor), FIntVector(X, Y, 0));
-					}
+					RowTransforms[(ImageIndex * SizeY + Y) * NumTypes + *TileTypeID].Add(FTransform(FVector(X, Y, Layer) * TileSpacing));
 				}
 			}
-			// unlock the source image so it can be edited elsewhere
-			SourceImage->PlatformData->Mips[0].BulkData.Unlock();
+		});
+		// unlock the image so it can be edited elsewhere
+		LayerImage->PlatformData->Mips[0].BulkData.Unlock();
+	}
+	if (NumClampedTiles.GetValue() > 0)
+	{
+		UE_LOG(LogTileBasedGame, Warning, TEXT("%d tiles of the source image have an alpha above MaxLayers - 1 (%d) and were put on the top layer"), NumClampedTiles.GetValue(), TopLayer);
+	}
+
+	// the map is as tall as its highest tile
+	int32 NumLayers = 1;
+	for (int32 PixelIndex = 0; PixelIndex < PixelTileTypes.Num(); PixelIndex++)
+	{
+		if (PixelTileTypes[PixelIndex] != INDEX_NONE)
+		{
+			NumLayers = FMath::Max(NumLayers, PixelLayers[PixelIndex] + 1);
 		}
 	}
-}
+	MapSize = FIntVector(SizeX, SizeY, NumLayers);
+	Simulation.GetTiles().Reset(MapSize);
+	OnTileGridResized();
 
+	for (int32 PixelIndex = 0; PixelIndex < PixelTileTypes.Num(); PixelIndex++)
+	{
+		if (PixelTileTypes[PixelIndex] != INDEX_NONE)
+		{
+			const int32 ImagePixel = PixelIndex % NumPixels;
+			Simulation.GetTiles().SetTile(FIntVector(ImagePixel % SizeX, ImagePixel / SizeX, PixelLayers[PixelIndex]), PixelTileTypes[PixelIndex]);
+		}
+	}
+	MarkPathGraphDirty();
+	HierarchicalPathfinder.MarkAllDirty();
+
+	// add all the tiles of each type to its instanced mesh in one go. Streamed maps create their meshes chunk by chunk instead
+	if (bStreamChunks)
+	{
+		return;
+	}
+	TArray<FTransform> TypeTransforms;
+	for (int32 TileTypeID = 0; TileTypeID < NumTypes && TileTypeID < TileMeshes.Num(); TileTypeID++)
+	{
+		TypeTransforms.Reset();
+		for (int32 Row = 0; Row < NumImages * SizeY; Row++)
+		{
+			TypeTransforms.Append(RowTransforms[Row * NumTypes + TileTypeID]);
+		}
+		if (TypeTransforms.Num() > 0 && TileMeshes[TileTypeID])
+		{
+			TileMeshes[TileTypeID]->AddInstances(TypeTransforms, false);
+		}
+	}
+
+	// the rows were added in pixel order, so the instances of each type are recorded in pixel order too
+	for (int32 PixelIndex = 0; PixelIndex < PixelTileTypes.Num(); PixelIndex++)
+	{
+		const int32 TileTypeID = PixelTileTypes[PixelIndex];
+		if (TileTypeID != INDEX_NONE && TileMeshes.IsValidIndex(TileTypeID) && TileMeshes[TileTypeID])
+		{
+			const int32 ImagePixel = PixelIndex % NumPixels;
+			TileInstances.AddInstance(TileTypeID, FIntVector(ImagePixel % SizeX, ImagePixel / SizeX, PixelLayers[PixelIndex]));
+		}
+	}
+}
+#endif
 
 void ATileMap::ClearMap()
 {
-	// empty the Tiles TMap of all pairs
-	Tiles.Empty();
+	// remove every tile from the grid, and so every unit
+	Simulation.GetTiles().Empty();
+	OnTileGridResized();
+	MarkPathGraphDirty();
+	HierarchicalPathfinder.MarkAllDirty();
+	UnloadAllChunks();
+	TileInstances.Empty();
 	
 	// clear all instances from the mesh
 	for (auto TileMesh : TileMeshes)
@@ -208,13 +734,57 @@ void ATileMap::ClearMap()
 	}
 }
 
+bool ATileMap::HasTile(const FIntVector& MapCoordinates) const
+{
+	return Simulation.GetTiles().HasTile(MapCoordinates);
+}
+
+bool ATileMap::GetTile(const FIntVector& MapCoordinates, FTile& OutTile) const
+{
+	const int32 TileTypeID = Simulation.GetTiles().GetTileTypeID(MapCoordinates);
+	if (TileTypeID == INDEX_NONE)
+	{
+		return false;
+	}
+	OutTile.MapPosition = MapCoordinates;
+	OutTile.TileTypeID = TileTypeID;
+	return true;
+}
+
 const FTileType* ATileMap::GetTypeData(int32 TileTypeID) const
 {
-	// first convert the FTileType enum into an FName of its int32 value
-	FName TileID = (FName)*FString::FromInt(TileTypeID);
-	// find the tile by its ID in the TileProperties data table
-	FTileType* TileData = TileProperties->FindRow<FTileType>(TileID, FString(""));
-	return TileData;
+	return TileTypeRows.GetRow(TileTypeID);
+}
+
+const FTileTypeTable& ATileMap::GetTileTypeTable() const
+{
+	return Simulation.GetTileTypes();
+}
+
+void ATileMap::BindTilePropertiesChanged()
+{
+	// stop watching whichever table was bound before
+	if (BoundTileProperties.IsValid())
+	{
+		BoundTileProperties->OnDataTableChanged().Remove(TilePropertiesChangedHandle);
+	}
+	BoundTileProperties = TileProperties;
+	TilePropertiesChangedHandle.Reset();
+	if (TileProperties)
+	{
+		TilePropertiesChangedHandle = TileProperties->OnDataTableChanged().AddUObject(this, &ATileMap::OnTilePropertiesChanged);
+	}
+}
+
+void ATileMap::OnTilePropertiesChanged()
+{
+	// the table holds pointers into the data table rows so it has to be rebuilt straight away
+	TileTypeRows.Build(TileProperties, Simulation.GetTileTypes());
+
+	// move costs may have changed so every path cost is out of date too
+	MarkPathGraphDirty();
+	HierarchicalPathfinder.MarkAllDirty();
+	TileChunks.MarkAllDirty();
 }
 
 FIntVector ATileMap::WorldToMapCoordinates(const FVector& WorldPosition) const
@@ -246,6 +816,24 @@ FVector ATileMap::MapToWorldCoordinates(const FIntVector& MapPosition) const
 	return WorldPosition;
 }
 
+bool ATileMap::PickTile(const FVector& WorldStart, const FVector& WorldEnd, FIntVector& OutMapPosition, AUnit** OutUnit) const
+{
+	// into map space, where each tile is a unit cube centred on its map position
+	const FTransform& MapTransform = GetTransform();
+	const FVector MapStart = MapTransform.InverseTransformPosition(WorldStart) / TileSpacing;
+	const FVector MapEnd = MapTransform.InverseTransformPosition(WorldEnd) / TileSpacing;
+
+	if (!Simulation.GetTiles().Raycast(MapStart, MapEnd, OutMapPosition))
+	{
+		return false;
+	}
+	if (OutUnit)
+	{
+		*OutUnit = GetUnitAt(OutMapPosition);
+	}
+	return true;
+}
+
 void ATileMap::SelectFocusTile(FTile Tile)
 {
 	FocusedTile = Tile;
@@ -267,41 +855,59 @@ void ATileMap::UnsetFocusTile()
 
 void ATileMap::AddMoveableTile(FTile Tile)
 {
-	// check if it has been added already
-	if (!MoveableTiles.Contains(Tile))
-	{
-		// add the tile to the movable tiles set 
-		MoveableTiles.Add(Tile);
-		// add a new instanced static mesh component to the movable tiles mesh
-		FTransform NewTileTransform;
-		NewTileTransform.SetLocation(FVector(Tile.MapPosition) * TileSpacing);
-		MoveableTilesMesh->AddInstance(NewTileTransform);
-	}
+	HighlightLayers[(int32)ETileHighlightLayer::Moveable].AddTile(Tile.MapPosition, TileSpacing);
 }
 
 void ATileMap::AddAttackableTile(FTile Tile)
 {
-	// check if the tile has already been added to attackable tiles
-	if (!AttackableTiles.Contains(Tile))
+	HighlightLayers[(int32)ETileHighlightLayer::Attackable].AddTile(Tile.MapPosition, TileSpacing);
+}
+
+void ATileMap::SetHighlightedTiles(ETileHighlightLayer Layer, const TArray<FIntVector>& MapPositions)
+{
+	HighlightLayers[(int32)Layer].SetTiles(MapPositions, TileSpacing);
+}
+
+void ATileMap::ClearHighlightLayer(ETileHighlightLayer Layer)
+{
+	HighlightLayers[(int32)Layer].Clear();
+}
+
+bool ATileMap::IsTileHighlighted(ETileHighlightLayer Layer, const FIntVector& MapPosition) const
+{
+	return HighlightLayers[(int32)Layer].Contains(MapPosition);
+}
+
+void ATileMap::ClearHighlightedTiles()
+{
+	// layers with nothing highlighted send nothing to the renderer
+	for (FTileHighlightLayer& Layer : HighlightLayers)
 	{
-		// add the tile to the movable tiles set (will do nothing if it is already in the set as it is a TSet)
-		AttackableTiles.Add(Tile);
-		// add a new instanced static mesh component to the movable tiles mesh
-		FTransform NewTileTransform;
-		NewTileTransform.SetLocation(FVector(Tile.MapPosition) * TileSpacing);
-		AttackableTilesMesh->AddInstance(NewTileTransform);
+		Layer.Clear();
 	}
 }
 
-void ATileMap::ClearHighlightedTiles()
+void ATileMap::SetupHighlightLayers()
 {
-	// empty the TArrays holding the highlighted tile positions
-	AttackableTiles.Empty();
-	MoveableTiles.Empty();
+	// maps set up before the path and area preview meshes existed borrow the look of the older layers
+	auto UseMeshOf = [](UInstancedStaticMeshComponent* Mesh, const UInstancedStaticMeshComponent* Fallback)
+	{
+		if (!Mesh->GetStaticMesh() && Fallback->GetStaticMesh())
+		{
+			Mesh->SetStaticMesh(Fallback->GetStaticMesh());
+			for (int32 MaterialIndex = 0; MaterialIndex < Fallback->GetNumMaterials(); MaterialIndex++)
+			{
+				Mesh->SetMaterial(MaterialIndex, Fallback->GetMaterial(MaterialIndex));
+			}
+		}
+	};
+	UseMeshOf(PathTilesMesh, MoveableTilesMesh);
+	UseMeshOf(AreaPreviewTilesMesh, AttackableTilesMesh);
 
-	// clear the instanced static meshes
-	AttackableTilesMesh->ClearInstances();
-	MoveableTilesMesh->ClearInstances();
+	HighlightLayers[(int32)ETileHighlightLayer::Moveable].SetMesh(MoveableTilesMesh);
+	HighlightLayers[(int32)ETileHighlightLayer::Attackable].SetMesh(AttackableTilesMesh);
+	HighlightLayers[(int32)ETileHighlightLayer::Path].SetMesh(PathTilesMesh);
+	HighlightLayers[(int32)ETileHighlightLayer::AreaPreview].SetMesh(AreaPreviewTilesMesh);
 }
 
 int32 ATileMap::DistanceBetween(const FIntVector MapPosition1, const FIntVector MapPosition2) const
@@ -313,180 +919,617 @@ int32 ATileMap::DistanceBetween(const FIntVector MapPosition1, const FIntVector
 
 TSet<FTile> ATileMap::GetSurroundingTiles(const FIntVector MapPosition) const
 {
+	// on maps with more than one layer the tiles above and below count as surrounding too
+	const TArray<FIntVector>& Stencil = Simulation.GetTiles().GetSize().Z > 1 ? FTileStencils::ChebyshevRing3D(1, 1) : FTileStencils::ChebyshevRing(1, 1);
 	TSet<FTile> AdjacentTiles;
-	// iterate through the tiles at positions around the map position
-	for (int32 i = -1; i <= 1; i++)
+	AdjacentTiles.Reserve(Stencil.Num());
+	ForEachTileInStencil(MapPosition, Stencil, [this, &AdjacentTiles](const FIntVector& TilePosition)
 	{
-		for (int32 j = -1; j <= 1; j++)
-		{
-			// check if the map position is in the Tiles TMap and add it to the AdjacentTiles array if it is
-			// exclude i==j==0 as that is just the starting map position 
-			if ( !(i == 0 && j == 0) && Tiles.Contains( MapPosition + FIntVector(i,j,0) ) )
-			{
-				AdjacentTiles.Add(*Tiles.Find(MapPosition + FIntVector(i, j, 0)));
-			}
-		}
-	}
+		FTile Tile;
+		GetTile(TilePosition, Tile);
+		AdjacentTiles.Add(Tile);
+	});
 	return AdjacentTiles;
 }
 
 TSet<FTile> ATileMap::GetTilesInRange(const FIntVector SourcePosition, int32 MinimumDistance, int32 MaximumDistance) const
 {
+	// distances include the layers on maps with more than one layer
+	const TArray<FIntVector>& Stencil = Simulation.GetTiles().GetSize().Z > 1 ? FTileStencils::ManhattanRing3D(MinimumDistance, MaximumDistance) : FTileStencils::ManhattanRing(MinimumDistance, MaximumDistance);
 	TSet<FTile> TilesInRange;
-	// iterate through the tile positions in a square of side 2 * max distance centred on the source position
-	for (int32 i = -MaximumDistance; i <= MaximumDistance; i++)
+	TilesInRange.Reserve(Stencil.Num());
+	ForEachTileInStencil(SourcePosition, Stencil, [this, &TilesInRange](const FIntVector& TilePosition)
+	{
+		FTile Tile;
+		GetTile(TilePosition, Tile);
+		TilesInRange.Add(Tile);
+	});
+	return TilesInRange;
+}
+
+int32 ATileMap::GetTilePositionsInStencil(const FIntVector& SourcePosition, const TArray<FIntVector>& Stencil, TArray<FIntVector>& OutPositions) const
+{
+	OutPositions.Reset();
+	ForEachTileInStencil(SourcePosition, Stencil, [&OutPositions](const FIntVector& TilePosition)
+	{
+		OutPositions.Add(TilePosition);
+	});
+	return OutPositions.Num();
+}
+
+int32 ATileMap::GetUnitsInStencil(const FIntVector& SourcePosition, const TArray<FIntVector>& Stencil, TArray<AUnit*>& OutUnits) const
+{
+	OutUnits.Reset();
+	ForEachTileInStencil(SourcePosition, Stencil, [this, &OutUnits](const FIntVector& TilePosition)
 	{
-		for (int32 j = -MaximumDistance; j <= MaximumDistance; j++)
+		if (AUnit* Unit = GetUnitAt(TilePosition))
 		{
-			int32 ManhattanDistance = FMath::Abs(i) + FMath::Abs(j);
-			// check whether the distance is within the desired range
-			if (ManhattanDistance >= MinimumDistance && ManhattanDistance <= MaximumDistance)
-			{
-			// check if the map position is in the Tiles TMap and add a pointer to the corresponding tile to the TilesInRange set if it is
-				if (Tiles.Contains(SourcePosition + FIntVector(i, j, 0)))
-				{
-					TilesInRange.Add(*Tiles.Find(SourcePosition + FIntVector(i, j, 0)));
-				}
-			}
-			
+			OutUnits.Add(Unit);
 		}
-	}
-	return TilesInRange;
+	});
+	return OutUnits.Num();
+}
+
+int32 ATileMap::GetTilePositionsInRange(const FIntVector& SourcePosition, int32 MinimumDistance, int32 MaximumDistance, TArray<FIntVector>& OutPositions) const
+{
+	const TArray<FIntVector>& Stencil = Simulation.GetTiles().GetSize().Z > 1 ? FTileStencils::ManhattanRing3D(MinimumDistance, MaximumDistance) : FTileStencils::ManhattanRing(MinimumDistance, MaximumDistance);
+	return GetTilePositionsInStencil(SourcePosition, Stencil, OutPositions);
+}
+
+int32 ATileMap::GetSurroundingTilePositions(const FIntVector& MapPosition, TArray<FIntVector>& OutPositions) const
+{
+	const TArray<FIntVector>& Stencil = Simulation.GetTiles().GetSize().Z > 1 ? FTileStencils::ChebyshevRing3D(1, 1) : FTileStencils::ChebyshevRing(1, 1);
+	return GetTilePositionsInStencil(MapPosition, Stencil, OutPositions);
 }
 
 void ATileMap::AddUnit(AUnit* NewUnit, FIntVector MapPosition)
 {
-	if (Tiles.Contains(MapPosition))
+	if (!NewUnit || !HasTile(MapPosition))
+	{
+		return;
+	}
+
+	// a unit can only be on the map once
+	if (IsUnitOnMap(NewUnit))
+	{
+		MoveUnit(NewUnit, MapPosition);
+		return;
+	}
+
+	// the simulation holds the unit's HP and AP while it is on the map
+	const int32 UnitID = Simulation.AddUnit(NewUnit->GetTeam(), MapPosition, NewUnit->GetStats(), NewUnit->GetHitPoints(), NewUnit->GetAbilityPoints());
+	if (UnitID != INDEX_NONE)
+	{
+		const FSimUnit& SimUnit = Simulation.GetUnit(UnitID);
+		MatchLog.RecordAddUnit(UnitID, NewUnit->GetTeam(), MapPosition, SimUnit.Stats, SimUnit.HitPoints, SimUnit.AbilityPoints);
+
+		if (UnitID >= OccupancyUnits.Num())
+		{
+			OccupancyUnits.SetNumZeroed(UnitID + 1);
+		}
+		OccupancyUnits[UnitID] = NewUnit;
+		NewUnit->SetMap(this, UnitID);
+		ThreatMap.MarkUnitDirty(UnitID);
+
+		OnUnitOccupancyChanged(MapPosition);
+	}
+}
+
+bool ATileMap::MoveUnit(AUnit* Unit, FIntVector NewMapPosition)
+{
+	if (!IsUnitOnMap(Unit) || !HasTile(NewMapPosition))
+	{
+		return false;
+	}
+
+	const FIntVector OldMapPosition = Simulation.GetUnits().GetUnitPosition(Unit->GetMapUnitID());
+	if (!Simulation.MoveUnit(Unit->GetMapUnitID(), NewMapPosition))
+	{
+		return false;
+	}
+	MatchLog.RecordMoveUnit(Unit->GetMapUnitID(), NewMapPosition);
+	OnUnitOccupancyChanged(OldMapPosition);
+	OnUnitOccupancyChanged(NewMapPosition);
+	return true;
+}
+
+void ATileMap::RemoveUnit(AUnit* Unit)
+{
+	if (!IsUnitOnMap(Unit))
 	{
-		UnitPositions.Add(MapPosition, NewUnit);
+		return;
 	}
+
+	const int32 UnitID = Unit->GetMapUnitID();
+	const FIntVector MapPosition = Simulation.GetUnits().GetUnitPosition(UnitID);
+	Simulation.RemoveUnit(UnitID);
+	MatchLog.RecordRemoveUnit(UnitID);
+	OccupancyUnits[UnitID] = nullptr;
+	// the unit takes its HP and AP back from the simulation, which keeps them until the ID is reused
+	Unit->SetMap(nullptr, INDEX_NONE);
+
+	OnUnitOccupancyChanged(MapPosition);
+}
+
+void ATileMap::RemoveUnits(TArrayView<AUnit* const> Units)
+{
+	TSet<const AUnit*> RemovedUnits;
+	RemovedUnits.Reserve(Units.Num());
+	for (AUnit* Unit : Units)
+	{
+		RemoveUnit(Unit);
+		RemovedUnits.Add(Unit);
+	}
+
+	// the starting positions shouldn't keep units that are gone. One pass covers every unit removed
+	for (auto It = UnitPositions.CreateIterator(); It; ++It)
+	{
+		if (RemovedUnits.Contains(It.Value()))
+		{
+			It.RemoveCurrent();
+		}
+	}
+}
+
+bool ATileMap::IsUnitOnMap(const AUnit* Unit) const
+{
+	return Unit && Unit->GetMap() == this && Simulation.GetUnits().IsValidUnit(Unit->GetMapUnitID());
 }
 
 FIntVector ATileMap::GetUnitPosition(AUnit* Unit) const
 {
-	const FIntVector* UnitPosition = UnitPositions.FindKey(Unit);
-	if (UnitPosition)
+	if (IsUnitOnMap(Unit))
 	{
-		return *UnitPosition;
+		return Simulation.GetUnits().GetUnitPosition(Unit->GetMapUnitID());
 	}
 	return FIntVector(0, 0, 0);
 }
 
-TSet<AUnit*> ATileMap::GetUnitsOnTiles(TSet<FTile> Tiles)
+AUnit* ATileMap::GetUnitAt(const FIntVector& MapPosition) const
+{
+	const int32 UnitID = Simulation.GetUnits().GetUnitAt(MapPosition);
+	return UnitID != INDEX_NONE ? OccupancyUnits[UnitID] : nullptr;
+}
+
+void ATileMap::GetTeamUnits(int32 Team, TArray<AUnit*>& OutUnits) const
+{
+	const TArray<int32>& UnitIDs = Simulation.GetUnits().GetTeamUnits(Team);
+	OutUnits.Reset(UnitIDs.Num());
+	for (int32 UnitID : UnitIDs)
+	{
+		OutUnits.Add(OccupancyUnits[UnitID]);
+	}
+}
+
+TSet<AUnit*> ATileMap::GetUnitsOnTiles(const TSet<FTile>& TilesToSearch) const
 {
 	TSet<AUnit*> UnitsFound;
-	for (auto Tile : Tiles)
+	for (const FTile& Tile : TilesToSearch)
 	{
-		if (UnitPositions.Contains(Tile.MapPosition))
+		if (AUnit* Unit = GetUnitAt(Tile.MapPosition))
 		{
-			UnitsFound.Add(*UnitPositions.Find(Tile.MapPosition));
+			UnitsFound.Add(Unit);
 		}
 	}
 	return UnitsFound;
 }
 
-TSet<FTile> ATileMap::ReachableTiles(AUnit* UnitMoving) const
+void ATileMap::OnUnitOccupancyChanged(const FIntVector& MapPosition)
+{
+	// any unit moving can open or block paths for every other unit
+	MovementRangeCache.Reset();
+	PathGraphVersion++;
+
+	// the threat only changes for the units whose movement reached the tile, including the unit that was on it
+	ThreatMap.MarkCellChanged(MapPosition);
+
+	// only the one cell changes so update the path graph in place rather than rebuilding it
+	FPathGraph* Graph = GetPathGraphForPatching();
+	if (Graph && Graph->IsValidPosition(MapPosition))
+	{
+		const int32 CellIndex = Graph->ToIndex(MapPosition);
+		Graph->OccupantTeams[CellIndex] = Simulation.GetUnits().GetTeamGrid()[CellIndex];
+	}
+}
+
+void ATileMap::OnTileGridResized()
 {
+	SyncUnitOccupancySize();
+	TileInstances.Resize(Simulation.GetTiles().GetSize());
 
+	// chunk indices change with the grid size so every loaded chunk has to be rebuilt
+	UnloadAllChunks();
+	TileChunks.Reset(Simulation.GetTiles().GetSize(), ChunkSize);
 }
 
-TArray<FIntVector> ATileMap::GetShortestPath(FIntVector StartCoordinate, FIntVector TargetCoordinate, int32 Team) const
+int32 ATileMap::GetPathClusterSize() const
 {
-	// doubly linked lists used for storing the move sequences as each element must maintain its memory address when elements are added as they are pointed to by other move sequences
-	TDoubleLinkedList<MoveSequence> OpenSet; // tiles that will potentially be analysed
-	TDoubleLinkedList<MoveSequence> ClosedSet; // tiles that have been analysed or are being analysed
-	
-	// create the starting and final move sequence elements. Start is the at the units position, the end is the target
-	MoveSequence StartTile(StartCoordinate, GetTypeData(Tiles.Find(StartCoordinate)->TileTypeID)->MoveCost);
-	MoveSequence EndTile(TargetCoordinate, GetTypeData(Tiles.Find(TargetCoordinate)->TileTypeID)->MoveCost);
-	
-	// add the initial tile to the open set
-	StartTile.Target(TargetCoordinate);
-	OpenSet.AddHead(StartTile);
-
-	// keep iterating over this loop until EndTile has a parent, at that point the end tile must have been reached!
-	while (!EndTile.GetSequenceParent()) {
-		
-		// find the tile in the open set with the lowest predicted score to the target
-		MoveSequence* ElemToAnalyse = &OpenSet.GetHead()->GetValue();
-		for (auto& Elem : OpenSet)
-		{
-			if (ElemToAnalyse == &StartTile)
+	return bStreamChunks ? ChunkSize : PathClusterSize;
+}
+
+void ATileMap::UpdateStreaming(const FVector& FocusWorldPosition)
+{
+	if (!bStreamChunks)
+	{
+		return;
+	}
+	const FIntPoint FocusChunk = TileChunks.ToChunk(WorldToMapCoordinates(FocusWorldPosition));
+
+	// unload the chunks that are now too far away
+	TArray<FIntPoint> ChunksToUnload;
+	for (const auto& ChunkPair : ResidentChunks)
+	{
+		const FIntPoint Offset = ChunkPair.Key - FocusChunk;
+		if (FMath::Max(FMath::Abs(Offset.X), FMath::Abs(Offset.Y)) > FMath::Max(ChunkUnloadRadius, ChunkLoadRadius))
+		{
+			ChunksToUnload.Add(ChunkPair.Key);
+		}
+	}
+	for (const FIntPoint& Chunk : ChunksToUnload)
+	{
+		UnloadChunk(Chunk);
+	}
+
+	// load the missing chunks nearest the focus first. Chunks with no tiles never need loading
+	int32 NumLoadsStarted = 0;
+	for (int32 Radius = 0; Radius <= ChunkLoadRadius && NumLoadsStarted < MaxChunkLoadsPerUpdate; Radius++)
+	{
+		for (const FIntVector& Offset : FTileStencils::ChebyshevRing(Radius, Radius))
+		{
+			const FIntPoint Chunk(FocusChunk.X + Offset.X, FocusChunk.Y + Offset.Y);
+			if (!TileChunks.IsValidChunk(Chunk) || ResidentChunks.Contains(Chunk)
+				|| TileChunks.GetSummary(Chunk, Simulation.GetTiles(), GetTileTypeTable()).NumTiles == 0)
 			{
-				ElemToAnalyse = &Elem;
+				continue;
 			}
-			else
+			RequestChunkLoad(Chunk);
+			if (++NumLoadsStarted >= MaxChunkLoadsPerUpdate)
 			{
-				if (Elem.Score() < ElemToAnalyse->Score())
-				{
-					ElemToAnalyse = &Elem;
-				}
+				break;
 			}
 		}
+	}
+}
 
-		// add a copy of the element that will be analysed to the closed set
-		ClosedSet.AddHead(*ElemToAnalyse);
-		// remove the element to analyse from the open set as it cannot be in both sets and update the pointer to the closed set copy
-		MoveSequence* ElemToAnalyseOpenSet = ElemToAnalyse;
-		ElemToAnalyse = &ClosedSet.FindNode(*ElemToAnalyse)->GetValue();
-		OpenSet.RemoveNode(*ElemToAnalyseOpenSet);
-		ElemToAnalyseOpenSet = nullptr;
-
-		// set to hold tiles adjacent to inspected tile
-		TSet<FTile> AdjacentTiles = GetTilesInRange(ElemToAnalyse->GetMapCoordinates(), 1, 1); // tiles distance of 1 map unit away
-		// go through the tiles in the set of adjacent tiles
-		for (auto Tile : AdjacentTiles) {
-			
-			// make a MoveSequence object from this adjacent tile and make its parent the currently inspected tile
-			MoveSequence AdjacentElement(Tile.MapPosition, GetTypeData(Tile.TileTypeID)->MoveCost);
-			AdjacentElement.SetSequenceParent(*ElemToAnalyse);
-			AdjacentElement.Target(EndTile.GetMapCoordinates());
-			
-			// check if this element is at the target position. if so update the end tile and we have found the shortest path
-			if (AdjacentElement.GetMapCoordinates() == EndTile.GetMapCoordinates()) {
-				EndTile = AdjacentElement;
+bool ATileMap::IsChunkResident(const FIntVector& MapPosition) const
+{
+	const FResidentChunk* Resident = ResidentChunks.Find(TileChunks.ToChunk(MapPosition));
+	return Resident && Resident->bLoaded;
+}
+
+const FTileChunkSummary& ATileMap::GetChunkSummary(const FIntVector& MapPosition) const
+{
+	return TileChunks.GetSummary(TileChunks.ToChunk(MapPosition), Simulation.GetTiles(), GetTileTypeTable());
+}
+
+void ATileMap::RequestChunkLoad(const FIntPoint& Chunk)
+{
+	FResidentChunk& Resident = ResidentChunks.FindOrAdd(Chunk);
+	const uint32 Generation = ++Resident.Generation;
+
+	// the worker gets its own copy of the chunk's tiles so the grid can keep changing while it runs
+	TSharedRef<TArray<int32>, ESPMode::ThreadSafe> TypeIDs = MakeShared<TArray<int32>, ESPMode::ThreadSafe>();
+	TileChunks.CopyChunkTypes(Chunk, Simulation.GetTiles(), *TypeIDs);
+	TSharedRef<FTileChunkInstances, ESPMode::ThreadSafe> Instances = MakeShared<FTileChunkInstances, ESPMode::ThreadSafe>();
+
+	TWeakObjectPtr<ATileMap> WeakThis(this);
+	const int32 BuildChunkSize = TileChunks.GetChunkSize();
+	const FVector BuildTileSpacing = TileSpacing;
+	FFunctionGraphTask::CreateAndDispatchWhenReady([WeakThis, Chunk, Generation, TypeIDs, Instances, BuildChunkSize, BuildTileSpacing]()
+	{
+		FTileChunks::BuildInstances(Chunk, BuildChunkSize, *TypeIDs, BuildTileSpacing, *Instances);
+
+		AsyncTask(ENamedThreads::GameThread, [WeakThis, Chunk, Generation, Instances]()
+		{
+			if (ATileMap* TileMap = WeakThis.Get())
+			{
+				TileMap->OnChunkInstancesBuilt(Chunk, Generation, *Instances);
 			}
-			
-			// check if the element is already in one of the sets (elements compared using their map coordinates)
-			MoveSequence* InOpenSet = &OpenSet.FindNode(AdjacentElement)->GetValue();
-			MoveSequence* InClosedSet = &ClosedSet.FindNode(AdjacentElement)->GetValue();
-			// if this tile is not already in the closed set then proceed (if it is in closed set then it has already been analysed and shortest path to it found)
-			if (!InClosedSet) {
-				if (!InOpenSet) { // if also not in open set
-					// if there is a unit on the tile..
-					if (UnitPositions.Contains(AdjacentElement.GetMapCoordinates())) {
-						// friendly unit -> can move through, non-friendly then cant
-							if (Team == ((*UnitPositions.Find(AdjacentElement.GetMapCoordinates()))->GetTeam())) {
-							OpenSet.AddHead(AdjacentElement);
-						}
-					}
-					// if no unit on the tile then just add to reachable tiles and to open set
-					else {
-						OpenSet.AddHead(AdjacentElement);
-					}
-				}
-				else { // (in open set already)
-					// if adjacent tile costs less to reach from parent as currently inspected element then update the parent of element already in set
-					if (AdjacentElement.Score() < InOpenSet->Score()) {
-						InOpenSet->SetSequenceParent(*ElemToAnalyse);
-					}
-				}
+		});
+	}, TStatId(), nullptr, ENamedThreads::AnyThread);
+}
+
+void ATileMap::OnChunkInstancesBuilt(const FIntPoint& Chunk, uint32 Generation, const FTileChunkInstances& Instances)
+{
+	// the chunk may have been unloaded or reloaded since this load started
+	FResidentChunk* Resident = ResidentChunks.Find(Chunk);
+	if (!Resident || Resident->Generation != Generation)
+	{
+		return;
+	}
+
+	for (UInstancedStaticMeshComponent* Mesh : Resident->Meshes)
+	{
+		Mesh->DestroyComponent();
+	}
+	Resident->Meshes.Reset();
+
+	for (int32 TileTypeID = 0; TileTypeID < Instances.TypeTransforms.Num(); TileTypeID++)
+	{
+		const FTileType* TypeData = GetTypeData(TileTypeID);
+		if (Instances.TypeTransforms[TileTypeID].Num() == 0 || !TypeData)
+		{
+			continue;
+		}
+		UInstancedStaticMeshComponent* NewMesh = NewObject<UInstancedStaticMeshComponent>(this);
+		NewMesh->RegisterComponent();
+		NewMesh->AttachToComponent(RootComponent, FAttachmentTransformRules::KeepRelativeTransform);
+		NewMesh->SetStaticMesh(TypeData->Mesh);
+		NewMesh->SetMaterial(0, TypeData->Material);
+		NewMesh->AddInstances(Instances.TypeTransforms[TileTypeID], false);
+		Resident->Meshes.Add(NewMesh);
+	}
+	Resident->bLoaded = true;
+}
+
+void ATileMap::UnloadChunk(const FIntPoint& Chunk)
+{
+	FResidentChunk Resident;
+	if (ResidentChunks.RemoveAndCopyValue(Chunk, Resident))
+	{
+		for (UInstancedStaticMeshComponent* Mesh : Resident.Meshes)
+		{
+			Mesh->DestroyComponent();
+		}
+	}
+}
+
+void ATileMap::UnloadAllChunks()
+{
+	for (const auto& ChunkPair : ResidentChunks)
+	{
+		for (UInstancedStaticMeshComponent* Mesh : ChunkPair.Value.Meshes)
+		{
+			Mesh->DestroyComponent();
+		}
+	}
+	ResidentChunks.Reset();
+}
+
+void ATileMap::SyncUnitOccupancySize()
+{
+	TArray<int32> RemovedUnitIDs;
+	Simulation.SyncUnitsToGrid(&RemovedUnitIDs);
+	for (int32 UnitID : RemovedUnitIDs)
+	{
+		if (OccupancyUnits[UnitID])
+		{
+			OccupancyUnits[UnitID]->SetMap(nullptr, INDEX_NONE);
+			OccupancyUnits[UnitID] = nullptr;
+		}
+	}
+	MarkPathGraphDirty();
+}
+
+TSet<FTile> ATileMap::ReachableTiles(AUnit* UnitMoving) const
+{
+	TSet<FTile> Reachable;
+	for (const FReachableTile& ReachableTile : GetMovementRange(UnitMoving).Tiles)
+	{
+		// tiles held by allies can be moved through but not ended on
+		if (ReachableTile.bCanStop)
+		{
+			FTile Tile;
+			if (GetTile(ReachableTile.MapPosition, Tile))
+			{
+				Reachable.Add(Tile);
 			}
 		}
 	}
-	// we now have a move sequence which takes the unit from its current tile to the target tile.
-	// make list of coordinates that is the order of moves to reach the target using the MoveSequence corresponding to the fnial tile
-	TDoubleLinkedList<FIntVector> ShortestPathList;;
-	MoveSequence CurrentElement = EndTile;
-	while (CurrentElement.GetSequenceParent()) { // will keep adding until we reach then initial tile has not parent and is not added
-		ShortestPathList.AddHead(CurrentElement.GetMapCoordinates());
-		CurrentElement = *CurrentElement.GetSequenceParent();
+	return Reachable;
+}
+
+const FMovementRange& ATileMap::GetMovementRange(AUnit* UnitMoving) const
+{
+	FMovementRange* MovementRange = MovementRangeCache.Find(UnitMoving);
+	if (!MovementRange)
+	{
+		MovementRange = &MovementRangeCache.Add(UnitMoving);
+
+		// units which aren't on the map can't move anywhere
+		if (IsUnitOnMap(UnitMoving))
+		{
+			Pathfinder.FindReachableTiles(GetPathGraph(), Simulation.GetUnits().GetUnitPosition(UnitMoving->GetMapUnitID()), UnitMoving->GetTeam(), UnitMoving->GetMovement(), *MovementRange);
+		}
+		else
+		{
+			MovementRange->Reset();
+		}
+	}
+	return *MovementRange;
+}
+
+void ATileMap::InvalidateMovementRange(const AUnit* Unit)
+{
+	MovementRangeCache.Remove(Unit);
+}
+
+const FThreatMap& ATileMap::GetThreatMap() const
+{
+	if (ThreatMap.IsDirty())
+	{
+		ThreatMap.Update(Simulation, GetPathGraph(), Pathfinder);
 	}
-	// convert list to array
-	TArray<FIntVector> ShortestPathArray;
-	for (auto elem : ShortestPathList)
+	return ThreatMap;
+}
+
+void ATileMap::InvalidateThreat(const AUnit* Unit)
+{
+	if (IsUnitOnMap(Unit))
 	{
-		ShortestPathArray.Add(elem);
+		ThreatMap.MarkUnitDirty(Unit->GetMapUnitID());
 	}
-	return ShortestPathArray;
+}
+
+void ATileMap::RunTurnPhase()
+{
+	TurnScheduler.RunPhase([](const FTurnEffect& Effect)
+	{
+		// units destroyed since the effect was scheduled are skipped
+		if (AUnit* Unit = Effect.Unit.Get())
+		{
+			Unit->ApplyTurnEffect(Effect);
+		}
+	});
+}
+
+TArray<FIntVector> ATileMap::GetShortestPath(FIntVector StartCoordinate, FIntVector TargetCoordinate, int32 Team) const
+{
+	// path is empty if the target cannot be reached
+	TArray<FIntVector> ShortestPath;
+
+	// when the target's chunk isn't loaded its summary can rule the path out without searching. The path graph covers the
+	// whole map whatever is loaded, so the search itself doesn't depend on which chunks are resident
+	if (bStreamChunks && Simulation.GetTiles().IsValidPosition(TargetCoordinate) && !IsChunkResident(TargetCoordinate)
+		&& GetChunkSummary(TargetCoordinate).NumPassable == 0)
+	{
+		return ShortestPath;
+	}
+
+	if (bUseHierarchicalPathfinding)
+	{
+		HierarchicalPathfinder.SetClusterSize(GetPathClusterSize());
+		HierarchicalPathfinder.FindPath(GetPathGraph(), StartCoordinate, TargetCoordinate, Team, Pathfinder, ShortestPath);
+		LastPathQueryStats = HierarchicalPathfinder.GetLastQueryStats();
+	}
+	else
+	{
+		const double StartTime = FPlatformTime::Seconds();
+		Pathfinder.FindPath(GetPathGraph(), StartCoordinate, TargetCoordinate, Team, ShortestPath);
+		LastPathQueryStats.NodesExpanded = Pathfinder.GetNumExpanded();
+		LastPathQueryStats.QuerySeconds = FPlatformTime::Seconds() - StartTime;
+	}
+	return ShortestPath;
+}
+
+void ATileMap::ComparePathfinding(FIntVector StartCoordinate, FIntVector TargetCoordinate, int32 Team, FPathQueryStats& OutFlatStats, FPathQueryStats& OutHierarchicalStats) const
+{
+	const FPathGraph& Graph = GetPathGraph();
+	TArray<FIntVector> FlatPath;
+	TArray<FIntVector> HierarchicalPath;
+
+	const double StartTime = FPlatformTime::Seconds();
+	Pathfinder.FindPath(Graph, StartCoordinate, TargetCoordinate, Team, FlatPath);
+	OutFlatStats.NodesExpanded = Pathfinder.GetNumExpanded();
+	OutFlatStats.QuerySeconds = FPlatformTime::Seconds() - StartTime;
+
+	// the first hierarchical query after the map changes also pays for building the abstract graph
+	HierarchicalPathfinder.SetClusterSize(GetPathClusterSize());
+	HierarchicalPathfinder.FindPath(Graph, StartCoordinate, TargetCoordinate, Team, Pathfinder, HierarchicalPath);
+	OutHierarchicalStats = HierarchicalPathfinder.GetLastQueryStats();
+
+	UE_LOG(LogTileBasedGame, Log, TEXT("Path %s -> %s on %dx%d map: flat %d nodes %.3f ms (length %d), hierarchical %d nodes %.3f ms (length %d, %d entrances)"),
+		*StartCoordinate.ToString(), *TargetCoordinate.ToString(), Graph.Size.X, Graph.Size.Y,
+		OutFlatStats.NodesExpanded, OutFlatStats.QuerySeconds * 1000.0, FlatPath.Num(),
+		OutHierarchicalStats.NodesExpanded, OutHierarchicalStats.QuerySeconds * 1000.0, HierarchicalPath.Num(),
+		HierarchicalPathfinder.GetNumAbstractNodes());
+}
+
+const FPathGraph& ATileMap::GetPathGraph() const
+{
+	if (bPathGraphDirty)
+	{
+		bPathGraphDirty = false;
+
+		// async queries may still be searching the old graph so build a new one rather than overwriting it
+		if (!PathGraph.IsValid() || !PathGraph.IsUnique())
+		{
+			PathGraph = MakeShared<FPathGraph, ESPMode::ThreadSafe>();
+		}
+
+		// move costs come straight from the tile type table rather than the data table
+		Simulation.BuildPathGraph(*PathGraph);
+	}
+	return *PathGraph;
+}
+
+TSharedRef<const FPathGraph, ESPMode::ThreadSafe> ATileMap::GetPathGraphSnapshot() const
+{
+	GetPathGraph();
+	return PathGraph.ToSharedRef();
+}
+
+void ATileMap::BuildPathTree(FIntVector StartCoordinate, int32 Team, FPathTree& OutTree) const
+{
+	Pathfinder.BuildPathTree(GetPathGraph(), StartCoordinate, Team, OutTree);
+	OutTree.GraphVersion = PathGraphVersion;
+}
+
+FAsyncPathQueryHandle ATileMap::FindPathAsync(FIntVector StartCoordinate, FIntVector TargetCoordinate, int32 Team, FOnAsyncPathFound OnComplete) const
+{
+	FAsyncPathQueryHandle Query = MakeShared<FAsyncPathQuery, ESPMode::ThreadSafe>();
+	Query->GraphVersion = PathGraphVersion;
+
+	// the worker only touches the snapshot and the query, never the map itself
+	TSharedRef<const FPathGraph, ESPMode::ThreadSafe> Graph = GetPathGraphSnapshot();
+	TSharedRef<FPathfinderPool, ESPMode::ThreadSafe> Pool = AsyncPathfinders;
+
+	FFunctionGraphTask::CreateAndDispatchWhenReady([Query, Graph, Pool, StartCoordinate, TargetCoordinate, Team, OnComplete]()
+	{
+		if (Query->IsCancelled())
+		{
+			return;
+		}
+
+		TUniquePtr<FTilePathfinder> Pathfinder = Pool->Acquire();
+		Pathfinder->SetCancelFlag(&Query->bCancelled);
+		Pathfinder->FindPath(*Graph, StartCoordinate, TargetCoordinate, Team, Query->Path);
+		Pathfinder->SetCancelFlag(nullptr);
+		Pool->Release(MoveTemp(Pathfinder));
+		Query->bComplete = true;
+
+		// hand the result back on the game thread, dropping it if the query was superseded in the meantime
+		AsyncTask(ENamedThreads::GameThread, [Query, OnComplete]()
+		{
+			if (!Query->IsCancelled())
+			{
+				OnComplete.ExecuteIfBound(Query->Path);
+			}
+		});
+	}, TStatId(), nullptr, ENamedThreads::AnyThread);
+
+	return Query;
+}
+
+FAsyncPathQueryHandle ATileMap::BuildPathTreeAsync(FIntVector StartCoordinate, int32 Team, FOnAsyncPathTreeBuilt OnComplete) const
+{
+	FAsyncPathQueryHandle Query = MakeShared<FAsyncPathQuery, ESPMode::ThreadSafe>();
+	Query->GraphVersion = PathGraphVersion;
+
+	TSharedRef<const FPathGraph, ESPMode::ThreadSafe> Graph = GetPathGraphSnapshot();
+	TSharedRef<FPathfinderPool, ESPMode::ThreadSafe> Pool = AsyncPathfinders;
+
+	FFunctionGraphTask::CreateAndDispatchWhenReady([Query, Graph, Pool, StartCoordinate, Team, OnComplete]()
+	{
+		if (Query->IsCancelled())
+		{
+			return;
+		}
+
+		TUniquePtr<FTilePathfinder> Pathfinder = Pool->Acquire();
+		Pathfinder->SetCancelFlag(&Query->bCancelled);
+		Pathfinder->BuildPathTree(*Graph, StartCoordinate, Team, Query->Tree);
+		Pathfinder->SetCancelFlag(nullptr);
+		Pool->Release(MoveTemp(Pathfinder));
+		Query->Tree.GraphVersion = Query->GraphVersion;
+		Query->bComplete = true;
+
+		AsyncTask(ENamedThreads::GameThread, [Query, OnComplete]()
+		{
+			if (!Query->IsCancelled())
+			{
+				OnComplete.ExecuteIfBound(Query->Tree);
+			}
+		});
+	}, TStatId(), nullptr, ENamedThreads::AnyThread);
+
+	return Query;
+}
+
+void ATileMap::MarkPathGraphDirty()
+{
+	bPathGraphDirty = true;
+	PathGraphVersion++;
+	MovementRangeCache.Reset();
+	ThreatMap.MarkAllDirty();
 }
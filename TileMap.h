@@ -7,6 +7,20 @@
 #include "Components/InstancedStaticMeshComponent.h"
 #include "TileType.h"
 #include "Unit.h"
+#include "TileGrid.h"
+#include "TilePathfinder.h"
+#include "HierarchicalPathfinder.h"
+#include "AsyncPathQuery.h"
+#include "UnitOccupancy.h"
+#include "TileSimulation.h"
+#include "TileStencils.h"
+#include "TileTypeTable.h"
+#include "TileTypeRows.h"
+#include "TileChunks.h"
+#include "TileInstanceIndex.h"
+#include "TileHighlightLayer.h"
+#include "MatchLog.h"
+#include "ThreatMap.h"
 #include "TileMap.generated.h"
 
 // ---------- Tile Struct ---------- //
@@ -42,6 +56,29 @@ inline int32 GetTypeHash(const FTile& Tile)
 	return GetTypeHash(Tile.MapPosition);
 }
 
+// ---------- Tile Edit ---------- //
+// a change to one tile, for applying edits to the map in batches
+
+struct FTileEdit
+{
+	FTileEdit()
+		: MapPosition(0, 0, 0)
+		, TileTypeID(INDEX_NONE)
+	{}
+
+	FTileEdit(const FIntVector& InMapPosition, int32 InTileTypeID)
+		: MapPosition(InMapPosition)
+		, TileTypeID(InTileTypeID)
+	{}
+
+	FIntVector MapPosition;
+	// type of the new tile, INDEX_NONE to remove the tile
+	int32 TileTypeID;
+};
+
+// broadcast once the units set up in the editor have been placed on the map
+DECLARE_MULTICAST_DELEGATE(FOnMapUnitsPlaced);
+
 // ---------- TileMap ---------- //
 
 // Class used to manage tiles
@@ -69,8 +106,52 @@ public:
 	UPROPERTY(Category = Grid, EditAnywhere, BlueprintReadOnly)
 	FVector TileSpacing;
 
+	// ---------- Pathfinding ---------- //
+
+	// answer path queries with the hierarchical (HPA*) search rather than searching tile by tile. Faster on very large maps
+	UPROPERTY(Category = Pathfinding, EditAnywhere, BlueprintReadOnly)
+	bool bUseHierarchicalPathfinding;
+
+	// width of the square clusters the map is split into for hierarchical pathfinding
+	UPROPERTY(Category = Pathfinding, EditAnywhere, BlueprintReadOnly, meta = (ClampMin = "4"))
+	int32 PathClusterSize;
+
+	// ---------- Threat Map ---------- //
+
+	// the attack every unit is assumed to have when working out which tiles each team threatens: its range and raw damage
+	UPROPERTY(Category = Threat, EditAnywhere, BlueprintReadOnly, meta = (ClampMin = "0"))
+	int32 ThreatAttackMinRange;
+	UPROPERTY(Category = Threat, EditAnywhere, BlueprintReadOnly, meta = (ClampMin = "0"))
+	int32 ThreatAttackMaxRange;
+	UPROPERTY(Category = Threat, EditAnywhere, BlueprintReadOnly)
+	int32 ThreatAttackDamage;
+
+	// ---------- Chunk Streaming ---------- //
+
+	// split the map into chunks and only create the tile meshes of the chunks around the camera
+	// the tile grid itself stays loaded (a byte per cell) so pathfinding and range queries are still exact everywhere
+	UPROPERTY(EditAnywhere, Category = Streaming)
+	bool bStreamChunks;
+
+	// width of each chunk in tiles. Also used as the cluster size for hierarchical pathfinding when streaming
+	UPROPERTY(EditAnywhere, Category = Streaming, meta = (ClampMin = "4"))
+	int32 ChunkSize;
+
+	// chunks within this many chunks of the camera are loaded
+	UPROPERTY(EditAnywhere, Category = Streaming, meta = (ClampMin = "0"))
+	int32 ChunkLoadRadius;
+
+	// chunks further than this many chunks from the camera are unloaded. Kept above the load radius so chunks on the edge don't churn
+	UPROPERTY(EditAnywhere, Category = Streaming, meta = (ClampMin = "0"))
+	int32 ChunkUnloadRadius;
+
+	// most chunk loads started by one UpdateStreaming call, to spread the cost of creating meshes over several frames
+	UPROPERTY(EditAnywhere, Category = Streaming, meta = (ClampMin = "1"))
+	int32 MaxChunkLoadsPerUpdate;
+
 	// ---------- Units ---------- //
-	// TMap for determining if there is a unit at a given coordinate using Find(Coordinate). Can also find position of unit using FindKey(Unit) but this is a linear operation
+	// units placed on the map in the editor, keyed by their starting coordinate. They are added to the map when play begins
+	// at runtime use AddUnit, MoveUnit and RemoveUnit, which keep the unit occupancy index up to date
 	UPROPERTY(EditAnywhere)
 	TMap<FIntVector, AUnit*> UnitPositions;
 
@@ -80,13 +161,46 @@ public:
 	UPROPERTY(EditAnywhere)
 	UDataTable* TileProperties;
 
-	// 2d texture with map drawn on. this is used for creating and loading maps
+#if WITH_EDITORONLY_DATA
+	// 2d texture with map drawn on. this is used for creating maps in the editor, which are then cooked with CookMap
+	// it is the bottom layer of the map, unless bSourceImageAlphaIsLayer is set
 	UPROPERTY(EditAnywhere)
 	UTexture2D* SourceImage;
 
-	// map container relating the tile coordinates to the tile structs. Use map instead of array so better handling of strange map shapes
-	UPROPERTY()
-	TMap<FIntVector, FTile> Tiles;
+	// images of the layers above the source image, bottom first. Must be the same size as the source image
+	UPROPERTY(EditAnywhere)
+	TArray<UTexture2D*> UpperLayerImages;
+
+	// treat the alpha channel of the source image as a heightmap giving the layer of each tile, instead of using UpperLayerImages.
+	// An alpha of 0 is the bottom layer and each step up is one layer higher
+	UPROPERTY(EditAnywhere)
+	bool bSourceImageAlphaIsLayer;
+
+	// number of layers the alpha channel can give. Tiles with a higher alpha are put on the top layer and warned about, so an
+	// image saved fully opaque doesn't make a map 256 layers tall
+	UPROPERTY(EditAnywhere, meta = (ClampMin = "1", ClampMax = "256", EditCondition = "bSourceImageAlphaIsLayer"))
+	int32 MaxLayers;
+#endif
+
+	// cooked map file the tiles are loaded from, relative to the project content directory. Made from SourceImage by CookMap
+	// when the file is missing or out of date the tiles are imported from SourceImage instead (in the editor only).
+	// The file isn't an asset, so a packaged build only has it if its directory is listed in the project's packaging
+	// settings. List it under DirectoriesToAlwaysStageAsNonUFS ("Additional Non-Asset Directories to Copy") so it is
+	// staged as a loose file and can be memory mapped. Staged inside the pak it still loads, but is read into memory
+	UPROPERTY(EditAnywhere)
+	FString CookedMapFile;
+
+	// hash of the sources CookedMapFile was last cooked from. Packaged builds have no source images to hash, so they check
+	// the file against this instead
+	UPROPERTY(VisibleAnywhere, AdvancedDisplay)
+	uint32 CookedSourceHash;
+
+	// the tiles, tile types and units with their HP, AP and stats, held without any engine types so the game can be
+	// simulated outside the editor. The tile grid is serialized by Serialize()
+	FTileSimulation Simulation;
+
+	// the data table row of each tile type, which fills the simulation's tile type table
+	FTileTypeRows TileTypeRows;
 	// Need an instanced static mesh component for each tile type
 	UPROPERTY()
 	TArray<UInstancedStaticMeshComponent*> TileMeshes;
@@ -102,20 +216,22 @@ public:
 	UPROPERTY(EditAnywhere)
 	UMaterialInstance* FocusedTileMaterial;
 	
-	// Set of highlighted tiles (for target of action other than for attack)
-	UPROPERTY()
-	TSet<FTile> MoveableTiles;
 	// instanced static mesh for highlighted tiles 
 	UPROPERTY(EditAnywhere)
 	UInstancedStaticMeshComponent* MoveableTilesMesh;
 	
-	// Set of tiles highlighted for an attack action
-	UPROPERTY()
-	TSet<FTile> AttackableTiles;
 	// instanced static mesh for tiles highlighted for attack
 	UPROPERTY(EditAnywhere)
 	UInstancedStaticMeshComponent* AttackableTilesMesh;
 
+	// instanced static mesh for a previewed path. Uses the moveable tiles mesh if no mesh is set
+	UPROPERTY(EditAnywhere)
+	UInstancedStaticMeshComponent* PathTilesMesh;
+
+	// instanced static mesh for the tiles an area effect would hit. Uses the attackable tiles mesh if no mesh is set
+	UPROPERTY(EditAnywhere)
+	UInstancedStaticMeshComponent* AreaPreviewTilesMesh;
+
 protected:
 	// ---------- Begin AActor interface ---------- //
 
@@ -123,6 +239,9 @@ protected:
 	// use this to set up the Instanced static mesh components as not everything works in the constructor
 	virtual void PostInitProperties() override;
 
+	// called after the map is loaded. TileProperties may differ from the default, so the type table is rebuilt
+	virtual void PostLoad() override;
+
 	// this runs when the map is constructed and any time any property is changed 
 	// creates the tiles on first construction
 	virtual void OnConstruction(const FTransform& Transform) override;
@@ -134,6 +253,9 @@ protected:
 	// it recreates the tiles whenever the properties of the tile map are changed in the editor
 	virtual void PostEditChangeChainProperty(struct FPropertyChangedChainEvent& PropertyChangedEvent) override;
 
+	// serializes the tile grid along with the tagged properties
+	virtual void Serialize(FArchive& Ar) override;
+
 	// called when the object is to be destroyed
 	// this function will destroy all the attached tile objects before the map is destroyed
 	virtual void Destroyed() override;
@@ -143,26 +265,213 @@ protected:
 private:
 	bool bConstructed;
 
+	// set once BeginPlay has placed the units set up in the editor
+	bool bUnitsPlaced;
+	FOnMapUnitsPlaced OnUnitsPlacedDelegate;
+
+	// ---------- Map Loading ---------- //
+
+	// full path of CookedMapFile
+	FString GetCookedMapPath() const;
+
+	// load the tiles from CookedMapFile. Returns false if there is no usable cooked map: one that is missing, made with a
+	// different tile spacing or made from different sources
+	bool LoadCookedMap();
+
+	// hash of the sources the tiles are imported from, which a cooked map must match to be loaded
+	uint32 GetSourceHash() const;
+
+#if WITH_EDITOR
+	// decode SourceImage and create a tile for each pixel that matches a tile type colour
+	void ImportSourceImage();
+#endif
+
+	// ---------- Tile Editing ---------- //
+
+	// which instance of its type's mesh draws each tile. Not used when streaming, as chunks own their meshes
+	FTileInstanceIndex TileInstances;
+
+	// change one tile, updating its instance and the cached data that depends on it. Does nothing if a unit stands on the
+	// tile and the new type can't be stood on. Chunks that need reloading to show the change are added to the set
+	void ApplyTileEdit(const FTileEdit& Edit, TSet<FIntPoint>& OutChunksToReload);
+
+	// remove the instance drawing a tile from its type's mesh
+	void RemoveTileInstance(int32 TileTypeID, const FIntVector& MapPosition);
+
+	// the path graph ready to be patched in place, copied first if async queries still hold it. nullptr if it is due a rebuild anyway
+	FPathGraph* GetPathGraphForPatching();
+
+	// ---------- Tile Highlighting ---------- //
+
+	// highlighted tiles of each layer, indexed by ETileHighlightLayer
+	FTileHighlightLayer HighlightLayers[(int32)ETileHighlightLayer::Num];
+
+	// point each highlight layer at its mesh, falling back to another layer's mesh and material where none is set
+	void SetupHighlightLayers();
+
+	// ---------- Chunk Streaming ---------- //
+
+	// a chunk whose meshes are loaded or being loaded
+	struct FResidentChunk
+	{
+		FResidentChunk()
+			: Generation(0)
+			, bLoaded(false)
+		{}
+
+		// instanced mesh for each tile type in the chunk. Kept alive by the actor's owned components
+		TArray<UInstancedStaticMeshComponent*> Meshes;
+		// incremented each time the chunk is (re)loaded, so meshes built for an older load are thrown away
+		uint32 Generation;
+		// false until the first load finishes
+		bool bLoaded;
+	};
+
+	// chunk layout and summaries of every chunk, loaded or not
+	mutable FTileChunks TileChunks;
+
+	// chunks that are loaded or being loaded
+	TMap<FIntPoint, FResidentChunk> ResidentChunks;
+
+	// build the meshes of a chunk on a worker thread, replacing its current meshes when done
+	void RequestChunkLoad(const FIntPoint& Chunk);
+
+	// create the meshes of a chunk on the game thread from the transforms built by RequestChunkLoad
+	void OnChunkInstancesBuilt(const FIntPoint& Chunk, uint32 Generation, const FTileChunkInstances& Instances);
+
+	// destroy the meshes of a chunk
+	void UnloadChunk(const FIntPoint& Chunk);
+	void UnloadAllChunks();
+
+	// called whenever the size of the tile grid may have changed, to keep the unit occupancy and chunks the same size
+	void OnTileGridResized();
+
+	// cluster size for hierarchical pathfinding. Clusters match the chunks when streaming
+	int32 GetPathClusterSize() const;
+
+	// ---------- Tile Types ---------- //
+
+	// per-type data copied out of TileProperties into the simulation's type table so hot loops don't search the data table
+	// rebuilt whenever the data table changes
+
+	// the data table whose change delegate is bound, so the tile type table is rebuilt when it is edited
+	TWeakObjectPtr<UDataTable> BoundTileProperties;
+	FDelegateHandle TilePropertiesChangedHandle;
+
+	// watch the current TileProperties data table for changes
+	void BindTilePropertiesChanged();
+
+	// called when the data table is edited or TileProperties is changed to a different table
+	void OnTilePropertiesChanged();
+
+	// ---------- Units ---------- //
+
+	// which unit is on which tile is kept by the simulation, indexed both ways, with a dense grid of the team on each tile
+
+	// the unit for each occupancy ID (nullptr for free IDs). Keeps the units referenced for garbage collection
+	UPROPERTY()
+	TArray<AUnit*> OccupancyUnits;
+
+	// update the path graph and cached movement ranges after the unit on a tile changes
+	void OnUnitOccupancyChanged(const FIntVector& MapPosition);
+
+	// resize the unit occupancy grids to match the tile grid, removing any units left off the map
+	void SyncUnitOccupancySize();
+
+	// ---------- Pathfinding ---------- //
+
+	// dense copy of the tile move costs and unit positions that the pathfinder searches over. Rebuilt lazily after the tiles change
+	// shared with async queries in flight, so it is copied before being modified if anything else still holds it
+	mutable TSharedPtr<FPathGraph, ESPMode::ThreadSafe> PathGraph;
+	mutable bool bPathGraphDirty;
+
+	// incremented whenever the tiles or unit positions change, so results built from an older graph can be detected
+	uint32 PathGraphVersion;
+
+	// scratch memory for path queries, kept between queries so that searching does not allocate
+	mutable FTilePathfinder Pathfinder;
+
+	// abstract cluster graph used when bUseHierarchicalPathfinding is set
+	mutable FHierarchicalPathfinder HierarchicalPathfinder;
+
+	// nodes expanded and time taken by the last GetShortestPath query
+	mutable FPathQueryStats LastPathQueryStats;
+
+	// pathfinders borrowed by async queries on worker threads
+	TSharedRef<FPathfinderPool, ESPMode::ThreadSafe> AsyncPathfinders;
+
+	// movement range of each unit, kept until that unit's turn starts or ends or any unit or tile changes
+	mutable TMap<const AUnit*, FMovementRange> MovementRangeCache;
+
+	// buff effects of the units, keyed by the turn and phase they are due
+	FTurnScheduler TurnScheduler;
+
+	// record of the match being played on the map
+	FMatchLog MatchLog;
+
+	// tiles each team could attack next turn. Units are flagged as they change and refreshed when the map is next read
+	mutable FThreatMap ThreatMap;
+
 public:
 
 	// adds a tile to the map at the given map coordinates. If there is already a tile at those coordinates it will delete and replace that tile
 	void AddTile(int32 TileTypeID, FIntVector MapCoordinates);
 
-	// creates the tiles according to the current height and width
+	// removes the tile at the given map coordinates if there is one
+	void RemoveTile(FIntVector MapCoordinates);
+
+	// apply a batch of tile changes. Only the changed tiles' instances, path graph cells and clusters are updated. Edits
+	// that would remove the tile under a unit or make it impassable are skipped, as the unit would be stranded
+	void ApplyTileEdits(const TArray<FTileEdit>& Edits);
+
+	// set every cell within a manhattan distance of the centre to a tile type (INDEX_NONE erases). Cells outside the map are skipped
+	void PaintTiles(const FIntVector& Centre, int32 Radius, int32 TileTypeID);
+
+	// set every cell in the box between two corners (inclusive) to a tile type (INDEX_NONE erases). Cells outside the map are skipped
+	void FillRegion(const FIntVector& Corner1, const FIntVector& Corner2, int32 TileTypeID);
+
+	// load the chunks around a world position and unload those far from it. Called each frame with the camera position
+	void UpdateStreaming(const FVector& FocusWorldPosition);
+
+	// whether the meshes of the chunk containing a map position are loaded
+	bool IsChunkResident(const FIntVector& MapPosition) const;
+
+	// summary of the tiles in the chunk containing a map position, available whether or not the chunk is loaded. The position must be on the map
+	const FTileChunkSummary& GetChunkSummary(const FIntVector& MapPosition) const;
+
+	// creates the tiles from the cooked map file, or from the source image if there is no usable cooked map
 	void CreateTiles();
 
+	// import the tiles from the source image and write them to the cooked map file
+	UFUNCTION(CallInEditor)
+	void CookMap();
+
 	// clears the current tiles from the map
 	void ClearMap();
 
+	// whether there is a tile at the given map coordinates
+	bool HasTile(const FIntVector& MapCoordinates) const;
+
+	// get the tile at the given map coordinates. Returns false if there is no tile there
+	bool GetTile(const FIntVector& MapCoordinates, FTile& OutTile) const;
+
 	// gets the FTileType struct associated with a given tile type
 	const FTileType* GetTypeData(int32 TileTypeID) const;
 
+	// the move costs, modifiers and passability of every tile type, indexed by tile type ID
+	const FTileTypeTable& GetTileTypeTable() const;
+
 	// returns the map coordinate for a given world coordinate (x and y)
 	FIntVector WorldToMapCoordinates(const FVector& WorldCoordinates) const;
 
 	// returns the world coords of a map coordinate (centre of tile)
 	FVector MapToWorldCoordinates(const FIntVector& MapCoordinates) const;
 
+	// find the first tile along the segment between two world positions by walking it through the tile grid
+	// doesn't depend on collision, and costs the number of cells crossed rather than the number of meshes in the scene
+	// OutUnit, if given, is set to the unit on the tile or nullptr. Returns false if the segment doesn't hit a tile
+	bool PickTile(const FVector& WorldStart, const FVector& WorldEnd, FIntVector& OutMapPosition, AUnit** OutUnit = nullptr) const;
+
 	// Set the tile a the given coordinates to be the focus tile. There can only be one focused tile
 	void SelectFocusTile(FTile TileToFocus);
 
@@ -175,7 +484,16 @@ public:
 	// highlight a tile as attackable
 	void AddAttackableTile(FTile Tile);
 
-	// unhighlight all tiles (of either highlighted or attackable)
+	// highlight exactly the given tiles on a layer. Only the tiles that changed since the last call are sent to the renderer
+	void SetHighlightedTiles(ETileHighlightLayer Layer, const TArray<FIntVector>& MapPositions);
+
+	// unhighlight all tiles on a layer
+	void ClearHighlightLayer(ETileHighlightLayer Layer);
+
+	// whether a tile is highlighted on a layer
+	bool IsTileHighlighted(ETileHighlightLayer Layer, const FIntVector& MapPosition) const;
+
+	// unhighlight all tiles on every layer
 	void ClearHighlightedTiles();
 
 	// get the manhattan distance between two map positions
@@ -187,21 +505,131 @@ public:
 	// returns a set containing the positions of tiles that are equal to or greater than the minimum distance and less than or equal to the maximum distance away from the source position 
 	TSet<FTile> GetTilesInRange(const FIntVector SourcePosition, int32 MinimumDistance, int32 MaximumDistance) const;
 
-	// adds a unit to the map at the given coordinates
+	// call Visitor(const FIntVector& MapPosition) for each tile covered by a stencil (from FTileStencils) placed on the source position
+	// tiles are visited in stencil order, nearest first
+	template<typename VisitorType>
+	void ForEachTileInStencil(const FIntVector& SourcePosition, const TArray<FIntVector>& Stencil, VisitorType Visitor) const
+	{
+		for (const FIntVector& Offset : Stencil)
+		{
+			const FIntVector MapPosition = SourcePosition + Offset;
+			if (Simulation.GetTiles().HasTile(MapPosition))
+			{
+				Visitor(MapPosition);
+			}
+		}
+	}
+
+	// fill a scratch buffer with the positions of the tiles covered by a stencil placed on the source position
+	// the buffer is emptied but keeps its memory, so reusing it between queries doesn't allocate. Returns the number found
+	int32 GetTilePositionsInStencil(const FIntVector& SourcePosition, const TArray<FIntVector>& Stencil, TArray<FIntVector>& OutPositions) const;
+
+	// fill a scratch buffer with the units on the tiles covered by a stencil placed on the source position. Returns the number found
+	int32 GetUnitsInStencil(const FIntVector& SourcePosition, const TArray<FIntVector>& Stencil, TArray<AUnit*>& OutUnits) const;
+
+	// scratch buffer versions of GetTilesInRange and GetSurroundingTiles
+	int32 GetTilePositionsInRange(const FIntVector& SourcePosition, int32 MinimumDistance, int32 MaximumDistance, TArray<FIntVector>& OutPositions) const;
+	int32 GetSurroundingTilePositions(const FIntVector& MapPosition, TArray<FIntVector>& OutPositions) const;
+
+	// adds a unit to the map at the given coordinates. If the unit is already on the map it is moved there instead
 	void AddUnit(AUnit* NewUnit, FIntVector MapPosition);
 
+	// moves a unit that is on the map to the given coordinates. Returns false if there is no tile there or it is occupied
+	bool MoveUnit(AUnit* Unit, FIntVector NewMapPosition);
+
+	// takes a unit off the map
+	void RemoveUnit(AUnit* Unit);
+
+	// takes several units off the map at once, such as every unit killed by an action, and drops them from UnitPositions
+	void RemoveUnits(TArrayView<AUnit* const> Units);
+
+	// whether the unit has been added to this map
+	bool IsUnitOnMap(const AUnit* Unit) const;
+
 	// returns the map position of a unit
 	FIntVector GetUnitPosition(AUnit* Unit) const;
 
+	// returns the unit at the given coordinates or nullptr if there isn't one
+	AUnit* GetUnitAt(const FIntVector& MapPosition) const;
+
+	// gets every unit on the map belonging to a team
+	void GetTeamUnits(int32 Team, TArray<AUnit*>& OutUnits) const;
+
+	// whether the units set up in the editor have been placed. Actors begin play in no particular order, so anything that
+	// needs the units when play begins should wait for OnUnitsPlaced if they haven't been
+	FORCEINLINE bool AreUnitsPlaced() const { return bUnitsPlaced; }
+	FOnMapUnitsPlaced& OnUnitsPlaced() { return OnUnitsPlacedDelegate; }
+
+	// the index of which unit is on which tile
+	const FUnitOccupancy& GetUnitOccupancy() const { return Simulation.GetUnits(); }
+
+	// the engine independent state of the map. Change tiles and unit positions through the map so its caches stay up to date
+	const FTileSimulation& GetSimulation() const { return Simulation; }
+	FTileSimulation& GetSimulation() { return Simulation; }
+
 	// returns a set of all units that are present on the set of tiles given
-	TSet<AUnit*> GetUnitsOnTiles(TSet<FTile> Tiles);
+	TSet<AUnit*> GetUnitsOnTiles(const TSet<FTile>& TilesToSearch) const;
 
 	// return a set of tiles which can be reached by the input unit
 	TSet<FTile> ReachableTiles(AUnit* UnitMoving) const;
 
+	// returns every tile the unit can reach with its movement this turn, with the cost and predecessor of each
+	// the result is cached until the unit's turn starts or ends or any unit or tile on the map changes
+	// the returned reference is only valid until the next call
+	const FMovementRange& GetMovementRange(AUnit* UnitMoving) const;
+
+	// discard the cached movement range of a unit (e.g. when its movement stat may have changed)
+	void InvalidateMovementRange(const AUnit* Unit);
+
+	// how many units of each team could attack each tile next turn and how much damage they could deal there, brought up
+	// to date with the units first. Only the units that changed since the last call are refreshed
+	const FThreatMap& GetThreatMap() const;
+
+	// refresh a unit's threat when the map is next read (e.g. when its movement or damage stat may have changed)
+	void InvalidateThreat(const AUnit* Unit);
+
+	// the buff expiries and effects over time of every unit on the map
+	FTurnScheduler& GetTurnScheduler() { return TurnScheduler; }
+
+	// carry out the buff effects due in the scheduler's next turn phase, in the order they were scheduled
+	void RunTurnPhase();
+
+	// record of every change to the units of the match, once ATurnManager has started recording it
+	FMatchLog& GetMatchLog() { return MatchLog; }
+
 	// return a sequence of coordinates that could be moved along to get from the starting coordinate to the target coordinate for a unit of particular team (units cannot move through enemy units but can move through allied ones)
 	TArray<FIntVector> GetShortestPath(FIntVector StartCoordinate, FIntVector TargetCoordinate, int32 Team) const;
 
+	// stats for the last GetShortestPath query
+	const FPathQueryStats& GetLastPathQueryStats() const { return LastPathQueryStats; }
+
+	// run the same query with both the flat and the hierarchical search and log the nodes expanded and time taken by each
+	// used to decide which search to use for a given map size
+	void ComparePathfinding(FIntVector StartCoordinate, FIntVector TargetCoordinate, int32 Team, FPathQueryStats& OutFlatStats, FPathQueryStats& OutHierarchicalStats) const;
+
+	// build the shortest path tree from a start coordinate for a unit of particular team
+	// paths to any target can then be read from the tree without searching again
+	void BuildPathTree(FIntVector StartCoordinate, int32 Team, FPathTree& OutTree) const;
+
+	// start a path query on a worker thread, searching a snapshot of the current tiles and unit positions
+	// OnComplete is called on the game thread with the path unless the query is cancelled through the returned handle first
+	FAsyncPathQueryHandle FindPathAsync(FIntVector StartCoordinate, FIntVector TargetCoordinate, int32 Team, FOnAsyncPathFound OnComplete) const;
+
+	// as FindPathAsync but builds the shortest path tree from the start coordinate
+	FAsyncPathQueryHandle BuildPathTreeAsync(FIntVector StartCoordinate, int32 Team, FOnAsyncPathTreeBuilt OnComplete) const;
+
+	// returns the graph searched by the pathfinder, rebuilding it first if the tiles have changed
+	const FPathGraph& GetPathGraph() const;
+
+	// returns a read only snapshot of the path graph that can be searched on another thread
+	TSharedRef<const FPathGraph, ESPMode::ThreadSafe> GetPathGraphSnapshot() const;
+
+	// flag the path graph for rebuilding
+	void MarkPathGraphDirty();
+
+	// version of the path graph, changes whenever the tiles or unit positions do
+	uint32 GetPathGraphVersion() const { return PathGraphVersion; }
+
 	/** Returns DummyRoot subobject **/
 	FORCEINLINE class USceneComponent* GetDummyRoot() const { return DummyRoot; }
 };
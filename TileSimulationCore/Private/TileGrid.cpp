@@ -0,0 +1,216 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "TileGrid.h"
+
+FTileGrid::FTileGrid()
+	: Size(0, 0, 0)
+	, TileCount(0)
+{
+}
+
+void FTileGrid::Reset(const FIntVector& NewSize)
+{
+	Size = FIntVector(FMath::Max(NewSize.X, 0), FMath::Max(NewSize.Y, 0), FMath::Max(NewSize.Z, 0));
+	const int32 NumNewCells = Size.X * Size.Y * Size.Z;
+
+	TypeIDs.Init(0, NumNewCells);
+	TileExists.Init(false, NumNewCells);
+	TileCount = 0;
+}
+
+void FTileGrid::Empty()
+{
+	Size = FIntVector(0, 0, 0);
+	TypeIDs.Empty();
+	TileExists.Empty();
+	TileCount = 0;
+}
+
+bool FTileGrid::SetTile(const FIntVector& MapPosition, int32 TileTypeID)
+{
+	if (MapPosition.X < 0 || MapPosition.Y < 0 || MapPosition.Z < 0)
+	{
+		return false;
+	}
+	// type IDs are stored in a byte per cell
+	checkf(TileTypeID >= 0 && TileTypeID <= MAX_uint8, TEXT("Tile type ID %d can't be stored in the tile grid"), TileTypeID);
+
+	if (!IsValidPosition(MapPosition))
+	{
+		Grow(FIntVector(FMath::Max(Size.X, MapPosition.X + 1), FMath::Max(Size.Y, MapPosition.Y + 1), FMath::Max(Size.Z, MapPosition.Z + 1)));
+	}
+
+	const int32 Index = ToIndex(MapPosition);
+	if (!TileExists[Index])
+	{
+		TileExists[Index] = true;
+		TileCount++;
+	}
+	TypeIDs[Index] = (uint8)TileTypeID;
+	return true;
+}
+
+void FTileGrid::RemoveTile(const FIntVector& MapPosition)
+{
+	if (HasTile(MapPosition))
+	{
+		const int32 Index = ToIndex(MapPosition);
+		TileExists[Index] = false;
+		TypeIDs[Index] = 0;
+		TileCount--;
+	}
+}
+
+void FTileGrid::Grow(const FIntVector& MinimumSize)
+{
+	FTileGrid Grown;
+	Grown.Reset(MinimumSize);
+
+	// cell indices change with the size so each tile has to be moved individually
+	ForEachTile([this, &Grown](int32 Index, int32 TileTypeID)
+	{
+		const int32 GrownIndex = Grown.ToIndex(ToPosition(Index));
+		Grown.TypeIDs[GrownIndex] = (uint8)TileTypeID;
+		Grown.TileExists[GrownIndex] = true;
+	});
+	Grown.TileCount = TileCount;
+
+	*this = MoveTemp(Grown);
+}
+
+void FTileGrid::SetFromRaw(const FIntVector& NewSize, const uint8* RawTypeIDs, const uint32* RawTileExists, int32 NumTilesSet)
+{
+	Reset(NewSize);
+	const int32 NumNewCells = TypeIDs.Num();
+	if (NumNewCells > 0)
+	{
+		FMemory::Memcpy(TypeIDs.GetData(), RawTypeIDs, NumNewCells);
+		const int32 NumWords = FMath::DivideAndRoundUp(NumNewCells, NumBitsPerDWORD);
+		FMemory::Memcpy(TileExists.GetData(), RawTileExists, NumWords * sizeof(uint32));
+		// the bit array expects the bits past the last cell to be clear
+		const int32 NumUsedBits = NumNewCells % NumBitsPerDWORD;
+		if (NumUsedBits != 0)
+		{
+			TileExists.GetData()[NumWords - 1] &= (1u << NumUsedBits) - 1;
+		}
+	}
+	TileCount = NumTilesSet;
+}
+
+bool FTileGrid::Raycast(const FVector& Start, const FVector& End, FIntVector& OutMapPosition) const
+{
+	if (TileCount == 0)
+	{
+		return false;
+	}
+
+	// clip the segment to the bounds of the grid. The ray is parameterised by T from 0 at Start to 1 at End
+	const FVector Delta = End - Start;
+	float TEnter = 0.f;
+	float TExit = 1.f;
+	for (int32 Axis = 0; Axis < 3; Axis++)
+	{
+		const float Min = -0.5f;
+		const float Max = Size[Axis] - 0.5f;
+		if (FMath::IsNearlyZero(Delta[Axis]))
+		{
+			if (Start[Axis] < Min || Start[Axis] > Max)
+			{
+				return false;
+			}
+			continue;
+		}
+		float T0 = (Min - Start[Axis]) / Delta[Axis];
+		float T1 = (Max - Start[Axis]) / Delta[Axis];
+		if (T0 > T1)
+		{
+			Swap(T0, T1);
+		}
+		TEnter = FMath::Max(TEnter, T0);
+		TExit = FMath::Min(TExit, T1);
+		if (TEnter > TExit)
+		{
+			return false;
+		}
+	}
+
+	// cell the clipped segment starts in, and the distance in T to the next cell boundary on each axis
+	// stepping a cell on an axis moves the cell index by a fixed stride, so the walk never recomputes the index
+	const FVector Entry = Start + Delta * TEnter;
+	const int32 Strides[3] = { Size.Z, Size.X * Size.Z, 1 };
+	int32 Cell[3];
+	int32 Step[3];
+	float TNext[3];
+	float TDelta[3];
+	for (int32 Axis = 0; Axis < 3; Axis++)
+	{
+		Cell[Axis] = FMath::Clamp(FMath::FloorToInt(Entry[Axis] + 0.5f), 0, Size[Axis] - 1);
+		if (FMath::IsNearlyZero(Delta[Axis]))
+		{
+			Step[Axis] = 0;
+			TNext[Axis] = TNumericLimits<float>::Max();
+			TDelta[Axis] = TNumericLimits<float>::Max();
+		}
+		else
+		{
+			Step[Axis] = Delta[Axis] > 0.f ? 1 : -1;
+			const float Boundary = Cell[Axis] + 0.5f * Step[Axis];
+			TNext[Axis] = (Boundary - Start[Axis]) / Delta[Axis];
+			TDelta[Axis] = FMath::Abs(1.f / Delta[Axis]);
+		}
+	}
+
+	int32 Index = ToIndex(FIntVector(Cell[0], Cell[1], Cell[2]));
+	while (true)
+	{
+		if (TileExists[Index])
+		{
+			OutMapPosition = FIntVector(Cell[0], Cell[1], Cell[2]);
+			return true;
+		}
+
+		// move into the neighbouring cell whose boundary the ray crosses first
+		const int32 Axis = TNext[0] < TNext[1]
+			? (TNext[0] < TNext[2] ? 0 : 2)
+			: (TNext[1] < TNext[2] ? 1 : 2);
+		if (TNext[Axis] > TExit)
+		{
+			return false;
+		}
+		Cell[Axis] += Step[Axis];
+		if (Cell[Axis] < 0 || Cell[Axis] >= Size[Axis])
+		{
+			return false;
+		}
+		Index += Step[Axis] * Strides[Axis];
+		TNext[Axis] += TDelta[Axis];
+	}
+}
+
+void FTileGrid::ConvertFromLayerMajor()
+{
+	FTileGrid Converted;
+	Converted.Reset(Size);
+
+	const int32 LayerSize = Size.X * Size.Y;
+	for (TConstSetBitIterator<> It(TileExists); It; ++It)
+	{
+		const int32 OldIndex = It.GetIndex();
+		const FIntVector MapPosition(OldIndex % Size.X, (OldIndex % LayerSize) / Size.X, OldIndex / LayerSize);
+		const int32 NewIndex = Converted.ToIndex(MapPosition);
+		Converted.TypeIDs[NewIndex] = TypeIDs[OldIndex];
+		Converted.TileExists[NewIndex] = true;
+	}
+	Converted.TileCount = TileCount;
+
+	*this = MoveTemp(Converted);
+}
+
+FArchive& operator<<(FArchive& Ar, FTileGrid& Grid)
+{
+	Ar << Grid.Size;
+	Ar << Grid.TypeIDs;
+	Ar << Grid.TileExists;
+	Ar << Grid.TileCount;
+	return Ar;
+}
@@ -0,0 +1,496 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "TilePathfinder.h"
+#include "Algo/Reverse.h"
+
+namespace
+{
+	// offsets of the cells adjacent to a cell on the same layer
+	const FIntVector NeighbourOffsets[] =
+	{
+		FIntVector(1, 0, 0),
+		FIntVector(-1, 0, 0),
+		FIntVector(0, 1, 0),
+		FIntVector(0, -1, 0)
+	};
+
+	// whether a map position lies within the box [Min, Max)
+	FORCEINLINE bool IsWithinBounds(const FIntVector& MapPosition, const FIntVector& Min, const FIntVector& Max)
+	{
+		return MapPosition.X >= Min.X && MapPosition.X < Max.X
+			&& MapPosition.Y >= Min.Y && MapPosition.Y < Max.Y
+			&& MapPosition.Z >= Min.Z && MapPosition.Z < Max.Z;
+	}
+
+	// a step from a cell to one next to it: the cell stepped onto and the extra cost of climbing to it
+	struct FStep
+	{
+		int32 Index;
+		FIntVector Position;
+		int32 ClimbCost;
+	};
+
+	// gather the cells within the bounds that can be stepped to from a cell: the four next to it on the same layer, and the
+	// ones above and below where a ramp or stairs joins them. Returns the number of steps written
+	FORCEINLINE int32 GatherSteps(const FPathGraph& Graph, int32 Index, const FIntVector& Position, const FIntVector& BoundsMin, const FIntVector& BoundsMax, FStep (&OutSteps)[6])
+	{
+		int32 NumSteps = 0;
+		for (const FIntVector& Offset : NeighbourOffsets)
+		{
+			const FIntVector AdjacentPosition = Position + Offset;
+			if (IsWithinBounds(AdjacentPosition, BoundsMin, BoundsMax))
+			{
+				OutSteps[NumSteps++] = FStep{ Graph.ToIndex(AdjacentPosition), AdjacentPosition, 0 };
+			}
+		}
+
+		// columns are contiguous so the cells above and below are the next and previous cells
+		if (Position.Z + 1 < BoundsMax.Z && Graph.ClimbCosts[Index] != INDEX_NONE)
+		{
+			OutSteps[NumSteps++] = FStep{ Index + 1, Position + FIntVector(0, 0, 1), Graph.ClimbCosts[Index] };
+		}
+		if (Position.Z > BoundsMin.Z && Graph.ClimbCosts[Index - 1] != INDEX_NONE)
+		{
+			OutSteps[NumSteps++] = FStep{ Index - 1, Position - FIntVector(0, 0, 1), Graph.ClimbCosts[Index - 1] };
+		}
+		return NumSteps;
+	}
+
+	// manhattan distance heuristic between two map positions
+	FORCEINLINE int32 Heuristic(const FIntVector& From, const FIntVector& To, int32 MinMoveCost)
+	{
+		const FIntVector Delta = To - From;
+		return (FMath::Abs(Delta.X) + FMath::Abs(Delta.Y) + FMath::Abs(Delta.Z)) * MinMoveCost;
+	}
+}
+
+// ---------- Path Graph ---------- //
+
+void FPathGraph::Reset(const FIntVector& NewSize)
+{
+	Size = NewSize;
+	const int32 NumCells = FMath::Max(Size.X * Size.Y * Size.Z, 0);
+
+	MoveCosts.Init(INDEX_NONE, NumCells);
+	OccupantTeams.Init(INDEX_NONE, NumCells);
+	ClimbCosts.Init(INDEX_NONE, NumCells);
+	MinMoveCost = 1;
+}
+
+// ---------- Movement Range ---------- //
+
+void FMovementRange::Reset()
+{
+	Tiles.Reset();
+	TileIndices.Reset();
+}
+
+const FReachableTile* FMovementRange::Find(const FIntVector& MapPosition) const
+{
+	const int32* TileIndex = TileIndices.Find(MapPosition);
+	return TileIndex ? &Tiles[*TileIndex] : nullptr;
+}
+
+bool FMovementRange::GetPathTo(const FIntVector& MapPosition, TArray<FIntVector>& OutPath) const
+{
+	OutPath.Reset();
+	for (const FReachableTile* Tile = Find(MapPosition); Tile; Tile = Find(Tile->Predecessor))
+	{
+		OutPath.Add(Tile->MapPosition);
+	}
+	// predecessors were walked from the end so reverse into start to end order
+	Algo::Reverse(OutPath);
+	return OutPath.Num() > 0;
+}
+
+// ---------- Path Tree ---------- //
+
+void FPathTree::Reset()
+{
+	Parents.Reset();
+	Costs.Reset();
+}
+
+bool FPathTree::GetPathTo(const FIntVector& MapPosition, TArray<FIntVector>& OutPath) const
+{
+	OutPath.Reset();
+
+	const bool bInBounds = MapPosition.X >= 0 && MapPosition.X < Size.X
+		&& MapPosition.Y >= 0 && MapPosition.Y < Size.Y
+		&& MapPosition.Z >= 0 && MapPosition.Z < Size.Z;
+	if (!IsValid() || !bInBounds)
+	{
+		return false;
+	}
+
+	// cells use the same layout as the path graph
+	for (int32 Index = MapPosition.Z + (MapPosition.X + MapPosition.Y * Size.X) * Size.Z; Parents[Index] != INDEX_NONE; Index = Parents[Index])
+	{
+		const int32 Column = Index / Size.Z;
+		OutPath.Add(FIntVector(Column % Size.X, Column / Size.X, Index % Size.Z));
+	}
+	// parents were walked from the end so reverse into start to end order
+	Algo::Reverse(OutPath);
+	return OutPath.Num() > 0;
+}
+
+// ---------- Pathfinder ---------- //
+
+FTilePathfinder::FTilePathfinder()
+	: SearchID(0)
+	, NumExpanded(0)
+	, CancelFlag(nullptr)
+{
+}
+
+bool FTilePathfinder::FindPath(const FPathGraph& Graph, const FIntVector& Start, const FIntVector& Target, int32 Team, TArray<FIntVector>& OutPath)
+{
+	OutPath.Reset();
+	NumExpanded = 0;
+
+	// there is no path to or from positions outside of the map
+	if (!Graph.IsValidPosition(Start) || !Graph.IsValidPosition(Target) || Start == Target)
+	{
+		return false;
+	}
+
+	const int32 StartIndex = Graph.ToIndex(Start);
+	const int32 TargetIndex = Graph.ToIndex(Target);
+	if (!RunSearch(Graph, StartIndex, TargetIndex, Team, MAX_int32, FIntVector::ZeroValue, Graph.Size, false))
+	{
+		return false;
+	}
+	BuildPath(Graph, StartIndex, TargetIndex, OutPath);
+	return true;
+}
+
+bool FTilePathfinder::FindPathWithinBounds(const FPathGraph& Graph, const FIntVector& Start, const FIntVector& Target, int32 Team, const FIntVector& BoundsMin, const FIntVector& BoundsMax, TArray<FIntVector>& OutPath)
+{
+	OutPath.Reset();
+	NumExpanded = 0;
+
+	if (!Graph.IsValidPosition(Start) || !Graph.IsValidPosition(Target) || Start == Target
+		|| !IsWithinBounds(Start, BoundsMin, BoundsMax) || !IsWithinBounds(Target, BoundsMin, BoundsMax))
+	{
+		return false;
+	}
+
+	const int32 StartIndex = Graph.ToIndex(Start);
+	const int32 TargetIndex = Graph.ToIndex(Target);
+	if (!RunSearch(Graph, StartIndex, TargetIndex, Team, MAX_int32, BoundsMin, BoundsMax, false))
+	{
+		return false;
+	}
+	BuildPath(Graph, StartIndex, TargetIndex, OutPath);
+	return true;
+}
+
+void FTilePathfinder::FindCostsWithinBounds(const FPathGraph& Graph, const FIntVector& Start, int32 Team, const FIntVector& BoundsMin, const FIntVector& BoundsMax, bool bCostsToStart, const TArray<int32>& Cells, TArray<int32>& OutCosts)
+{
+	OutCosts.Init(MAX_int32, Cells.Num());
+	NumExpanded = 0;
+
+	// every cost is unreachable from a start with no tile that can be entered
+	if (!Graph.IsValidPosition(Start) || !IsWithinBounds(Start, BoundsMin, BoundsMax) || Graph.MoveCosts[Graph.ToIndex(Start)] == INDEX_NONE)
+	{
+		return;
+	}
+
+	RunSearch(Graph, Graph.ToIndex(Start), INDEX_NONE, Team, MAX_int32, BoundsMin, BoundsMax, bCostsToStart);
+
+	// only cells that were expanded by this search have been reached
+	for (int32 i = 0; i < Cells.Num(); i++)
+	{
+		const FNode& Node = Nodes[Cells[i]];
+		if (Node.SearchID == SearchID && Node.HeapIndex == ClosedIndex)
+		{
+			OutCosts[i] = Node.CostToHere;
+		}
+	}
+}
+
+void FTilePathfinder::FindReachableTiles(const FPathGraph& Graph, const FIntVector& Start, int32 Team, int32 CostBudget, FMovementRange& OutRange)
+{
+	OutRange.Reset();
+	OutRange.Start = Start;
+	NumExpanded = 0;
+
+	if (!Graph.IsValidPosition(Start))
+	{
+		return;
+	}
+
+	const int32 StartIndex = Graph.ToIndex(Start);
+	RunSearch(Graph, StartIndex, INDEX_NONE, Team, CostBudget, FIntVector::ZeroValue, Graph.Size, false);
+
+	// cells were expanded in order of increasing cost, the first one being the start itself
+	OutRange.Tiles.Reserve(ExpandedCells.Num());
+	for (int32 CellIndex : ExpandedCells)
+	{
+		if (CellIndex == StartIndex)
+		{
+			continue;
+		}
+		const FNode& Node = Nodes[CellIndex];
+
+		FReachableTile Tile;
+		Tile.MapPosition = Graph.ToPosition(CellIndex);
+		Tile.Cost = Node.CostToHere;
+		Tile.Predecessor = Graph.ToPosition(Node.Parent);
+		Tile.bCanStop = Graph.OccupantTeams[CellIndex] == INDEX_NONE;
+
+		OutRange.TileIndices.Add(Tile.MapPosition, OutRange.Tiles.Add(Tile));
+	}
+}
+
+void FTilePathfinder::BuildPathTree(const FPathGraph& Graph, const FIntVector& Start, int32 Team, FPathTree& OutTree)
+{
+	OutTree.Start = Start;
+	OutTree.Size = Graph.Size;
+	OutTree.Parents.Init(INDEX_NONE, Graph.Num());
+	OutTree.Costs.Init(MAX_int32, Graph.Num());
+	NumExpanded = 0;
+
+	// a start with no tile that can be entered, such as a wall or a hole, reaches nothing
+	if (!Graph.IsValidPosition(Start) || Graph.MoveCosts[Graph.ToIndex(Start)] == INDEX_NONE)
+	{
+		return;
+	}
+
+	// flood the whole map from the start with no budget
+	const int32 StartIndex = Graph.ToIndex(Start);
+	RunSearch(Graph, StartIndex, INDEX_NONE, Team, MAX_int32, FIntVector::ZeroValue, Graph.Size, false);
+
+	for (int32 CellIndex : ExpandedCells)
+	{
+		const FNode& Node = Nodes[CellIndex];
+		OutTree.Parents[CellIndex] = CellIndex == StartIndex ? INDEX_NONE : Node.Parent;
+		OutTree.Costs[CellIndex] = Node.CostToHere;
+	}
+
+	// the flood doesn't step onto cells held by enemies, but a path may still end on one so attach them to their cheapest neighbour
+	for (int32 CellIndex : ExpandedCells)
+	{
+		FStep Steps[6];
+		const int32 NumSteps = GatherSteps(Graph, CellIndex, Graph.ToPosition(CellIndex), FIntVector::ZeroValue, Graph.Size, Steps);
+		for (int32 StepIndex = 0; StepIndex < NumSteps; StepIndex++)
+		{
+			const int32 AdjacentIndex = Steps[StepIndex].Index;
+			if (AdjacentIndex == StartIndex || Graph.MoveCosts[AdjacentIndex] == INDEX_NONE || Graph.CanEnter(AdjacentIndex, Team))
+			{
+				continue;
+			}
+			const int32 NewCost = OutTree.Costs[CellIndex] + Steps[StepIndex].ClimbCost + Graph.MoveCosts[AdjacentIndex];
+			if (NewCost < OutTree.Costs[AdjacentIndex])
+			{
+				OutTree.Costs[AdjacentIndex] = NewCost;
+				OutTree.Parents[AdjacentIndex] = CellIndex;
+			}
+		}
+	}
+}
+
+bool FTilePathfinder::RunSearch(const FPathGraph& Graph, int32 StartIndex, int32 TargetIndex, int32 Team, int32 CostBudget, const FIntVector& BoundsMin, const FIntVector& BoundsMax, bool bReverseCosts)
+{
+	// start a new search even if there is nothing to search, so callers never read back the cells of the last one
+	BeginSearch(Graph);
+
+	if (Graph.MoveCosts[StartIndex] == INDEX_NONE || (TargetIndex != INDEX_NONE && Graph.MoveCosts[TargetIndex] == INDEX_NONE))
+	{
+		return false;
+	}
+
+	// the heuristic is only admissible if it is scaled by the cheapest possible step. With no target there is no heuristic
+	const FIntVector Target = TargetIndex != INDEX_NONE ? Graph.ToPosition(TargetIndex) : FIntVector::ZeroValue;
+	const int32 HeuristicScale = TargetIndex != INDEX_NONE ? FMath::Max(Graph.MinMoveCost, 0) : 0;
+
+	// open the starting cell
+	const FIntVector Start = Graph.ToPosition(StartIndex);
+	FNode& StartNode = TouchNode(StartIndex);
+	StartNode.CostToHere = 0;
+	StartNode.Score = Heuristic(Start, Target, HeuristicScale);
+	HeapPush(StartIndex);
+
+	while (OpenHeap.Num() > 0)
+	{
+		// expand the open cell with the lowest predicted score to the target
+		const int32 CurrentIndex = HeapPop();
+		ExpandedCells.Add(CurrentIndex);
+		if (CurrentIndex == TargetIndex)
+		{
+			return true;
+		}
+		NumExpanded++;
+
+		// checking every expansion would be wasteful, a cancelled search can afford to run on a little
+		if (CancelFlag && (NumExpanded & 255) == 0 && *CancelFlag)
+		{
+			return false;
+		}
+
+		const FIntVector CurrentPosition = Graph.ToPosition(CurrentIndex);
+		const int32 CurrentCost = Nodes[CurrentIndex].CostToHere;
+
+		FStep Steps[6];
+		const int32 NumSteps = GatherSteps(Graph, CurrentIndex, CurrentPosition, BoundsMin, BoundsMax, Steps);
+		for (int32 StepIndex = 0; StepIndex < NumSteps; StepIndex++)
+		{
+			const FIntVector& AdjacentPosition = Steps[StepIndex].Position;
+			const int32 AdjacentIndex = Steps[StepIndex].Index;
+
+			// the target can always be stepped onto, any other cell must be free or held by an ally
+			if (AdjacentIndex != TargetIndex ? !Graph.CanEnter(AdjacentIndex, Team) : Graph.MoveCosts[AdjacentIndex] == INDEX_NONE)
+			{
+				continue;
+			}
+
+			// a reversed search finds the cost of moving from each cell to the start, so pays for the cell being left rather than entered
+			// cells that cost more than the budget to reach are never opened
+			const int32 NewCost = CurrentCost + Steps[StepIndex].ClimbCost + Graph.MoveCosts[bReverseCosts ? CurrentIndex : AdjacentIndex];
+			if (NewCost > CostBudget)
+			{
+				continue;
+			}
+
+			FNode& AdjacentNode = TouchNode(AdjacentIndex);
+			// if the cell has been expanded then the shortest path to it has already been found
+			if (AdjacentNode.HeapIndex == ClosedIndex)
+			{
+				continue;
+			}
+
+			if (AdjacentNode.HeapIndex == INDEX_NONE)
+			{
+				// first time this cell has been seen, add it to the open set
+				AdjacentNode.CostToHere = NewCost;
+				AdjacentNode.Score = NewCost + Heuristic(AdjacentPosition, Target, HeuristicScale);
+				AdjacentNode.Parent = CurrentIndex;
+				HeapPush(AdjacentIndex);
+			}
+			else if (NewCost < AdjacentNode.CostToHere)
+			{
+				// already open but now reachable more cheaply, so reparent it and move it up the heap
+				AdjacentNode.Score -= AdjacentNode.CostToHere - NewCost;
+				AdjacentNode.CostToHere = NewCost;
+				AdjacentNode.Parent = CurrentIndex;
+				HeapSiftUp(AdjacentNode.HeapIndex);
+			}
+		}
+	}
+
+	// open set exhausted without reaching the target (always the case for a flood fill)
+	return false;
+}
+
+void FTilePathfinder::BeginSearch(const FPathGraph& Graph)
+{
+	// grow the node array if the graph has grown. New nodes have a search ID of 0 which never matches a live search
+	if (Nodes.Num() != Graph.Num())
+	{
+		Nodes.SetNumZeroed(Graph.Num());
+	}
+
+	OpenHeap.Reset();
+	ExpandedCells.Reset();
+
+	SearchID++;
+	// on wrap around clear the stale IDs so old nodes can't be mistaken for ones from this search
+	if (SearchID == 0)
+	{
+		for (FNode& Node : Nodes)
+		{
+			Node.SearchID = 0;
+		}
+		SearchID = 1;
+	}
+}
+
+FTilePathfinder::FNode& FTilePathfinder::TouchNode(int32 Index)
+{
+	FNode& Node = Nodes[Index];
+	if (Node.SearchID != SearchID)
+	{
+		Node.CostToHere = MAX_int32;
+		Node.Score = MAX_int32;
+		Node.Parent = INDEX_NONE;
+		Node.HeapIndex = INDEX_NONE;
+		Node.SearchID = SearchID;
+	}
+	return Node;
+}
+
+void FTilePathfinder::HeapPush(int32 Index)
+{
+	Nodes[Index].HeapIndex = OpenHeap.Add(Index);
+	HeapSiftUp(Nodes[Index].HeapIndex);
+}
+
+int32 FTilePathfinder::HeapPop()
+{
+	const int32 Top = OpenHeap[0];
+	HeapSwap(0, OpenHeap.Num() - 1);
+	OpenHeap.Pop(false);
+	if (OpenHeap.Num() > 0)
+	{
+		HeapSiftDown(0);
+	}
+	Nodes[Top].HeapIndex = ClosedIndex;
+	return Top;
+}
+
+void FTilePathfinder::HeapSiftUp(int32 HeapPosition)
+{
+	while (HeapPosition > 0)
+	{
+		const int32 ParentPosition = (HeapPosition - 1) / 2;
+		if (Nodes[OpenHeap[HeapPosition]].Score >= Nodes[OpenHeap[ParentPosition]].Score)
+		{
+			break;
+		}
+		HeapSwap(HeapPosition, ParentPosition);
+		HeapPosition = ParentPosition;
+	}
+}
+
+void FTilePathfinder::HeapSiftDown(int32 HeapPosition)
+{
+	const int32 HeapSize = OpenHeap.Num();
+	while (true)
+	{
+		const int32 Left = HeapPosition * 2 + 1;
+		const int32 Right = Left + 1;
+		int32 Smallest = HeapPosition;
+		if (Left < HeapSize && Nodes[OpenHeap[Left]].Score < Nodes[OpenHeap[Smallest]].Score)
+		{
+			Smallest = Left;
+		}
+		if (Right < HeapSize && Nodes[OpenHeap[Right]].Score < Nodes[OpenHeap[Smallest]].Score)
+		{
+			Smallest = Right;
+		}
+		if (Smallest == HeapPosition)
+		{
+			break;
+		}
+		HeapSwap(HeapPosition, Smallest);
+		HeapPosition = Smallest;
+	}
+}
+
+void FTilePathfinder::HeapSwap(int32 PositionA, int32 PositionB)
+{
+	Swap(OpenHeap[PositionA], OpenHeap[PositionB]);
+	Nodes[OpenHeap[PositionA]].HeapIndex = PositionA;
+	Nodes[OpenHeap[PositionB]].HeapIndex = PositionB;
+}
+
+void FTilePathfinder::BuildPath(const FPathGraph& Graph, int32 StartIndex, int32 EndIndex, TArray<FIntVector>& OutPath) const
+{
+	OutPath.Reset();
+	for (int32 Index = EndIndex; Index != StartIndex && Index != INDEX_NONE; Index = Nodes[Index].Parent)
+	{
+		OutPath.Add(Graph.ToPosition(Index));
+	}
+	// parents were walked from the end so reverse into start to end order
+	Algo::Reverse(OutPath);
+}
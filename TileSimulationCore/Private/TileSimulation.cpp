@@ -0,0 +1,171 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "TileSimulation.h"
+#include "TilePathfinder.h"
+
+FTileSimulation::FTileSimulation()
+{
+}
+
+void FTileSimulation::SyncUnitsToGrid(TArray<int32>* OutRemovedUnits)
+{
+	Units.Resize(Tiles.GetSize(), OutRemovedUnits);
+}
+
+void FTileSimulation::BuildPathGraph(FPathGraph& OutGraph) const
+{
+	// the graph has the same layout as the tile grid so cells map across directly
+	const FIntVector& GridSize = Tiles.GetSize();
+	OutGraph.Reset(GridSize);
+
+	int32 MinMoveCost = MAX_int32;
+	Tiles.ForEachTile([this, &OutGraph, &MinMoveCost](int32 CellIndex, int32 TileTypeID)
+	{
+		// tiles with no type data or a negative move cost cannot be moved onto
+		const int32 MoveCost = TileTypes.GetMoveCost(TileTypeID);
+		OutGraph.MoveCosts[CellIndex] = MoveCost;
+		if (MoveCost != INDEX_NONE)
+		{
+			MinMoveCost = FMath::Min(MinMoveCost, MoveCost);
+			OutGraph.ClimbCosts[CellIndex] = TileTypes.GetClimbCost(TileTypeID);
+		}
+	});
+
+	// ramps and stairs only join a cell to the one above if there is a tile there that can be moved onto
+	// columns are contiguous in the graph so the cell above is the next cell
+	for (int32 CellIndex = 0; CellIndex < OutGraph.Num(); CellIndex++)
+	{
+		if (OutGraph.ClimbCosts[CellIndex] != INDEX_NONE
+			&& ((CellIndex + 1) % GridSize.Z == 0 || OutGraph.MoveCosts[CellIndex + 1] == INDEX_NONE))
+		{
+			OutGraph.ClimbCosts[CellIndex] = INDEX_NONE;
+		}
+	}
+	OutGraph.MinMoveCost = MinMoveCost == MAX_int32 ? 1 : MinMoveCost;
+
+	// the occupancy grid has the same layout too, so the teams on each cell are a straight copy
+	check(Units.GetTeamGrid().Num() == OutGraph.Num());
+	OutGraph.OccupantTeams = Units.GetTeamGrid();
+}
+
+int32 FTileSimulation::AddUnit(int32 Team, const FIntVector& MapPosition, const FUnitStatBlock& Stats, int32 HitPoints, int32 AbilityPoints)
+{
+	const int32 UnitID = Units.AddUnit(Team, MapPosition);
+	if (UnitID != INDEX_NONE)
+	{
+		if (UnitID >= UnitStates.Num())
+		{
+			UnitStates.SetNum(UnitID + 1);
+		}
+		FSimUnit& Unit = UnitStates[UnitID];
+		Unit.Stats = Stats;
+		Unit.HitPoints = FMath::Min(HitPoints, Stats.Get(ESimStat::MaxHitPoints));
+		Unit.AbilityPoints = FMath::Min(AbilityPoints, Stats.Get(ESimStat::MaxAbilityPoints));
+	}
+	return UnitID;
+}
+
+bool FTileSimulation::MoveUnit(int32 UnitID, const FIntVector& NewMapPosition)
+{
+	return Units.MoveUnit(UnitID, NewMapPosition);
+}
+
+void FTileSimulation::RemoveUnit(int32 UnitID)
+{
+	Units.RemoveUnit(UnitID);
+}
+
+void FTileSimulation::EmptyUnits()
+{
+	Units.Empty();
+	UnitStates.Reset();
+}
+
+void FTileSimulation::SetUnitStats(int32 UnitID, const FUnitStatBlock& Stats)
+{
+	FSimUnit& Unit = UnitStates[UnitID];
+	Unit.Stats = Stats;
+
+	// a lower maximum takes effect straight away
+	Unit.HitPoints = FMath::Min(Unit.HitPoints, Stats.Get(ESimStat::MaxHitPoints));
+	Unit.AbilityPoints = FMath::Min(Unit.AbilityPoints, Stats.Get(ESimStat::MaxAbilityPoints));
+}
+
+void FTileSimulation::SerializeUnits(FArchive& Ar)
+{
+	Ar << Units;
+
+	int32 NumStates = UnitStates.Num();
+	Ar << NumStates;
+	if (Ar.IsLoading())
+	{
+		UnitStates.SetNum(NumStates);
+	}
+	for (FSimUnit& Unit : UnitStates)
+	{
+		Ar << Unit.Stats;
+		Ar << Unit.HitPoints;
+		Ar << Unit.AbilityPoints;
+	}
+}
+
+int32 FTileSimulation::GetDamageDealt(int32 UnitID, int32 RawDamage) const
+{
+	int32 Damage = RawDamage + UnitStates[UnitID].Stats.Get(ESimStat::Damage);
+
+	if (Units.IsValidUnit(UnitID))
+	{
+		if (const FTileTypeInfo* TypeInfo = TileTypes.Find(Tiles.GetTileTypeID(Units.GetUnitPosition(UnitID))))
+		{
+			Damage += TypeInfo->AttackModifier;
+		}
+	}
+	return Damage;
+}
+
+int32 FTileSimulation::GetDamageTaken(int32 UnitID, int32 RawDamage, bool bMagicDamage) const
+{
+	const FSimUnit& Unit = UnitStates[UnitID];
+	int32 Mitigation = Unit.Stats.Get(bMagicDamage ? ESimStat::MagicResist : ESimStat::Armour);
+
+	if (Units.IsValidUnit(UnitID))
+	{
+		if (const FTileTypeInfo* TypeInfo = TileTypes.Find(Tiles.GetTileTypeID(Units.GetUnitPosition(UnitID))))
+		{
+			Mitigation += TypeInfo->DefenseModifier;
+		}
+	}
+
+	// damage can't be negative
+	return FMath::Max(RawDamage - Mitigation, 0);
+}
+
+bool FTileSimulation::ReduceHitPoints(int32 UnitID, int32 DamageTaken)
+{
+	FSimUnit& Unit = UnitStates[UnitID];
+	if (Unit.HitPoints <= 0)
+	{
+		return false;
+	}
+
+	Unit.HitPoints -= DamageTaken;
+	if (Unit.HitPoints <= 0)
+	{
+		Unit.HitPoints = 0;
+		return true;
+	}
+	return false;
+}
+
+void FTileSimulation::Heal(int32 UnitID, int32 Amount)
+{
+	FSimUnit& Unit = UnitStates[UnitID];
+	Unit.HitPoints = FMath::Min(Unit.HitPoints + Amount, Unit.Stats.Get(ESimStat::MaxHitPoints));
+}
+
+void FTileSimulation::StartUnitTurn(int32 UnitID)
+{
+	// generate ability points at the unit's current rate, keeping them between 0 and the maximum
+	FSimUnit& Unit = UnitStates[UnitID];
+	Unit.AbilityPoints = FMath::Clamp(Unit.AbilityPoints + Unit.Stats.Get(ESimStat::AbilityPointRate), 0, Unit.Stats.Get(ESimStat::MaxAbilityPoints));
+}
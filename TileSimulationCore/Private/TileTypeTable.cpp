@@ -0,0 +1,30 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "TileTypeTable.h"
+
+FTileTypeTable::FTileTypeTable()
+{
+}
+
+void FTileTypeTable::SetType(int32 TileTypeID, const FTileTypeInfo& Info)
+{
+	check(TileTypeID >= 0 && TileTypeID <= MAX_uint8);
+	if (TileTypeID >= Types.Num())
+	{
+		const int32 NumAdded = TileTypeID + 1 - Types.Num();
+		Types.AddZeroed(NumAdded);
+		// IDs that haven't been set can't be moved onto
+		for (int32 Index = Types.Num() - NumAdded; Index < Types.Num(); Index++)
+		{
+			Types[Index].MoveCost = INDEX_NONE;
+			Types[Index].ClimbCost = INDEX_NONE;
+		}
+	}
+	Types[TileTypeID] = Info;
+	Types[TileTypeID].bValid = true;
+}
+
+void FTileTypeTable::Empty()
+{
+	Types.Reset();
+}
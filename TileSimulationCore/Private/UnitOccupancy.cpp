@@ -0,0 +1,183 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "UnitOccupancy.h"
+
+FUnitOccupancy::FUnitOccupancy()
+	: Size(0, 0, 0)
+	, UnitCount(0)
+{
+}
+
+void FUnitOccupancy::Resize(const FIntVector& NewSize, TArray<int32>* OutRemovedUnits)
+{
+	Size = FIntVector(FMath::Max(NewSize.X, 0), FMath::Max(NewSize.Y, 0), FMath::Max(NewSize.Z, 0));
+	const int32 NumCells = Size.X * Size.Y * Size.Z;
+	UnitGrid.Init(INDEX_NONE, NumCells);
+	TeamGrid.Init(INDEX_NONE, NumCells);
+
+	// put the units back on the resized grids, dropping any that are now off the map
+	for (int32 UnitID = 0; UnitID < Units.Num(); UnitID++)
+	{
+		if (!Units[UnitID].bActive)
+		{
+			continue;
+		}
+		if (IsValidPosition(Units[UnitID].MapPosition))
+		{
+			const int32 CellIndex = ToIndex(Units[UnitID].MapPosition);
+			UnitGrid[CellIndex] = UnitID;
+			TeamGrid[CellIndex] = Units[UnitID].Team;
+		}
+		else
+		{
+			RemoveUnit(UnitID);
+			if (OutRemovedUnits)
+			{
+				OutRemovedUnits->Add(UnitID);
+			}
+		}
+	}
+}
+
+void FUnitOccupancy::Empty()
+{
+	UnitGrid.Init(INDEX_NONE, UnitGrid.Num());
+	TeamGrid.Init(INDEX_NONE, TeamGrid.Num());
+	Units.Reset();
+	FreeUnitIDs.Reset();
+	TeamUnits.Reset();
+	UnitCount = 0;
+}
+
+int32 FUnitOccupancy::AddUnit(int32 Team, const FIntVector& MapPosition)
+{
+	if (GetUnitAt(MapPosition) != INDEX_NONE || !IsValidPosition(MapPosition))
+	{
+		return INDEX_NONE;
+	}
+
+	const int32 UnitID = FreeUnitIDs.Num() > 0 ? FreeUnitIDs.Pop(false) : Units.AddUninitialized();
+	TArray<int32>& TeamList = TeamUnits.FindOrAdd(Team);
+
+	FUnitRecord& Unit = Units[UnitID];
+	Unit.MapPosition = MapPosition;
+	Unit.Team = Team;
+	Unit.TeamSlot = TeamList.Add(UnitID);
+	Unit.bActive = true;
+
+	const int32 CellIndex = ToIndex(MapPosition);
+	UnitGrid[CellIndex] = UnitID;
+	TeamGrid[CellIndex] = Team;
+	UnitCount++;
+
+	return UnitID;
+}
+
+bool FUnitOccupancy::MoveUnit(int32 UnitID, const FIntVector& NewMapPosition)
+{
+	if (!IsValidUnit(UnitID) || !IsValidPosition(NewMapPosition))
+	{
+		return false;
+	}
+	FUnitRecord& Unit = Units[UnitID];
+	if (Unit.MapPosition == NewMapPosition)
+	{
+		return true;
+	}
+	if (GetUnitAt(NewMapPosition) != INDEX_NONE)
+	{
+		return false;
+	}
+
+	// clear the old cell, which may be off the grid if the unit was placed before a resize
+	if (IsValidPosition(Unit.MapPosition))
+	{
+		const int32 OldCellIndex = ToIndex(Unit.MapPosition);
+		UnitGrid[OldCellIndex] = INDEX_NONE;
+		TeamGrid[OldCellIndex] = INDEX_NONE;
+	}
+
+	const int32 NewCellIndex = ToIndex(NewMapPosition);
+	UnitGrid[NewCellIndex] = UnitID;
+	TeamGrid[NewCellIndex] = Unit.Team;
+	Unit.MapPosition = NewMapPosition;
+	return true;
+}
+
+void FUnitOccupancy::RemoveUnit(int32 UnitID)
+{
+	if (!IsValidUnit(UnitID))
+	{
+		return;
+	}
+	FUnitRecord& Unit = Units[UnitID];
+
+	if (IsValidPosition(Unit.MapPosition) && UnitGrid[ToIndex(Unit.MapPosition)] == UnitID)
+	{
+		const int32 CellIndex = ToIndex(Unit.MapPosition);
+		UnitGrid[CellIndex] = INDEX_NONE;
+		TeamGrid[CellIndex] = INDEX_NONE;
+	}
+
+	// swap remove from the team list, fixing up the slot of the unit that moved into the gap
+	TArray<int32>& TeamList = TeamUnits.FindChecked(Unit.Team);
+	const int32 MovedUnitID = TeamList.Last();
+	TeamList.RemoveAtSwap(Unit.TeamSlot, 1, false);
+	if (MovedUnitID != UnitID)
+	{
+		Units[MovedUnitID].TeamSlot = Unit.TeamSlot;
+	}
+
+	Unit.bActive = false;
+	FreeUnitIDs.Add(UnitID);
+	UnitCount--;
+}
+
+const TArray<int32>& FUnitOccupancy::GetTeamUnits(int32 Team) const
+{
+	static const TArray<int32> NoUnits;
+	const TArray<int32>* TeamList = TeamUnits.Find(Team);
+	return TeamList ? *TeamList : NoUnits;
+}
+
+FArchive& operator<<(FArchive& Ar, FUnitOccupancy& Occupancy)
+{
+	Ar << Occupancy.Size;
+
+	int32 NumRecords = Occupancy.Units.Num();
+	Ar << NumRecords;
+	if (Ar.IsLoading())
+	{
+		Occupancy.Units.SetNumUninitialized(NumRecords);
+	}
+	for (FUnitOccupancy::FUnitRecord& Unit : Occupancy.Units)
+	{
+		Ar << Unit.MapPosition;
+		Ar << Unit.Team;
+		Ar << Unit.TeamSlot;
+		Ar << Unit.bActive;
+	}
+
+	// the free list and team lists are kept in order so IDs are handed out and teams listed as they were
+	Ar << Occupancy.FreeUnitIDs;
+	Ar << Occupancy.TeamUnits;
+	Ar << Occupancy.UnitCount;
+
+	// the grids are rebuilt from the units rather than saved
+	if (Ar.IsLoading())
+	{
+		const int32 NumCells = Occupancy.Size.X * Occupancy.Size.Y * Occupancy.Size.Z;
+		Occupancy.UnitGrid.Init(INDEX_NONE, NumCells);
+		Occupancy.TeamGrid.Init(INDEX_NONE, NumCells);
+		for (int32 UnitID = 0; UnitID < Occupancy.Units.Num(); UnitID++)
+		{
+			const FUnitOccupancy::FUnitRecord& Unit = Occupancy.Units[UnitID];
+			if (Unit.bActive && Occupancy.IsValidPosition(Unit.MapPosition))
+			{
+				Occupancy.UnitGrid[Occupancy.ToIndex(Unit.MapPosition)] = UnitID;
+				Occupancy.TeamGrid[Occupancy.ToIndex(Unit.MapPosition)] = Unit.Team;
+			}
+		}
+	}
+	return Ar;
+}
@@ -0,0 +1,19 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "UnitStatBlock.h"
+
+FUnitStatBlock::FUnitStatBlock()
+	: bTargetable(true)
+{
+	FMemory::Memzero(Stats);
+}
+
+FArchive& operator<<(FArchive& Ar, FUnitStatBlock& Block)
+{
+	for (int32& Stat : Block.Stats)
+	{
+		Ar << Stat;
+	}
+	Ar << Block.bTargetable;
+	return Ar;
+}
@@ -0,0 +1,119 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// ---------- Tile Grid ---------- //
+// dense storage for the tiles of a map. Tile type IDs are held in a contiguous array indexed by Z + (X + Y * SizeX) * SizeZ
+// with a bit per cell recording whether there is a tile there at all, so irregularly shaped maps are still supported.
+// Costs a byte and a bit per cell. Each column of layers is contiguous so moving up or down a layer is a step of one cell,
+// and on a single layer map the layout is the same as the rows of the source image.
+
+class TILESIMULATIONCORE_API FTileGrid
+{
+public:
+	// ctor
+	FTileGrid();
+
+	// resize the grid and remove every tile
+	void Reset(const FIntVector& NewSize);
+
+	// remove every tile and free the memory
+	void Empty();
+
+	// place a tile of the given type at a map position, replacing any tile that was there
+	// the grid grows if the position is beyond its current size. Positions with negative coordinates are rejected
+	bool SetTile(const FIntVector& MapPosition, int32 TileTypeID);
+
+	// remove the tile at a map position if there is one
+	void RemoveTile(const FIntVector& MapPosition);
+
+	// number of cells in each direction
+	FORCEINLINE const FIntVector& GetSize() const { return Size; }
+
+	// number of cells and number of cells with a tile in them
+	FORCEINLINE int32 NumCells() const { return TypeIDs.Num(); }
+	FORCEINLINE int32 NumTiles() const { return TileCount; }
+
+	// whether the map position lies within the bounds of the grid
+	FORCEINLINE bool IsValidPosition(const FIntVector& MapPosition) const
+	{
+		return MapPosition.X >= 0 && MapPosition.X < Size.X
+			&& MapPosition.Y >= 0 && MapPosition.Y < Size.Y
+			&& MapPosition.Z >= 0 && MapPosition.Z < Size.Z;
+	}
+
+	// convert between map positions and cell indices. Positions must be valid
+	FORCEINLINE int32 ToIndex(const FIntVector& MapPosition) const
+	{
+		return MapPosition.Z + (MapPosition.X + MapPosition.Y * Size.X) * Size.Z;
+	}
+	FORCEINLINE FIntVector ToPosition(int32 Index) const
+	{
+		const int32 Column = Index / Size.Z;
+		return FIntVector(Column % Size.X, Column / Size.X, Index % Size.Z);
+	}
+
+	// whether there is a tile in a cell
+	FORCEINLINE bool HasTileAt(int32 Index) const { return TileExists[Index]; }
+	FORCEINLINE bool HasTile(const FIntVector& MapPosition) const
+	{
+		return IsValidPosition(MapPosition) && TileExists[ToIndex(MapPosition)];
+	}
+
+	// type of the tile in a cell. Only meaningful if there is a tile in the cell
+	FORCEINLINE int32 GetTileTypeIDAt(int32 Index) const { return TypeIDs[Index]; }
+
+	// type of the tile at a map position, INDEX_NONE if there is no tile there
+	FORCEINLINE int32 GetTileTypeID(const FIntVector& MapPosition) const
+	{
+		if (!IsValidPosition(MapPosition))
+		{
+			return INDEX_NONE;
+		}
+		const int32 Index = ToIndex(MapPosition);
+		return TileExists[Index] ? TypeIDs[Index] : INDEX_NONE;
+	}
+
+	// call Func(CellIndex, TileTypeID) for every cell that has a tile in it, in cell order
+	template<typename FuncType>
+	void ForEachTile(FuncType Func) const
+	{
+		for (TConstSetBitIterator<> It(TileExists); It; ++It)
+		{
+			Func(It.GetIndex(), (int32)TypeIDs[It.GetIndex()]);
+		}
+	}
+
+	// raw storage, for writing the grid out in bulk. The bits of TileExists are packed 32 to a word
+	FORCEINLINE const TArray<uint8>& GetTypeIDs() const { return TypeIDs; }
+	FORCEINLINE const TBitArray<>& GetTileExists() const { return TileExists; }
+
+	// replace the whole grid with raw storage read back in bulk, in the same layout as GetTypeIDs and GetTileExists
+	void SetFromRaw(const FIntVector& NewSize, const uint8* RawTypeIDs, const uint32* RawTileExists, int32 NumTilesSet);
+
+	// walk the segment from Start to End through the cells in order (3D DDA) and find the first cell with a tile in it
+	// positions are in map space, where each cell is a unit cube centred on its map position. The cost is proportional
+	// to the number of cells crossed. Returns false if the segment doesn't pass through a tile
+	bool Raycast(const FVector& Start, const FVector& End, FIntVector& OutMapPosition) const;
+
+	// reorder a grid loaded from before columns were contiguous, when cells were indexed by X + Y * SizeX + Z * SizeX * SizeY
+	void ConvertFromLayerMajor();
+
+	friend TILESIMULATIONCORE_API FArchive& operator<<(FArchive& Ar, FTileGrid& Grid);
+
+private:
+	FIntVector Size;
+
+	// type of the tile in each cell
+	TArray<uint8> TypeIDs;
+
+	// whether each cell has a tile in it
+	TBitArray<> TileExists;
+
+	int32 TileCount;
+
+	// grow the grid to at least the given size, keeping the tiles where they are
+	void Grow(const FIntVector& MinimumSize);
+};
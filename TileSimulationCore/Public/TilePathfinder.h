@@ -0,0 +1,240 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/ThreadSafeBool.h"
+
+// ---------- Path Graph ---------- //
+// dense, read-only description of the map that the pathfinder searches over
+// cells are indexed the same way as FTileGrid (Z + (X + Y * SizeX) * SizeZ) so per-query node state can live in flat arrays
+// and the cells above and below a cell are next to it
+
+struct TILESIMULATIONCORE_API FPathGraph
+{
+public:
+
+	FPathGraph()
+		: Size(0, 0, 0)
+		, MinMoveCost(1)
+	{}
+
+	// number of cells in each direction
+	FIntVector Size;
+
+	// cost of entering each cell, INDEX_NONE if there is no tile that can be entered at that cell
+	TArray<int32> MoveCosts;
+
+	// team of the unit occupying each cell, INDEX_NONE if the cell is unoccupied
+	TArray<int32> OccupantTeams;
+
+	// extra cost of climbing between each cell and the cell above it (a ramp or stairs), INDEX_NONE if they aren't joined
+	TArray<int32> ClimbCosts;
+
+	// smallest move cost of any tile in the graph. Scales the heuristic so that it never overestimates
+	int32 MinMoveCost;
+
+	// resize the graph and mark every cell as having no tile and no unit
+	void Reset(const FIntVector& NewSize);
+
+	// total number of cells
+	FORCEINLINE int32 Num() const { return MoveCosts.Num(); }
+
+	// whether the map position lies within the bounds of the graph
+	FORCEINLINE bool IsValidPosition(const FIntVector& MapPosition) const
+	{
+		return MapPosition.X >= 0 && MapPosition.X < Size.X
+			&& MapPosition.Y >= 0 && MapPosition.Y < Size.Y
+			&& MapPosition.Z >= 0 && MapPosition.Z < Size.Z;
+	}
+
+	// convert between map positions and cell indices. Positions must be valid
+	FORCEINLINE int32 ToIndex(const FIntVector& MapPosition) const
+	{
+		return MapPosition.Z + (MapPosition.X + MapPosition.Y * Size.X) * Size.Z;
+	}
+	FORCEINLINE FIntVector ToPosition(int32 Index) const
+	{
+		const int32 Column = Index / Size.Z;
+		return FIntVector(Column % Size.X, Column / Size.X, Index % Size.Z);
+	}
+
+	// team to search as when only the terrain matters and units should be ignored
+	static const int32 IgnoreUnits = MIN_int32;
+
+	// whether a unit of the given team may step onto the cell. Units can move through allied units but not through enemies
+	FORCEINLINE bool CanEnter(int32 Index, int32 Team) const
+	{
+		return MoveCosts[Index] != INDEX_NONE && (Team == IgnoreUnits || OccupantTeams[Index] == INDEX_NONE || OccupantTeams[Index] == Team);
+	}
+};
+
+// ---------- Movement Range ---------- //
+
+// a tile that can be reached from the start of a movement range query
+struct FReachableTile
+{
+	FIntVector MapPosition;
+	int32 Cost; // total move cost to reach the tile
+	FIntVector Predecessor; // the tile it is reached from on the cheapest path
+	bool bCanStop; // false if the tile is held by an allied unit, which can be moved through but not stopped on
+};
+
+// every tile reachable from a start position within a move cost budget, in order of increasing cost
+struct TILESIMULATIONCORE_API FMovementRange
+{
+public:
+	FIntVector Start;
+	TArray<FReachableTile> Tiles;
+	// lookup from map position to the index of the tile in Tiles
+	TMap<FIntVector, int32> TileIndices;
+
+	// empty the range, keeping its memory
+	void Reset();
+
+	// returns the reachable tile at a map position or nullptr if it can't be reached
+	const FReachableTile* Find(const FIntVector& MapPosition) const;
+
+	// walk the predecessors back to the start to get the path to a reachable tile (start excluded, target included)
+	// returns false if the tile is not reachable
+	bool GetPathTo(const FIntVector& MapPosition, TArray<FIntVector>& OutPath) const;
+};
+
+// ---------- Path Tree ---------- //
+
+// shortest path tree from a single start cell to every reachable cell of a graph
+// built once, it answers the path to any cell by walking parents back to the start in O(path length)
+struct TILESIMULATIONCORE_API FPathTree
+{
+public:
+
+	FPathTree()
+		: Start(0, 0, 0)
+		, Size(0, 0, 0)
+		, GraphVersion(0)
+	{}
+
+	FIntVector Start;
+	// size of the graph the tree was built over, used to convert between positions and cells
+	FIntVector Size;
+	// parent of each cell on the cheapest path from the start, INDEX_NONE if the cell can't be reached (and for the start)
+	TArray<int32> Parents;
+	// cost to reach each cell from the start, MAX_int32 if unreachable
+	TArray<int32> Costs;
+	// version of the graph the tree was built from, so it can be rebuilt when the map changes
+	uint32 GraphVersion;
+
+	// whether the tree has been built
+	bool IsValid() const { return Parents.Num() > 0; }
+
+	// empty the tree so it is no longer valid
+	void Reset();
+
+	// get the path from the start to a map position (start excluded, target included)
+	// returns false and leaves the path empty if the position can't be reached
+	bool GetPathTo(const FIntVector& MapPosition, TArray<FIntVector>& OutPath) const;
+};
+
+// ---------- Query Stats ---------- //
+
+// cost of a path query, for comparing search strategies
+struct FPathQueryStats
+{
+	FPathQueryStats()
+		: NodesExpanded(0)
+		, QuerySeconds(0.0)
+	{}
+
+	int32 NodesExpanded;
+	double QuerySeconds;
+};
+
+// ---------- Pathfinder ---------- //
+// A* search over an FPathGraph. Node state is stored in flat arrays indexed by cell and the open set is a binary heap
+// with decrease-key, so each query costs O(N log N) in the number of expanded cells.
+// The scratch memory is kept between queries so repeated searches do not allocate. Not thread safe, use one per thread.
+
+class TILESIMULATIONCORE_API FTilePathfinder
+{
+public:
+	// ctor
+	FTilePathfinder();
+
+	// find the cheapest path from start to target for a unit of the given team
+	// the path excludes the start and includes the target. The target itself may be occupied (e.g. by a unit to attack)
+	// returns false and leaves the path empty if the target cannot be reached
+	bool FindPath(const FPathGraph& Graph, const FIntVector& Start, const FIntVector& Target, int32 Team, TArray<FIntVector>& OutPath);
+
+	// as FindPath but the search never leaves the box [BoundsMin, BoundsMax)
+	bool FindPathWithinBounds(const FPathGraph& Graph, const FIntVector& Start, const FIntVector& Target, int32 Team, const FIntVector& BoundsMin, const FIntVector& BoundsMax, TArray<FIntVector>& OutPath);
+
+	// get the cost from the start to each of the given cells without leaving the box [BoundsMin, BoundsMax), MAX_int32 if unreachable
+	// if bCostsToStart is set the costs are instead those of moving from each cell to the start
+	void FindCostsWithinBounds(const FPathGraph& Graph, const FIntVector& Start, int32 Team, const FIntVector& BoundsMin, const FIntVector& BoundsMax, bool bCostsToStart, const TArray<int32>& Cells, TArray<int32>& OutCosts);
+
+	// find every tile that a unit of the given team can reach from the start for at most the cost budget (Dijkstra flood fill)
+	// allied units can be moved through but not stopped on, enemy units block movement. The start tile is not included
+	void FindReachableTiles(const FPathGraph& Graph, const FIntVector& Start, int32 Team, int32 CostBudget, FMovementRange& OutRange);
+
+	// build the shortest path tree from the start to every cell a unit of the given team can reach
+	// as with FindPath, cells held by enemies can be the end of a path but are not moved through
+	void BuildPathTree(const FPathGraph& Graph, const FIntVector& Start, int32 Team, FPathTree& OutTree);
+
+	// number of cells expanded by the last query
+	int32 GetNumExpanded() const { return NumExpanded; }
+
+	// flag checked while searching. Once it is set any search in progress gives up as if the target were unreachable
+	void SetCancelFlag(const FThreadSafeBool* NewCancelFlag) { CancelFlag = NewCancelFlag; }
+
+private:
+	// per-cell search state. Only valid if SearchID matches the current search
+	struct FNode
+	{
+		int32 CostToHere; // cost to reach this cell from the start
+		int32 Score; // cost to here + heuristic to the target
+		int32 Parent; // index of the cell this one was reached from
+		int32 HeapIndex; // position in the open heap, INDEX_NONE if not yet opened, ClosedIndex once expanded
+		uint32 SearchID; // search that last touched this node
+	};
+
+	// heap index marking a node as already expanded
+	static const int32 ClosedIndex = -2;
+
+	// per-cell node state, indexed by cell
+	TArray<FNode> Nodes;
+
+	// open set, a binary min-heap of cell indices ordered by node score
+	TArray<int32> OpenHeap;
+
+	// incremented for each search so stale node state never has to be cleared
+	uint32 SearchID;
+
+	int32 NumExpanded;
+
+	const FThreadSafeBool* CancelFlag;
+
+	// cells in the order they were expanded by the last search, so results can be read back without scanning every node
+	TArray<int32> ExpandedCells;
+
+	// run a search from the start cell until the target cell is expanded (or every cell within the budget if there is no target)
+	// a target of INDEX_NONE gives a plain dijkstra search with no heuristic. Cells outside of [BoundsMin, BoundsMax) are never entered
+	// reversed costs charge for leaving a cell rather than entering it, giving the cost of each cell's path back to the start
+	// returns whether the target was reached
+	bool RunSearch(const FPathGraph& Graph, int32 StartIndex, int32 TargetIndex, int32 Team, int32 CostBudget, const FIntVector& BoundsMin, const FIntVector& BoundsMax, bool bReverseCosts);
+
+	// prepare the scratch memory for a new search over the graph
+	void BeginSearch(const FPathGraph& Graph);
+
+	// get the node for a cell, resetting it if it was last touched by an earlier search
+	FNode& TouchNode(int32 Index);
+
+	// open heap operations
+	void HeapPush(int32 Index);
+	int32 HeapPop();
+	void HeapSiftUp(int32 HeapPosition);
+	void HeapSiftDown(int32 HeapPosition);
+	void HeapSwap(int32 PositionA, int32 PositionB);
+
+	// walk the parents back from the end cell to build the path (start excluded)
+	void BuildPath(const FPathGraph& Graph, int32 StartIndex, int32 EndIndex, TArray<FIntVector>& OutPath) const;
+};
@@ -0,0 +1,109 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TileGrid.h"
+#include "TileTypeTable.h"
+#include "UnitOccupancy.h"
+#include "UnitStatBlock.h"
+
+struct FPathGraph;
+
+// the state of a unit in the simulation
+struct FSimUnit
+{
+	FSimUnit()
+		: HitPoints(0)
+		, AbilityPoints(0)
+	{}
+
+	// stats with every buff applied
+	FUnitStatBlock Stats;
+
+	int32 HitPoints;
+	int32 AbilityPoints;
+};
+
+// ---------- Tile Simulation ---------- //
+// the game state and rules with nothing tied to the engine's actors, components or assets: the tile grid, the tile type
+// table, where every unit is and each unit's stats, HP and AP. ATileMap and AUnit are views over one of these, adding the
+// meshes, editor data and buffs on top. On its own it can be copied and stepped on any thread, so many games can be
+// simulated at once on a headless server for balancing and AI training. Units are identified by their occupancy ID.
+// It lives in the TileSimulationCore module with the grid, occupancy, stats and pathfinder, which only depends on Core
+
+class TILESIMULATIONCORE_API FTileSimulation
+{
+public:
+	// ctor
+	FTileSimulation();
+
+	// ---------- Tiles ---------- //
+
+	// the tiles. Call SyncUnitsToGrid after changing the size of the grid
+	FORCEINLINE const FTileGrid& GetTiles() const { return Tiles; }
+	FORCEINLINE FTileGrid& GetTiles() { return Tiles; }
+
+	// per-type data of the tiles, indexed by tile type ID. Filled from the data table by FTileTypeRows in the game, or with SetType
+	FORCEINLINE const FTileTypeTable& GetTileTypes() const { return TileTypes; }
+	FORCEINLINE FTileTypeTable& GetTileTypes() { return TileTypes; }
+
+	// resize the unit occupancy to match the tile grid. Units that no longer fit on the map are removed and their IDs returned
+	void SyncUnitsToGrid(TArray<int32>* OutRemovedUnits = nullptr);
+
+	// fill a path graph with the move costs of the tiles and the team on each tile
+	void BuildPathGraph(FPathGraph& OutGraph) const;
+
+	// ---------- Units ---------- //
+
+	// which unit is on which tile
+	FORCEINLINE const FUnitOccupancy& GetUnits() const { return Units; }
+
+	// place a new unit. Returns its ID, or INDEX_NONE if the position is outside the map or already occupied
+	int32 AddUnit(int32 Team, const FIntVector& MapPosition, const FUnitStatBlock& Stats, int32 HitPoints, int32 AbilityPoints);
+
+	// move a unit to a new position. Returns false and leaves the unit where it was if the position is outside the map or occupied
+	bool MoveUnit(int32 UnitID, const FIntVector& NewMapPosition);
+
+	// remove a unit from the map. Its state can still be read until its ID is reused by a later unit
+	void RemoveUnit(int32 UnitID);
+
+	// remove every unit
+	void EmptyUnits();
+
+	// state of a unit. The ID must have been handed out by AddUnit
+	FORCEINLINE const FSimUnit& GetUnit(int32 UnitID) const { return UnitStates[UnitID]; }
+
+	// replace a unit's stats, such as after its buffs change. HP and AP above the new maximums are lowered to them
+	void SetUnitStats(int32 UnitID, const FUnitStatBlock& Stats);
+
+	// write or read the units and their state, leaving the tiles. Loading keeps the unit IDs and must be onto the same tiles
+	void SerializeUnits(FArchive& Ar);
+
+	// ---------- Rules ---------- //
+
+	// damage a unit's attack does before mitigation: the attack's raw damage plus the unit's damage stat and the attack
+	// modifier of the tile it is on
+	int32 GetDamageDealt(int32 UnitID, int32 RawDamage) const;
+
+	// damage a hit would do to a unit after its armour or magic resist and the defense modifier of the tile it is on
+	int32 GetDamageTaken(int32 UnitID, int32 RawDamage, bool bMagicDamage) const;
+
+	// take damage that has already been mitigated. Returns true if this took the unit's HP to 0
+	// the unit is left on the map so the caller can remove it once it is safe to
+	bool ReduceHitPoints(int32 UnitID, int32 DamageTaken);
+
+	// heal a unit, up to its maximum HP
+	void Heal(int32 UnitID, int32 Amount);
+
+	// set a unit up for the start of its turn, generating its ability points
+	void StartUnitTurn(int32 UnitID);
+
+private:
+	FTileGrid Tiles;
+	FTileTypeTable TileTypes;
+	FUnitOccupancy Units;
+
+	// state of each unit, indexed by occupancy ID
+	TArray<FSimUnit> UnitStates;
+};
@@ -0,0 +1,69 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// ---------- Tile Type Table ---------- //
+// the gameplay data of each tile type, indexed directly by tile type ID. Looking a type up is an array access, so it is safe
+// to use in hot loops. In the game it is filled from the TileProperties data table by FTileTypeRows, and must be rebuilt
+// whenever the data table changes. Outside the engine it is filled with SetType
+
+// the per-type data that hot loops read
+struct FTileTypeInfo
+{
+	// cost of moving onto a tile of this type, INDEX_NONE if it can't be moved onto
+	int32 MoveCost;
+	// additive modifiers to damage received and dealt by a unit on this type of tile
+	int32 DefenseModifier;
+	int32 AttackModifier;
+	// extra cost of climbing from this type of tile to the tile above it, INDEX_NONE if it can't be climbed
+	int32 ClimbCost;
+	// whether units can move onto this type of tile
+	bool bPassable;
+	// whether the type has been set
+	bool bValid;
+};
+
+class TILESIMULATIONCORE_API FTileTypeTable
+{
+public:
+	// ctor
+	FTileTypeTable();
+
+	// set the data for one type
+	void SetType(int32 TileTypeID, const FTileTypeInfo& Info);
+
+	// remove every type
+	void Empty();
+
+	// number of entries, one more than the highest type ID
+	FORCEINLINE int32 Num() const { return Types.Num(); }
+
+	// the data for a type, nullptr if it hasn't been set
+	FORCEINLINE const FTileTypeInfo* Find(int32 TileTypeID) const
+	{
+		return Types.IsValidIndex(TileTypeID) && Types[TileTypeID].bValid ? &Types[TileTypeID] : nullptr;
+	}
+
+	// cost of moving onto a type, INDEX_NONE if it can't be moved onto or hasn't been set
+	FORCEINLINE int32 GetMoveCost(int32 TileTypeID) const
+	{
+		return Types.IsValidIndex(TileTypeID) ? Types[TileTypeID].MoveCost : INDEX_NONE;
+	}
+
+	// extra cost of climbing from a type to the tile above it, INDEX_NONE if it can't be climbed
+	FORCEINLINE int32 GetClimbCost(int32 TileTypeID) const
+	{
+		return Types.IsValidIndex(TileTypeID) ? Types[TileTypeID].ClimbCost : INDEX_NONE;
+	}
+
+	// whether units can move onto a type
+	FORCEINLINE bool IsPassable(int32 TileTypeID) const
+	{
+		return Types.IsValidIndex(TileTypeID) && Types[TileTypeID].bPassable;
+	}
+
+private:
+	TArray<FTileTypeInfo> Types;
+};
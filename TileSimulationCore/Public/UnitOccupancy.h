@@ -0,0 +1,118 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// ---------- Unit Occupancy ---------- //
+// keeps track of which unit is on which tile, indexed both ways so that finding the unit on a tile and the tile a unit is on
+// are both O(1). Units are identified by a dense ID handed out when they are added.
+// Also keeps a dense grid of the team occupying each cell (same layout as FTileGrid) so the pathfinder can test a cell with one load
+
+class TILESIMULATIONCORE_API FUnitOccupancy
+{
+public:
+	// ctor
+	FUnitOccupancy();
+
+	// resize the occupancy grids to match the tile grid. Units that no longer fit on the map are removed and their IDs returned
+	void Resize(const FIntVector& NewSize, TArray<int32>* OutRemovedUnits = nullptr);
+
+	// remove every unit
+	void Empty();
+
+	// number of cells in each direction
+	FORCEINLINE const FIntVector& GetSize() const { return Size; }
+
+	// place a new unit of the given team. Returns its ID, or INDEX_NONE if the position is outside the map or already occupied
+	int32 AddUnit(int32 Team, const FIntVector& MapPosition);
+
+	// move a unit to a new position. Returns false and leaves the unit where it was if the position is outside the map or occupied
+	bool MoveUnit(int32 UnitID, const FIntVector& NewMapPosition);
+
+	// remove a unit from the map. Its ID may be reused by a later unit
+	void RemoveUnit(int32 UnitID);
+
+	// whether the ID belongs to a unit that is currently on the map
+	FORCEINLINE bool IsValidUnit(int32 UnitID) const
+	{
+		return Units.IsValidIndex(UnitID) && Units[UnitID].bActive;
+	}
+
+	// the unit on a map position, INDEX_NONE if there isn't one
+	FORCEINLINE int32 GetUnitAt(const FIntVector& MapPosition) const
+	{
+		return IsValidPosition(MapPosition) ? UnitGrid[ToIndex(MapPosition)] : INDEX_NONE;
+	}
+
+	// the position of a unit. The unit must be valid
+	FORCEINLINE const FIntVector& GetUnitPosition(int32 UnitID) const { return Units[UnitID].MapPosition; }
+
+	// the team of a unit. The unit must be valid
+	FORCEINLINE int32 GetUnitTeam(int32 UnitID) const { return Units[UnitID].Team; }
+
+	// team of the unit on each cell, INDEX_NONE where there is no unit. Same layout as the tile grid
+	FORCEINLINE const TArray<int32>& GetTeamGrid() const { return TeamGrid; }
+
+	// IDs of every unit on a team, in no particular order
+	const TArray<int32>& GetTeamUnits(int32 Team) const;
+
+	// number of units on the map
+	FORCEINLINE int32 NumUnits() const { return UnitCount; }
+
+	// write or read every unit with its ID, so a loaded occupancy hands out the same IDs as the one saved
+	friend TILESIMULATIONCORE_API FArchive& operator<<(FArchive& Ar, FUnitOccupancy& Occupancy);
+
+	// call Func(UnitID) for every unit on the map
+	template<typename FuncType>
+	void ForEachUnit(FuncType Func) const
+	{
+		for (int32 UnitID = 0; UnitID < Units.Num(); UnitID++)
+		{
+			if (Units[UnitID].bActive)
+			{
+				Func(UnitID);
+			}
+		}
+	}
+
+private:
+	struct FUnitRecord
+	{
+		FIntVector MapPosition;
+		int32 Team;
+		int32 TeamSlot; // index of the unit in its team's list
+		bool bActive; // false once the unit has been removed and the ID is free
+	};
+
+	FIntVector Size;
+
+	// unit ID on each cell, INDEX_NONE if unoccupied
+	TArray<int32> UnitGrid;
+
+	// team of the unit on each cell, INDEX_NONE if unoccupied
+	TArray<int32> TeamGrid;
+
+	// every unit, indexed by ID
+	TArray<FUnitRecord> Units;
+
+	// IDs of removed units, reused before new ones are made
+	TArray<int32> FreeUnitIDs;
+
+	// IDs of the units on each team
+	TMap<int32, TArray<int32>> TeamUnits;
+
+	int32 UnitCount;
+
+	FORCEINLINE bool IsValidPosition(const FIntVector& MapPosition) const
+	{
+		return MapPosition.X >= 0 && MapPosition.X < Size.X
+			&& MapPosition.Y >= 0 && MapPosition.Y < Size.Y
+			&& MapPosition.Z >= 0 && MapPosition.Z < Size.Z;
+	}
+
+	FORCEINLINE int32 ToIndex(const FIntVector& MapPosition) const
+	{
+		return MapPosition.Z + (MapPosition.X + MapPosition.Y * Size.X) * Size.Z;
+	}
+};
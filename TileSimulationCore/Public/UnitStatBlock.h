@@ -0,0 +1,38 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// the stats of a unit in the simulation. The game's EUnitStat, which buffs are set up with in the editor, lists the same
+// stats in the same order
+enum class ESimStat : uint8
+{
+	MaxHitPoints,
+	MaxAbilityPoints,
+	AbilityPointRate,
+	Movement,
+	Armour,
+	MagicResist,
+	Damage, // extra damage dealt, 0 before any buffs
+	Num
+};
+
+// ---------- Unit Stat Block ---------- //
+// a unit's stats with every buff applied. Rebuilt from the base stats when the buffs change, so reading a stat costs the
+// same however many buffs the unit has
+
+struct TILESIMULATIONCORE_API FUnitStatBlock
+{
+	FUnitStatBlock();
+
+	// value of each stat, indexed by ESimStat
+	int32 Stats[(int32)ESimStat::Num];
+
+	// false if any buff makes the unit untargetable
+	bool bTargetable;
+
+	FORCEINLINE int32 Get(ESimStat Stat) const { return Stats[(int32)Stat]; }
+
+	friend TILESIMULATIONCORE_API FArchive& operator<<(FArchive& Ar, FUnitStatBlock& Block);
+};
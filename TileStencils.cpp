@@ -0,0 +1,184 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "TileStencils.h"
+
+const TArray<FIntVector>& FTileStencils::ManhattanRing(int32 MinimumDistance, int32 MaximumDistance)
+{
+	return FindOrBuild(EShape::ManhattanRing, FMath::Max(MinimumDistance, 0), MaximumDistance);
+}
+
+const TArray<FIntVector>& FTileStencils::ChebyshevRing(int32 MinimumDistance, int32 MaximumDistance)
+{
+	return FindOrBuild(EShape::ChebyshevRing, FMath::Max(MinimumDistance, 0), MaximumDistance);
+}
+
+const TArray<FIntVector>& FTileStencils::ManhattanRing3D(int32 MinimumDistance, int32 MaximumDistance)
+{
+	return FindOrBuild(EShape::ManhattanRing3D, FMath::Max(MinimumDistance, 0), MaximumDistance);
+}
+
+const TArray<FIntVector>& FTileStencils::ChebyshevRing3D(int32 MinimumDistance, int32 MaximumDistance)
+{
+	return FindOrBuild(EShape::ChebyshevRing3D, FMath::Max(MinimumDistance, 0), MaximumDistance);
+}
+
+const TArray<FIntVector>& FTileStencils::Line(ETileDirection Direction, int32 Length)
+{
+	return FindOrBuild(EShape::Line, (int32)Direction, Length);
+}
+
+const TArray<FIntVector>& FTileStencils::Cone(ETileDirection Direction, int32 Length)
+{
+	return FindOrBuild(EShape::Cone, (int32)Direction, Length);
+}
+
+FIntVector FTileStencils::DirectionOffset(ETileDirection Direction)
+{
+	switch (Direction)
+	{
+	case ETileDirection::PositiveX: return FIntVector(1, 0, 0);
+	case ETileDirection::NegativeX: return FIntVector(-1, 0, 0);
+	case ETileDirection::PositiveY: return FIntVector(0, 1, 0);
+	case ETileDirection::NegativeY: return FIntVector(0, -1, 0);
+	}
+	return FIntVector(0, 0, 0);
+}
+
+const TArray<FIntVector>& FTileStencils::FindOrBuild(EShape Shape, int32 A, int32 B)
+{
+	// stencils are shared by every map and may be asked for from worker threads
+	static FCriticalSection CacheLock;
+	// the arrays are held by pointer so references to them survive the map growing
+	static TMap<uint64, TUniquePtr<TArray<FIntVector>>> Cache;
+
+	// ranges never get anywhere near 2^28 so the parameters pack into one key
+	const uint64 Key = ((uint64)Shape << 56) | ((uint64)(uint32)(A & 0x0FFFFFFF) << 28) | (uint64)(uint32)(B & 0x0FFFFFFF);
+
+	FScopeLock Lock(&CacheLock);
+	TUniquePtr<TArray<FIntVector>>& Stencil = Cache.FindOrAdd(Key);
+	if (!Stencil.IsValid())
+	{
+		Stencil = MakeUnique<TArray<FIntVector>>();
+		BuildStencil(Shape, A, B, *Stencil);
+	}
+	return *Stencil;
+}
+
+void FTileStencils::BuildStencil(EShape Shape, int32 A, int32 B, TArray<FIntVector>& OutOffsets)
+{
+	switch (Shape)
+	{
+	case EShape::ManhattanRing:
+		// walk each ring of the diamond in turn so the offsets come out nearest first
+		for (int32 Distance = A; Distance <= B; Distance++)
+		{
+			if (Distance == 0)
+			{
+				OutOffsets.Add(FIntVector(0, 0, 0));
+				continue;
+			}
+			for (int32 i = -Distance; i <= Distance; i++)
+			{
+				const int32 j = Distance - FMath::Abs(i);
+				OutOffsets.Add(FIntVector(i, j, 0));
+				if (j != 0)
+				{
+					OutOffsets.Add(FIntVector(i, -j, 0));
+				}
+			}
+		}
+		break;
+
+	case EShape::ChebyshevRing:
+		for (int32 Distance = A; Distance <= B; Distance++)
+		{
+			if (Distance == 0)
+			{
+				OutOffsets.Add(FIntVector(0, 0, 0));
+				continue;
+			}
+			// top and bottom rows of the square's border, then the sides between them
+			for (int32 i = -Distance; i <= Distance; i++)
+			{
+				OutOffsets.Add(FIntVector(i, -Distance, 0));
+				OutOffsets.Add(FIntVector(i, Distance, 0));
+			}
+			for (int32 j = -Distance + 1; j <= Distance - 1; j++)
+			{
+				OutOffsets.Add(FIntVector(-Distance, j, 0));
+				OutOffsets.Add(FIntVector(Distance, j, 0));
+			}
+		}
+		break;
+
+	case EShape::ManhattanRing3D:
+		// each ring is the flat ring of the remaining distance on each layer it reaches
+		for (int32 Distance = A; Distance <= B; Distance++)
+		{
+			for (int32 k = -Distance; k <= Distance; k++)
+			{
+				const int32 FlatDistance = Distance - FMath::Abs(k);
+				if (FlatDistance == 0)
+				{
+					OutOffsets.Add(FIntVector(0, 0, k));
+					continue;
+				}
+				for (int32 i = -FlatDistance; i <= FlatDistance; i++)
+				{
+					const int32 j = FlatDistance - FMath::Abs(i);
+					OutOffsets.Add(FIntVector(i, j, k));
+					if (j != 0)
+					{
+						OutOffsets.Add(FIntVector(i, -j, k));
+					}
+				}
+			}
+		}
+		break;
+
+	case EShape::ChebyshevRing3D:
+		// only built once per range so just test every cell of the cube
+		for (int32 Distance = A; Distance <= B; Distance++)
+		{
+			for (int32 k = -Distance; k <= Distance; k++)
+			{
+				for (int32 j = -Distance; j <= Distance; j++)
+				{
+					for (int32 i = -Distance; i <= Distance; i++)
+					{
+						if (FMath::Max3(FMath::Abs(i), FMath::Abs(j), FMath::Abs(k)) == Distance)
+						{
+							OutOffsets.Add(FIntVector(i, j, k));
+						}
+					}
+				}
+			}
+		}
+		break;
+
+	case EShape::Line:
+	{
+		const FIntVector Forward = DirectionOffset((ETileDirection)A);
+		for (int32 Distance = 1; Distance <= B; Distance++)
+		{
+			OutOffsets.Add(Forward * Distance);
+		}
+		break;
+	}
+
+	case EShape::Cone:
+	{
+		const FIntVector Forward = DirectionOffset((ETileDirection)A);
+		// perpendicular to the direction of the cone
+		const FIntVector Side(Forward.Y, Forward.X, 0);
+		for (int32 Distance = 1; Distance <= B; Distance++)
+		{
+			for (int32 Lateral = -Distance; Lateral <= Distance; Lateral++)
+			{
+				OutOffsets.Add(Forward * Distance + Side * Lateral);
+			}
+		}
+		break;
+	}
+	}
+}
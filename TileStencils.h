@@ -0,0 +1,62 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// ---------- Tile Stencils ---------- //
+// precomputed lists of map offsets for the shapes used by range queries (diamonds and rings, squares, lines and cones).
+// Each stencil is built the first time it is asked for and kept, so a query only has to add the offsets to the source
+// position and test each cell against the grid. Offsets are ordered by increasing distance from the source.
+// The returned arrays stay valid for the lifetime of the program
+
+// the four directions units can move and attack in
+enum class ETileDirection : uint8
+{
+	PositiveX,
+	NegativeX,
+	PositiveY,
+	NegativeY
+};
+
+class FTileStencils
+{
+public:
+	// cells with a manhattan distance from the source between the minimum and maximum (inclusive)
+	// a minimum of 0 gives a filled diamond that includes the source itself
+	static const TArray<FIntVector>& ManhattanRing(int32 MinimumDistance, int32 MaximumDistance);
+
+	// cells with a chebyshev distance from the source between the minimum and maximum (inclusive)
+	// a minimum of 0 gives a filled square, ChebyshevRing(1, 1) gives the 8 surrounding cells
+	static const TArray<FIntVector>& ChebyshevRing(int32 MinimumDistance, int32 MaximumDistance);
+
+	// the same shapes extended through the layers above and below the source, for maps with more than one layer
+	static const TArray<FIntVector>& ManhattanRing3D(int32 MinimumDistance, int32 MaximumDistance);
+	static const TArray<FIntVector>& ChebyshevRing3D(int32 MinimumDistance, int32 MaximumDistance);
+
+	// cells in a straight line from the source in a direction, from distance 1 up to the length
+	static const TArray<FIntVector>& Line(ETileDirection Direction, int32 Length);
+
+	// cells in a 90 degree cone opening out from the source in a direction, from distance 1 up to the length
+	// at distance D along the direction the cone is 2 * D + 1 cells wide
+	static const TArray<FIntVector>& Cone(ETileDirection Direction, int32 Length);
+
+	// unit offset for a direction
+	static FIntVector DirectionOffset(ETileDirection Direction);
+
+private:
+	enum class EShape : uint8
+	{
+		ManhattanRing,
+		ChebyshevRing,
+		ManhattanRing3D,
+		ChebyshevRing3D,
+		Line,
+		Cone
+	};
+
+	// find the cached stencil for a shape or build it
+	static const TArray<FIntVector>& FindOrBuild(EShape Shape, int32 A, int32 B);
+
+	static void BuildStencil(EShape Shape, int32 A, int32 B, TArray<FIntVector>& OutOffsets);
+};
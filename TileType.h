@@ -22,6 +22,7 @@ public:
 		, MoveCost(1)
 		, DefenseModifier(0)
 		, AttackModifier(0)
+		, ClimbCost(-1)
 	{}
 	
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = TileData)
@@ -35,6 +36,8 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = TileData)
 	int32 AttackModifier; // additive attack modifier. Affects damage dealt by a unit on this tile.
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = TileData)
+	int32 ClimbCost; // extra cost of climbing between this tile and a tile directly above it (ramps and stairs). Negative if it can't be climbed
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = TileData)
 	UMaterialInstance* Material; // Pointer to material used on the tile
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = TileData)
 	UStaticMesh* Mesh; // Pointer to the mesh used by the tile
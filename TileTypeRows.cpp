@@ -0,0 +1,44 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "TileTypeRows.h"
+#include "TileTypeTable.h"
+#include "TileType.h"
+#include "TileBasedGame.h"
+
+void FTileTypeRows::Build(const UDataTable* DataTable, FTileTypeTable& OutTypeTable)
+{
+	Rows.Reset();
+	OutTypeTable.Empty();
+	if (!DataTable)
+	{
+		return;
+	}
+
+	TArray<FTileType*> TypeRows;
+	DataTable->GetAllRows(FString(""), TypeRows);
+
+	for (const FTileType* TypeRow : TypeRows)
+	{
+		// the tile grid stores type IDs in a byte per cell so nothing above that can be placed
+		if (TypeRow->ID < 0 || TypeRow->ID > MAX_uint8)
+		{
+			UE_LOG(LogTileBasedGame, Warning, TEXT("Tile type %s has ID %d which is outside the supported range"), *TypeRow->TypeName.ToString(), TypeRow->ID);
+			continue;
+		}
+
+		// a negative move cost marks a type that can't be moved onto
+		FTileTypeInfo Info;
+		Info.bPassable = TypeRow->MoveCost >= 0;
+		Info.MoveCost = Info.bPassable ? TypeRow->MoveCost : INDEX_NONE;
+		Info.DefenseModifier = TypeRow->DefenseModifier;
+		Info.AttackModifier = TypeRow->AttackModifier;
+		Info.ClimbCost = TypeRow->ClimbCost >= 0 ? TypeRow->ClimbCost : INDEX_NONE;
+		OutTypeTable.SetType(TypeRow->ID, Info);
+
+		if (TypeRow->ID >= Rows.Num())
+		{
+			Rows.AddZeroed(TypeRow->ID + 1 - Rows.Num());
+		}
+		Rows[TypeRow->ID] = TypeRow;
+	}
+}
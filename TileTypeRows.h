@@ -0,0 +1,31 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UDataTable;
+class FTileTypeTable;
+struct FTileType;
+
+// ---------- Tile Type Rows ---------- //
+// the rows of the TileProperties data table, indexed directly by tile type ID, for the mesh and material of each type.
+// Building it also fills the simulation's FTileTypeTable with the gameplay data of each row, so the simulation never sees
+// the data table. Holds pointers into the data table rows, so it must be rebuilt whenever the data table changes
+
+class FTileTypeRows
+{
+public:
+	// rebuild from the rows of a data table, filling a type table with their gameplay data. A null data table leaves both empty
+	void Build(const UDataTable* DataTable, FTileTypeTable& OutTypeTable);
+
+	// the full data table row for a type (mesh, material etc.), nullptr if there is no row for it
+	FORCEINLINE const FTileType* GetRow(int32 TileTypeID) const
+	{
+		return Rows.IsValidIndex(TileTypeID) ? Rows[TileTypeID] : nullptr;
+	}
+
+private:
+	// data table row for each type, nullptr for IDs with no row
+	TArray<const FTileType*> Rows;
+};
@@ -0,0 +1,72 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "TranspositionTable.h"
+
+// the data of an entry is the number of visits in the low 32 bits and the sum of the scores in 1/ValueScale steps in the high
+// 32 bits. Visits stop being counted at MaxVisits, before the sum of the scores could overflow
+static const float ValueScale = 1024.f;
+static const uint32 MaxVisits = 1 << 21;
+
+static FORCEINLINE uint64 PackData(uint32 Visits, uint32 ScaledTotalValue)
+{
+	return (uint64)ScaledTotalValue << 32 | Visits;
+}
+
+FTranspositionTable::FTranspositionTable()
+	: IndexMask(0)
+{
+}
+
+void FTranspositionTable::Reset(int32 NumBits)
+{
+	const int32 NumEntries = NumBits > 0 ? 1 << NumBits : 0;
+	if (Entries.Num() != NumEntries)
+	{
+		Entries.Empty(NumEntries);
+		Entries.AddZeroed(NumEntries);
+	}
+	else if (NumEntries > 0)
+	{
+		// a zeroed entry is the key 0 with no visits, which reads the same as a missing state
+		FMemory::Memzero(Entries.GetData(), NumEntries * sizeof(FEntry));
+	}
+	IndexMask = NumEntries > 0 ? NumEntries - 1 : 0;
+}
+
+void FTranspositionTable::AddVisit(uint64 Hash, float Value)
+{
+	FEntry& Entry = Entries[Hash & IndexMask];
+	const uint64 Data = Entry.Data.Load(EMemoryOrder::Relaxed);
+	const uint64 KeyXorData = Entry.KeyXorData.Load(EMemoryOrder::Relaxed);
+
+	uint32 Visits = 0;
+	uint32 ScaledTotalValue = 0;
+	if ((KeyXorData ^ Data) == Hash)
+	{
+		Visits = (uint32)Data;
+		ScaledTotalValue = (uint32)(Data >> 32);
+		if (Visits >= MaxVisits)
+		{
+			return;
+		}
+	}
+
+	const uint64 NewData = PackData(Visits + 1, ScaledTotalValue + (uint32)(FMath::Clamp(Value, 0.f, 1.f) * ValueScale));
+	Entry.Data.Store(NewData, EMemoryOrder::Relaxed);
+	Entry.KeyXorData.Store(Hash ^ NewData, EMemoryOrder::Relaxed);
+}
+
+bool FTranspositionTable::Find(uint64 Hash, int32& OutVisits, float& OutTotalValue) const
+{
+	const FEntry& Entry = Entries[Hash & IndexMask];
+	const uint64 Data = Entry.Data.Load(EMemoryOrder::Relaxed);
+	const uint64 KeyXorData = Entry.KeyXorData.Load(EMemoryOrder::Relaxed);
+	if ((KeyXorData ^ Data) != Hash || (uint32)Data == 0)
+	{
+		return false;
+	}
+
+	OutVisits = (int32)(uint32)Data;
+	OutTotalValue = (uint32)(Data >> 32) / ValueScale;
+	return true;
+}
@@ -0,0 +1,41 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Templates/Atomic.h"
+
+// ---------- Transposition Table ---------- //
+// search statistics of board states keyed by their 64-bit hash, shared by every thread of a search without locks.
+// Each entry is two 64-bit words: the statistics, and the key XORed with the statistics. Each word is read and written
+// atomically, so a reader that catches an entry half written by another thread finds the key doesn't match and treats the
+// state as missing. Two threads adding to the same entry at once can lose one of the visits, which shifts the statistics
+// very slightly and costs far less than locking on every update. A state replaces whatever was in its slot
+
+class FTranspositionTable
+{
+public:
+	// ctor
+	FTranspositionTable();
+
+	// size the table to 2^NumBits entries and forget every state. 0 bits frees the table
+	void Reset(int32 NumBits);
+
+	FORCEINLINE bool IsEmpty() const { return Entries.Num() == 0; }
+
+	// add the score of a visit to a state, between 0 and 1
+	void AddVisit(uint64 Hash, float Value);
+
+	// the number of visits to a state and the sum of their scores. Returns false if the state isn't in the table
+	bool Find(uint64 Hash, int32& OutVisits, float& OutTotalValue) const;
+
+private:
+	struct FEntry
+	{
+		TAtomic<uint64> KeyXorData;
+		TAtomic<uint64> Data;
+	};
+
+	TArray<FEntry> Entries;
+	uint64 IndexMask;
+};
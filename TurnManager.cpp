@@ -0,0 +1,325 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "TurnManager.h"
+#include "TileMap.h"
+#include "Unit.h"
+
+ATurnManager::ATurnManager()
+	: Map(nullptr)
+	, MoveSpeed(4.f)
+	, AttackMinRange(1)
+	, AttackMaxRange(1)
+	, bRecordMatch(true)
+	, KeyframeInterval(10)
+	, Turn(0)
+	, ActiveTeamIndex(INDEX_NONE)
+	, MovingUnit(nullptr)
+	, MoveProgress(0.f)
+	, ReplayOffset(INDEX_NONE)
+	, bApplyingReplay(false)
+{
+	// only ticks while a unit is being moved or a replay is playing
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = false;
+}
+
+void ATurnManager::BeginPlay()
+{
+	Super::BeginPlay();
+
+	// the map may not have begun play yet, in which case the game starts once it has placed its units
+	if (Map && !Map->AreUnitsPlaced())
+	{
+		Map->OnUnitsPlaced().AddUObject(this, &ATurnManager::StartGame);
+		return;
+	}
+	StartGame();
+}
+
+void ATurnManager::StartGame()
+{
+	if (!Map)
+	{
+		return;
+	}
+
+	if (TeamOrder.Num() == 0)
+	{
+		const FUnitOccupancy& Occupancy = Map->GetUnitOccupancy();
+		Occupancy.ForEachUnit([&Occupancy, this](int32 UnitID)
+		{
+			TeamOrder.AddUnique(Occupancy.GetUnitTeam(UnitID));
+		});
+		TeamOrder.Sort();
+	}
+	if (TeamOrder.Num() == 0)
+	{
+		return;
+	}
+
+	Turn = 0;
+	ActiveTeamIndex = 0;
+
+	// effects of buffs at the start of the turn happen before any team acts
+	Map->RunTurnPhase();
+	StartTeamPhase();
+
+	// the log starts from the units as they are once the first phase has started
+	if (bRecordMatch)
+	{
+		Map->GetMatchLog().Begin(TeamOrder, Map->GetSimulation(), KeyframeInterval);
+	}
+}
+
+int32 ATurnManager::GetActiveTeam() const
+{
+	return TeamOrder.IsValidIndex(ActiveTeamIndex) ? TeamOrder[ActiveTeamIndex] : INDEX_NONE;
+}
+
+void ATurnManager::StartTeamPhase()
+{
+	UnitActions.Reset();
+	Map->GetTeamUnits(GetActiveTeam(), ActiveUnits);
+	for (AUnit* Unit : ActiveUnits)
+	{
+		FUnitActions& Actions = UnitActions.Add(Unit);
+		Actions.bCanMove = true;
+		Actions.bCanAttack = true;
+		Actions.bCanUseAbilities = true;
+		Unit->OnTurnStart();
+	}
+}
+
+void ATurnManager::EndTeamPhase()
+{
+	if (!Map || ActiveTeamIndex == INDEX_NONE || IsBlockedByReplay())
+	{
+		return;
+	}
+
+	// the moving unit is already on its new tile, so just put it there
+	FinishMove();
+
+	// units can have died during the phase
+	for (AUnit* Unit : ActiveUnits)
+	{
+		if (IsValid(Unit))
+		{
+			Unit->OnTurnEnd();
+		}
+	}
+	UnitActions.Reset();
+	ActiveUnits.Reset();
+
+	ActiveTeamIndex++;
+	if (ActiveTeamIndex == TeamOrder.Num())
+	{
+		// the end of one turn and the start of the next are both phases of the scheduler
+		Map->RunTurnPhase();
+		Turn++;
+		ActiveTeamIndex = 0;
+		Map->RunTurnPhase();
+	}
+	StartTeamPhase();
+
+	// the effects of the phase changing are already in the log, so it can snapshot the start of a new turn as it is
+	Map->GetMatchLog().RecordEndPhase(Map->GetSimulation());
+}
+
+bool ATurnManager::CanMove(const AUnit* Unit) const
+{
+	const FUnitActions* Actions = UnitActions.Find(Unit);
+	return Actions && Actions->bCanMove;
+}
+
+bool ATurnManager::CanAttack(const AUnit* Unit) const
+{
+	const FUnitActions* Actions = UnitActions.Find(Unit);
+	return Actions && Actions->bCanAttack;
+}
+
+bool ATurnManager::CanUseAbilities(const AUnit* Unit) const
+{
+	const FUnitActions* Actions = UnitActions.Find(Unit);
+	return Actions && Actions->bCanUseAbilities;
+}
+
+bool ATurnManager::MoveUnit(AUnit* Unit, const FIntVector& TargetPosition)
+{
+	// one unit animates at a time
+	if (!CanMove(Unit) || IsAnimating() || IsBlockedByReplay())
+	{
+		return false;
+	}
+
+	const FIntVector StartPosition = Map->GetUnitPosition(Unit);
+	TArray<FIntVector> Path;
+	if (!Map->GetMovementRange(Unit).GetPathTo(TargetPosition, Path) || !Map->MoveUnit(Unit, TargetPosition))
+	{
+		return false;
+	}
+	UnitActions[Unit].bCanMove = false;
+
+	// the path leaves out the tile the unit left, which the animation starts from
+	MovePath.Reset(Path.Num() + 1);
+	MovePath.Add(Map->MapToWorldCoordinates(StartPosition));
+	for (const FIntVector& MapPosition : Path)
+	{
+		MovePath.Add(Map->MapToWorldCoordinates(MapPosition));
+	}
+	MovingUnit = Unit;
+	MoveProgress = 0.f;
+	SetActorTickEnabled(true);
+	return true;
+}
+
+bool ATurnManager::IsValidAttackTarget(AUnit* Attacker, const FIntVector& TargetPosition) const
+{
+	if (!Map || !Map->IsUnitOnMap(Attacker))
+	{
+		return false;
+	}
+
+	// the same rule as the AI's search, so the two agree on what can be attacked
+	const int32 Distance = Map->DistanceBetween(Map->GetUnitPosition(Attacker), TargetPosition);
+	if (Distance < AttackMinRange || Distance > AttackMaxRange)
+	{
+		return false;
+	}
+	const AUnit* Target = Map->GetUnitAt(TargetPosition);
+	return !Target || Target->GetTeam() != Attacker->GetTeam();
+}
+
+bool ATurnManager::Attack(AUnit* Attacker, const FIntVector& TargetPosition, const TArray<FIntVector>& Stencil, int32 RawDamage, bool bMagicDamage)
+{
+	if (!CanAttack(Attacker) || !IsValidAttackTarget(Attacker, TargetPosition) || IsBlockedByReplay())
+	{
+		return false;
+	}
+	UnitActions[Attacker].bCanAttack = false;
+	Map->GetMatchLog().RecordAttack(Attacker->GetMapUnitID(), TargetPosition, Stencil, RawDamage, bMagicDamage);
+
+	// the attack modifier of the attacker's tile applies as well as its damage stat
+	const int32 DamageDealt = Map->GetSimulation().GetDamageDealt(Attacker->GetMapUnitID(), RawDamage);
+
+	CombatBatch.Reset();
+	CombatBatch.AddAreaHits(*Map, TargetPosition, Stencil, DamageDealt, bMagicDamage);
+	CombatBatch.Resolve(*Map);
+
+	// units killed are destroyed, so they can't take actions for the rest of the phase
+	for (AUnit* Unit : CombatBatch.GetKilledUnits())
+	{
+		UnitActions.Remove(Unit);
+		if (Unit == MovingUnit)
+		{
+			MovingUnit = nullptr;
+			UpdateTickEnabled();
+		}
+	}
+	return true;
+}
+
+void ATurnManager::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	if (IsAnimating())
+	{
+		if (!IsValid(MovingUnit) || MovePath.Num() == 0)
+		{
+			MovingUnit = nullptr;
+		}
+		else
+		{
+			// move along the path a tile at a time
+			MoveProgress += DeltaSeconds * MoveSpeed;
+			const int32 Segment = FMath::FloorToInt(MoveProgress);
+			if (Segment >= MovePath.Num() - 1)
+			{
+				FinishMove();
+			}
+			else
+			{
+				const float Alpha = MoveProgress - Segment;
+				MovingUnit->SetActorLocation(FMath::Lerp(MovePath[Segment], MovePath[Segment + 1], Alpha));
+			}
+		}
+	}
+
+	if (IsReplaying() && !IsAnimating())
+	{
+		StepReplay();
+	}
+	UpdateTickEnabled();
+}
+
+void ATurnManager::FinishMove()
+{
+	if (IsValid(MovingUnit) && MovePath.Num() > 0)
+	{
+		MovingUnit->SetActorLocation(MovePath.Last());
+	}
+	MovingUnit = nullptr;
+	MovePath.Reset();
+	UpdateTickEnabled();
+}
+
+bool ATurnManager::StartReplay(const FMatchLog& Log)
+{
+	if (!Map || Turn != 0 || ActiveTeamIndex != 0 || Log.GetTeamOrder() != TeamOrder)
+	{
+		return false;
+	}
+
+	ReplayLog = Log;
+	ReplayOffset = 0;
+
+	// replaying goes through the same moves and attacks as playing, which would only record the match a second time.
+	// The log is copied first, so it can be the map's own
+	Map->GetMatchLog().Empty();
+	UpdateTickEnabled();
+	return true;
+}
+
+void ATurnManager::StepReplay()
+{
+	// the replay's own actions go through while it plays, and nothing else does
+	TGuardValue<bool> ApplyingReplay(bApplyingReplay, true);
+
+	FMatchCommand Command;
+	while (IsReplaying() && !IsAnimating())
+	{
+		ReplayOffset = ReplayLog.ReadCommand(ReplayOffset, Command);
+		if (ReplayOffset == INDEX_NONE)
+		{
+			break;
+		}
+
+		if (Command.Type == EMatchCommand::EndPhase)
+		{
+			EndTeamPhase();
+			continue;
+		}
+
+		// units are found by their ID on the map, which is the same as when the match was recorded
+		const FUnitOccupancy& Occupancy = Map->GetUnitOccupancy();
+		AUnit* Unit = Occupancy.IsValidUnit(Command.UnitID) ? Map->GetUnitAt(Occupancy.GetUnitPosition(Command.UnitID)) : nullptr;
+		if (!Unit)
+		{
+			continue;
+		}
+		if (Command.Type == EMatchCommand::MoveUnit)
+		{
+			MoveUnit(Unit, Command.Position);
+		}
+		else if (Command.Type == EMatchCommand::Attack)
+		{
+			Attack(Unit, Command.Position, Command.Stencil, Command.RawDamage, Command.bMagicDamage);
+		}
+	}
+}
+
+void ATurnManager::UpdateTickEnabled()
+{
+	SetActorTickEnabled(IsAnimating() || IsReplaying());
+}
@@ -0,0 +1,155 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "CombatBatch.h"
+#include "MatchLog.h"
+#include "TurnManager.generated.h"
+
+class ATileMap;
+class AUnit;
+
+// ---------- Turn Manager ---------- //
+// runs the turns of the game. Each turn every team takes a phase in TeamOrder, in which its units can each move once and
+// attack once. Units don't tick: they are only told when their turn starts or ends and when an action is carried out on
+// them, and the turn manager moves the one unit that is animating. It only ticks while a unit is moving or a replay is
+// playing, so an idle board costs nothing per frame however many units there are
+
+UCLASS()
+class TILEBASEDGAME_API ATurnManager : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	// ctor
+	ATurnManager();
+
+	// the map the game is played on
+	UPROPERTY(EditAnywhere, Category = Turns)
+	ATileMap* Map;
+
+	// teams in the order they take their phases. If empty, every team with a unit on the map when play begins, lowest first
+	UPROPERTY(EditAnywhere, Category = Turns)
+	TArray<int32> TeamOrder;
+
+	// speed units are moved along their path, in tiles per second
+	UPROPERTY(EditAnywhere, Category = Turns, meta = (ClampMin = "0.1"))
+	float MoveSpeed;
+
+	// manhattan distances, through the layers as well, from an attacker to the position its attack is centred on
+	UPROPERTY(EditAnywhere, Category = Turns, meta = (ClampMin = "0"))
+	int32 AttackMinRange;
+	UPROPERTY(EditAnywhere, Category = Turns, meta = (ClampMin = "0"))
+	int32 AttackMaxRange;
+
+	// record the match into the map's match log from the start of the game
+	UPROPERTY(EditAnywhere, Category = Replay)
+	bool bRecordMatch;
+
+	// number of turns between the snapshots of the units kept in the match log
+	UPROPERTY(EditAnywhere, Category = Replay, meta = (ClampMin = "1", EditCondition = "bRecordMatch"))
+	int32 KeyframeInterval;
+
+	virtual void Tick(float DeltaSeconds) override;
+
+	// ---------- Turn Order ---------- //
+
+	// start the first phase of the first turn
+	void StartGame();
+
+	// end the active team's phase and start the next team's, starting a new turn after the last team. Does nothing while a
+	// replay is playing, which ends the phases itself
+	void EndTeamPhase();
+
+	FORCEINLINE int32 GetTurn() const { return Turn; }
+
+	// team whose phase it is, INDEX_NONE before the game starts
+	int32 GetActiveTeam() const;
+
+	// ---------- Actions ---------- //
+
+	// whether a unit of the active team can still take each kind of action this phase
+	bool CanMove(const AUnit* Unit) const;
+	bool CanAttack(const AUnit* Unit) const;
+	bool CanUseAbilities(const AUnit* Unit) const;
+
+	// whether a unit is being moved along its path
+	FORCEINLINE bool IsAnimating() const { return MovingUnit != nullptr; }
+
+	// move a unit to a tile in its movement range. The unit is on its new tile straight away and is then animated along
+	// its path. Returns false if the unit can't move there now or a replay is playing
+	bool MoveUnit(AUnit* Unit, const FIntVector& TargetPosition);
+
+	// whether a unit on the map could centre an attack on a position: within the attack range of it and not on an ally
+	bool IsValidAttackTarget(AUnit* Attacker, const FIntVector& TargetPosition) const;
+
+	// attack every unit in a stencil around a position. Returns false if the unit can't attack now, the position isn't
+	// a valid target for it or a replay is playing
+	bool Attack(AUnit* Attacker, const FIntVector& TargetPosition, const TArray<FIntVector>& Stencil, int32 RawDamage, bool bMagicDamage);
+
+	// ---------- Replay ---------- //
+
+	// play a recorded match back through the actors at the speed it is animated, carrying out its moves, attacks and phase
+	// ends in order. Everything else in the log follows from those and happens again by itself. The game must be at the
+	// start of its first turn with the units as they were when the log began. Returns false if it isn't. The map stops
+	// recording while the replay plays, and only the replay can take actions until it ends
+	bool StartReplay(const FMatchLog& Log);
+
+	// whether a replay is being played
+	FORCEINLINE bool IsReplaying() const { return ReplayOffset != INDEX_NONE; }
+
+protected:
+	virtual void BeginPlay() override;
+
+private:
+	int32 Turn;
+
+	// index into TeamOrder of the active team, INDEX_NONE before the game starts
+	int32 ActiveTeamIndex;
+
+	// actions each unit of the active team has left this phase
+	struct FUnitActions
+	{
+		bool bCanMove;
+		bool bCanAttack;
+		bool bCanUseAbilities;
+	};
+	TMap<const AUnit*, FUnitActions> UnitActions;
+
+	// units of the active team, kept for the end of its phase
+	UPROPERTY()
+	TArray<AUnit*> ActiveUnits;
+
+	// the unit being moved and the world positions of the path it is following
+	UPROPERTY()
+	AUnit* MovingUnit;
+	TArray<FVector> MovePath;
+	float MoveProgress;
+
+	// hits of the last attack
+	FCombatBatch CombatBatch;
+
+	// the match being replayed and the offset of its next command, INDEX_NONE when not replaying
+	FMatchLog ReplayLog;
+	int32 ReplayOffset;
+
+	// whether the replay is carrying out one of its commands, which are the only actions taken while it plays
+	bool bApplyingReplay;
+
+	// whether an action is refused because a replay is playing and it isn't one of the replay's
+	FORCEINLINE bool IsBlockedByReplay() const { return IsReplaying() && !bApplyingReplay; }
+
+	// tell the active team's units their turn has started and give them their actions
+	void StartTeamPhase();
+
+	// stop animating the moving unit, leaving it at the end of its path
+	void FinishMove();
+
+	// carry out the replay's commands up to the next move, so each move is animated before the next command
+	void StepReplay();
+
+	// tick only while a unit is moving or a replay is playing
+	void UpdateTickEnabled();
+};
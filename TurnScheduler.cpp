@@ -0,0 +1,59 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "TurnScheduler.h"
+
+FTurnScheduler::FTurnScheduler()
+	: CurrentSlot(0)
+	, NumScheduled(0)
+{
+}
+
+void FTurnScheduler::Reset()
+{
+	for (TArray<FScheduledEffect>& Slot : Slots)
+	{
+		Slot.Reset();
+	}
+	DueEffects.Reset();
+	CurrentSlot = 0;
+	NumScheduled = 0;
+}
+
+void FTurnScheduler::Schedule(int32 Turn, ETurnPhase Phase, const FTurnEffect& Effect)
+{
+	const int64 Slot = FMath::Max((int64)Turn * (int64)ETurnPhase::Num + (int64)Phase, CurrentSlot);
+
+	// appending keeps each slot in the order effects were scheduled
+	FScheduledEffect& Scheduled = Slots[Slot & (NumSlots - 1)].AddDefaulted_GetRef();
+	Scheduled.Slot = Slot;
+	Scheduled.Effect = Effect;
+	NumScheduled++;
+}
+
+void FTurnScheduler::TakeDueEffects()
+{
+	TArray<FScheduledEffect>& Slot = Slots[CurrentSlot & (NumSlots - 1)];
+
+	// effects scheduled a revolution or more ahead share the slot and stay in it, in order
+	int32 NumKept = 0;
+	for (int32 Index = 0; Index < Slot.Num(); Index++)
+	{
+		if (Slot[Index].Slot == CurrentSlot)
+		{
+			DueEffects.Add(MoveTemp(Slot[Index].Effect));
+		}
+		else
+		{
+			if (NumKept != Index)
+			{
+				Slot[NumKept] = MoveTemp(Slot[Index]);
+			}
+			NumKept++;
+		}
+	}
+	Slot.SetNum(NumKept, false);
+	NumScheduled -= DueEffects.Num();
+
+	// anything scheduled while these run is due next phase at the earliest
+	CurrentSlot++;
+}
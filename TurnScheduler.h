@@ -0,0 +1,105 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class AUnit;
+
+// the points in a turn that effects can be scheduled for
+enum class ETurnPhase : uint8
+{
+	TurnStart,
+	TurnEnd,
+	Num
+};
+
+// what a scheduled effect does when it comes due
+enum class ETurnEffectType : uint8
+{
+	ExpireBuff, // remove the buff
+	Damage,     // damage over time, repeating every turn while the buff lasts
+	Heal        // heal over time, repeating every turn while the buff lasts
+};
+
+// an effect of a buff on a unit, due at a particular turn and phase
+struct FTurnEffect
+{
+	FTurnEffect()
+		: Type(ETurnEffectType::ExpireBuff)
+		, BuffID(INDEX_NONE)
+		, Amount(0)
+		, bMagicDamage(false)
+	{}
+
+	TWeakObjectPtr<AUnit> Unit;
+	ETurnEffectType Type;
+
+	// buff the effect belongs to. Effects of buffs the unit no longer has are skipped, so removing a buff needs no cancelling
+	int32 BuffID;
+
+	int32 Amount;
+	bool bMagicDamage;
+};
+
+// ---------- Turn Scheduler ---------- //
+// timing wheel of effects keyed by turn and phase. Each slot of the wheel holds the effects due at the turns and phases that
+// map onto it, so running a phase only touches the effects due then (and the rare ones scheduled a whole revolution or more
+// ahead), however many units and buffs there are. Effects due together run in the order they were scheduled, so replaying
+// the same actions always runs the same effects in the same order
+
+class FTurnScheduler
+{
+public:
+	// ctor
+	FTurnScheduler();
+
+	// forget every effect and go back to the start of turn 0
+	void Reset();
+
+	// the turn and phase that will run next
+	FORCEINLINE int32 GetTurn() const { return (int32)(CurrentSlot / (int64)ETurnPhase::Num); }
+	FORCEINLINE ETurnPhase GetPhase() const { return (ETurnPhase)(CurrentSlot % (int64)ETurnPhase::Num); }
+
+	// schedule an effect. Effects scheduled for a phase that has already run, including one running now, are due next phase
+	void Schedule(int32 Turn, ETurnPhase Phase, const FTurnEffect& Effect);
+
+	// number of effects waiting to run
+	FORCEINLINE int32 Num() const { return NumScheduled; }
+
+	// take the effects due in the next phase, in the order they were scheduled, and move on to the phase after
+	// Func(const FTurnEffect&) is called for each of them and may schedule more effects
+	template<typename FuncType>
+	void RunPhase(FuncType Func)
+	{
+		TakeDueEffects();
+		for (const FTurnEffect& Effect : DueEffects)
+		{
+			Func(Effect);
+		}
+		DueEffects.Reset();
+	}
+
+private:
+	// number of slots in the wheel. A power of two so the slot of a turn and phase is a mask
+	static const int32 NumSlots = 64;
+
+	struct FScheduledEffect
+	{
+		int64 Slot;
+		FTurnEffect Effect;
+	};
+
+	TArray<FScheduledEffect> Slots[NumSlots];
+
+	// slot of the next phase to run, Turn * ETurnPhase::Num + Phase
+	int64 CurrentSlot;
+
+	int32 NumScheduled;
+
+	// effects of the phase being run
+	TArray<FTurnEffect> DueEffects;
+
+	// move the effects due now into DueEffects and advance to the next phase
+	void TakeDueEffects();
+};
@@ -1,41 +1,55 @@
 // Fill out your copyright notice in the Description page of Project Settings.
 
 #include "Unit.h"
+#include "TileMap.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "Components/SkeletalMeshComponent.h"
 
 
 // Sets default values
 AUnit::AUnit()
-	: ClassID(0)
-	, Team(0)
+	: Team(0)
+	, ClassID(0)
+	, Map(nullptr)
+	, MapUnitID(INDEX_NONE)
+	, AbilityPoints(0)
 	, MaxHitPoints(10)
 	, MaxAbilityPoints(6)
-	, AbilityPoints(0)
 	, AbilityPointRate(1)
 	, Movement(2)
 	, Armour(0)
 	, MagicResist(0)
+	, NextBuffID(0)
 {
-	// set starting hit points to max hit points
-	HitPoints = MaxHitPoints;
+	RecalculateStats();
 
- 	// Set this character to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
-	PrimaryActorTick.bCanEverTick = true;
+	// set starting hit points to max hit points
+	HitPoints = GetMaxHitPoints();
 
+	// units are woken by ATurnManager when something happens to them, so nothing about an idle unit runs per frame
+	// the turn manager moves units itself, so the character movement component doesn't need to tick either
+	PrimaryActorTick.bCanEverTick = false;
+	GetCharacterMovement()->PrimaryComponentTick.bStartWithTickEnabled = false;
+	GetMesh()->VisibilityBasedAnimTickOption = EVisibilityBasedAnimTickOption::OnlyTickPoseWhenRendered;
 }
 
 // Called when the game starts or when spawned
 void AUnit::BeginPlay()
 {
 	Super::BeginPlay();
-	
+
+	// base stats and buffs may have been set in the editor since construction
+	RecalculateStats();
 }
 
-// Called every frame
-void AUnit::Tick(float DeltaTime)
+#if WITH_EDITOR
+void AUnit::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
 {
-	Super::Tick(DeltaTime);
+	Super::PostEditChangeProperty(PropertyChangedEvent);
 
+	RecalculateStats();
 }
+#endif
 
 // Called to bind functionality to input
 void AUnit::SetupPlayerInputComponent(UInputComponent* PlayerInputComponent)
@@ -49,41 +63,114 @@ int32 AUnit::GetTeam() const
 	return Team;
 }
 
-void AUnit::OnTurnStart()
+ATileMap* AUnit::GetMap() const
+{
+	return Map;
+}
+
+int32 AUnit::GetMapUnitID() const
+{
+	return MapUnitID;
+}
+
+FTileSimulation* AUnit::GetSimulation() const
+{
+	return Map && MapUnitID != INDEX_NONE ? &Map->GetSimulation() : nullptr;
+}
+
+int32 AUnit::GetHitPoints() const
 {
-	// set up action flags as unused (these may be modified later in OnTurnStart() by buffs such as stun, root, silence, etc)
-	CanMove = true;
-	CanAttack = true;
-	CanUseAbilities = true;
+	const FTileSimulation* Simulation = GetSimulation();
+	return Simulation ? Simulation->GetUnit(MapUnitID).HitPoints : HitPoints;
+}
+
+int32 AUnit::GetAbilityPoints() const
+{
+	const FTileSimulation* Simulation = GetSimulation();
+	return Simulation ? Simulation->GetUnit(MapUnitID).AbilityPoints : AbilityPoints;
+}
+
+void AUnit::SetMap(ATileMap* NewMap, int32 NewMapUnitID)
+{
+	// take back the HP and AP the simulation held while the unit was on the map
+	if (const FTileSimulation* Simulation = GetSimulation())
+	{
+		HitPoints = Simulation->GetUnit(MapUnitID).HitPoints;
+		AbilityPoints = Simulation->GetUnit(MapUnitID).AbilityPoints;
+	}
+
+	// the buffs have been counting down on the map the unit leaves, so they keep only the turns they have left there
+	const bool bMapChanged = NewMap != Map;
+	if (bMapChanged && Map)
+	{
+		const int32 CurrentTurn = Map->GetTurnScheduler().GetTurn();
+		for (FUnitBuff& Buff : Buffs)
+		{
+			if (Buff.ExpiryTurn != INDEX_NONE)
+			{
+				Buff.RemainingTurns = FMath::Max(Buff.ExpiryTurn - CurrentTurn + 1, 1);
+				Buff.ExpiryTurn = INDEX_NONE;
+			}
+		}
+	}
+	Map = NewMap;
+	MapUnitID = NewMapUnitID;
 
+	// the turn effects of the buffs are scheduled on the map. New buff IDs leave any effects scheduled on a map the unit
+	// was on before to be skipped
+	if (bMapChanged)
+	{
+		for (FUnitBuff& Buff : Buffs)
+		{
+			Buff.BuffID = NextBuffID++;
+			ScheduleBuffEffects(Buff);
+		}
+	}
+}
+
+void AUnit::OnTurnStart()
+{
 	// increase the ability points of the unit by their current ability point rate (potentially modified by buffs)
-	AbilityPoints += GetAbilityPointRate();
-	// cap the ability points between 0 and the maximum ability point value
-	if (AbilityPoints > MaxAbilityPoints)
+	// capped between 0 and the maximum ability point value
+	if (FTileSimulation* Simulation = GetSimulation())
 	{
-		AbilityPoints = MaxAbilityPoints;
+		Simulation->StartUnitTurn(MapUnitID);
 	}
-	else if (AbilityPoints < 0)
+	else
 	{
-		AbilityPoints = 0;
+		AbilityPoints = FMath::Clamp(AbilityPoints + GetAbilityPointRate(), 0, GetMaxAbilityPoints());
+	}
+
+	// buffs applied at the start of the turn may change how far the unit can move
+	if (Map)
+	{
+		Map->InvalidateMovementRange(this);
 	}
 }
 
 void AUnit::OnTurnEnd()
 {
-	// set the action flags as used
-	CanMove = false;
-	CanAttack = false;
-	CanUseAbilities = false;
-
-	// apply any end of turn effects on the buffs
-	// loop through buffs and use buff.OnTurnEnd(this)
+	// the unit's movement range is only valid for the turn it was found in
+	if (Map)
+	{
+		Map->InvalidateMovementRange(this);
+	}
 
 }
 
 void AUnit::ApplyDamage(const int32& RawDamage, const bool MagicDamage)
 {
-	
+	// on the map the simulation's rules apply, which include the defense modifier of the tile the unit is on
+	if (FTileSimulation* Simulation = GetSimulation())
+	{
+		Map->GetMatchLog().RecordDamage(MapUnitID, RawDamage, MagicDamage);
+		if (ReduceHitPoints(Simulation->GetDamageTaken(MapUnitID, RawDamage, MagicDamage)))
+		{
+			TriggerDeath();
+		}
+		return;
+	}
+
 	int32 DamageTaken;
 
 	// if the incoming damage was magic damage then reduce by magic resist. If physical then reduce by armour.
@@ -102,27 +189,50 @@ void AUnit::ApplyDamage(const int32& RawDamage, const bool MagicDamage)
 		DamageTaken = 0;
 	}
 
-	// reduce the unit's HP by the damage taken
-	HitPoints -= DamageTaken;
+	// reduce the unit's HP by the damage taken and kill the unit if it has fallen to 0
+	if (ReduceHitPoints(DamageTaken))
+	{
+		TriggerDeath();
+	}
+}
+
+bool AUnit::ReduceHitPoints(int32 DamageTaken)
+{
+	if (FTileSimulation* Simulation = GetSimulation())
+	{
+		return Simulation->ReduceHitPoints(MapUnitID, DamageTaken);
+	}
 
-	// if the hit points have fallen to 0 or below then kill the unit
 	if (HitPoints <= 0)
 	{
-		HitPoints = 0; // ensure ui doesn't display negative hp
+		return false;
+	}
 
-		TriggerDeath();
+	HitPoints -= DamageTaken;
+	if (HitPoints <= 0)
+	{
+		HitPoints = 0; // ensure ui doesn't display negative hp
+		return true;
 	}
+	return false;
 }
 
 void AUnit::ApplyHeal(const int32& RawHeal)
 {
+	if (FTileSimulation* Simulation = GetSimulation())
+	{
+		Map->GetMatchLog().RecordHeal(MapUnitID, RawHeal);
+		Simulation->Heal(MapUnitID, RawHeal);
+		return;
+	}
+
 	// increase HP by the heal amount
 	HitPoints += RawHeal;
 
 	// if the units HP is now above the maximum then set it to the maximum
-	if (HitPoints > MaxHitPoints)
+	if (HitPoints > GetMaxHitPoints())
 	{
-		HitPoints = MaxHitPoints;
+		HitPoints = GetMaxHitPoints();
 	}
 }
 
@@ -132,90 +242,146 @@ void AUnit::TriggerDeath()
 	// remove the unit from the map and game manager
 	// delete all the ability and buffs the unit has
 
+	// take the unit off the map so it no longer blocks or occupies its tile
+	if (Map)
+	{
+		Map->RemoveUnit(this);
+	}
+
 	// trigger destruction of the unit
 	Destroy();
 }
 
-int32 AUnit::GetMaxHitPoints()
+void AUnit::ApplyBuff(const FUnitBuff& Buff)
 {
-	// check buffs for max ap modifiers
-	int32 BuffModifier = 0;
-
-	int32 TotalMaxHitPoints = MaxHitPoints + BuffModifier;
-
-	return TotalMaxHitPoints;
-	
+	FUnitBuff& NewBuff = Buffs.Add_GetRef(Buff);
+	NewBuff.BuffID = NextBuffID++;
+	NewBuff.ExpiryTurn = INDEX_NONE;
+	ScheduleBuffEffects(NewBuff);
+	RecalculateStats();
 }
 
-int32 AUnit::GetMaxAbilityPoints()
+bool AUnit::RemoveBuff(FName BuffName)
 {
-	// check buffs for max ap modifiers
-	int32 BuffModifier = 0;
-
-	int32 TotalMaxAbilityPoints = MaxAbilityPoints + BuffModifier;
-
-	return TotalMaxAbilityPoints;
+	const int32 NumRemoved = Buffs.RemoveAll([BuffName](const FUnitBuff& Buff) { return Buff.BuffName == BuffName; });
+	if (NumRemoved > 0)
+	{
+		RecalculateStats();
+	}
+	return NumRemoved > 0;
 }
 
-int32 AUnit::GetAbilityPointRate()
+const TArray<FUnitBuff>& AUnit::GetBuffs() const
 {
-	// check buffs for ap rate modifiers
-	int32 BuffModifier = 0;
-
-	// apply to the base stat
-	int32 TotalAbilityPointRate = AbilityPointRate + BuffModifier;
-
-	return TotalAbilityPointRate;
+	return Buffs;
 }
 
-int32 AUnit::GetMovement()
+void AUnit::ScheduleBuffEffects(FUnitBuff& Buff)
 {
+	if (!Map)
+	{
+		return;
+	}
+	FTurnScheduler& Scheduler = Map->GetTurnScheduler();
 
-	// check buffs for movement modifiers
-	int32 BuffModifier = 0;
-
-	// apply to the base stat
-	int32 TotalMovement = Movement + BuffModifier;
-
-	return TotalMovement;
-}
+	FTurnEffect Effect;
+	Effect.Unit = this;
+	Effect.BuffID = Buff.BuffID;
 
-int32 AUnit::GetArmour()
-{
-	// check buffs for armour modifiers
-	int32 BuffModifier = 0;
-
-	// apply to the base stat
-	int32 TotalArmour = Armour + BuffModifier;
+	// a buff lasting one turn wears off at the end of the current turn
+	if (Buff.RemainingTurns >= 0)
+	{
+		Effect.Type = ETurnEffectType::ExpireBuff;
+		Buff.ExpiryTurn = Scheduler.GetTurn() + FMath::Max(Buff.RemainingTurns - 1, 0);
+		Scheduler.Schedule(Buff.ExpiryTurn, ETurnPhase::TurnEnd, Effect);
+	}
 
-	return TotalArmour;
+	// effects over time start at the start of the next turn and schedule their own repeats
+	if (Buff.DamagePerTurn != 0)
+	{
+		Effect.Type = ETurnEffectType::Damage;
+		Effect.Amount = Buff.DamagePerTurn;
+		Effect.bMagicDamage = Buff.bMagicDamage;
+		Scheduler.Schedule(Scheduler.GetTurn() + 1, ETurnPhase::TurnStart, Effect);
+	}
+	if (Buff.HealPerTurn != 0)
+	{
+		Effect.Type = ETurnEffectType::Heal;
+		Effect.Amount = Buff.HealPerTurn;
+		Scheduler.Schedule(Scheduler.GetTurn() + 1, ETurnPhase::TurnStart, Effect);
+	}
 }
 
-int32 AUnit::GetMagicResist()
+void AUnit::ApplyTurnEffect(const FTurnEffect& Effect)
 {
-	// check buffs for magic resist modifiers
-	int32 BuffModifier = 0;
-
-	// apply to the base stat
-	int32 TotalMagicResist = MagicResist + BuffModifier;
-
-	return TotalMagicResist;
-}
+	const int32 BuffIndex = Buffs.IndexOfByPredicate([&Effect](const FUnitBuff& Buff) { return Buff.BuffID == Effect.BuffID; });
+	if (BuffIndex == INDEX_NONE || !Map)
+	{
+		return;
+	}
 
-int32 AUnit::DamageModifier()
-{	
-	// check buffs for damage modifiers
-	int32 BuffModifier = 0;
+	switch (Effect.Type)
+	{
+	case ETurnEffectType::ExpireBuff:
+		Buffs.RemoveAt(BuffIndex);
+		RecalculateStats();
+		break;
 
-	return BuffModifier;
+	case ETurnEffectType::Damage:
+	case ETurnEffectType::Heal:
+	{
+		// repeat next turn first, as the damage may kill the unit and take it off the map
+		FTurnScheduler& Scheduler = Map->GetTurnScheduler();
+		Scheduler.Schedule(Scheduler.GetTurn() + 1, ETurnPhase::TurnStart, Effect);
+		if (Effect.Type == ETurnEffectType::Damage)
+		{
+			ApplyDamage(Effect.Amount, Effect.bMagicDamage);
+		}
+		else
+		{
+			ApplyHeal(Effect.Amount);
+		}
+		break;
+	}
+	}
 }
 
-bool AUnit::IsTargetable()
+void AUnit::RecalculateStats()
 {
-	bool Targetable = true;
+	FUnitStatBlock BaseStats;
+	BaseStats.Stats[(int32)ESimStat::MaxHitPoints] = MaxHitPoints;
+	BaseStats.Stats[(int32)ESimStat::MaxAbilityPoints] = MaxAbilityPoints;
+	BaseStats.Stats[(int32)ESimStat::AbilityPointRate] = AbilityPointRate;
+	BaseStats.Stats[(int32)ESimStat::Movement] = Movement;
+	BaseStats.Stats[(int32)ESimStat::Armour] = Armour;
+	BaseStats.Stats[(int32)ESimStat::MagicResist] = MagicResist;
+	BaseStats.Stats[(int32)ESimStat::Damage] = 0;
+
+	const int32 OldMovement = GetMovement();
+	const int32 OldDamage = DamageModifier();
+	Stats = AggregateUnitStats(BaseStats, Buffs);
+
+	// a lower maximum takes effect straight away
+	if (FTileSimulation* Simulation = GetSimulation())
+	{
+		Map->GetMatchLog().RecordStats(MapUnitID, Stats);
+		Simulation->SetUnitStats(MapUnitID, Stats);
+	}
+	else
+	{
+		HitPoints = FMath::Min(HitPoints, GetMaxHitPoints());
+		AbilityPoints = FMath::Min(AbilityPoints, GetMaxAbilityPoints());
+	}
 
-	// check if any buffs make the unit untargetable
+	// how far the unit can move is cached by the map
+	if (Map && GetMovement() != OldMovement)
+	{
+		Map->InvalidateMovementRange(this);
+	}
 
-	return Targetable;
+	// the tiles the unit threatens depend on both how far it can move and its damage
+	if (Map && (GetMovement() != OldMovement || DamageModifier() != OldDamage))
+	{
+		Map->InvalidateThreat(this);
+	}
 }
-
@@ -4,8 +4,13 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Character.h"
+#include "UnitStats.h"
+#include "TurnScheduler.h"
 #include "Unit.generated.h"
 
+class ATileMap;
+class FTileSimulation;
+
 UCLASS()
 class TILEBASEDGAME_API AUnit : public ACharacter
 {
@@ -23,9 +28,14 @@ private:
 	UPROPERTY(EditAnywhere)
 	int32 ClassID; // id of the unit's class
 
+	UPROPERTY()
+	ATileMap* Map; // the map the unit has been placed on
+
+	int32 MapUnitID; // id of the unit in the map's unit occupancy index
+
 	// ---------- unit's stats ---------- //
 
-	// current HP and AP
+	// current HP and AP. While the unit is on a map the map's simulation holds them instead, use GetHitPoints and GetAbilityPoints
 	UPROPERTY(EditAnywhere)
 	int32 HitPoints;
 	UPROPERTY(EditAnywhere)
@@ -51,19 +61,27 @@ private:
 
 	// ---------- buffs and abilities ---------- //
 
-	//TArray<ABuff> Buffs;
+	// buffs and debuffs currently on the unit. Change them through ApplyBuff and RemoveBuff so the stats stay up to date
+	UPROPERTY(EditAnywhere)
+	TArray<FUnitBuff> Buffs;
+
+	// the stats with every buff applied. Rebuilt by RecalculateStats whenever the buffs or base stats change
+	FUnitStatBlock Stats;
+
+	// id given to the next buff applied
+	int32 NextBuffID;
+
+	// schedule the expiry and effects over time of a buff on the map's turn scheduler
+	void ScheduleBuffEffects(FUnitBuff& Buff);
+
+	// rebuild Stats from the base stats and buffs
+	void RecalculateStats();
 
 	//AAbility DefaultAbility;
 
 	//TArray<AAbility> Abilities;
 
-	// --------- flags for handling actions ---------- //
-	UPROPERTY(EditAnywhere)
-	bool CanAttack; // whether the unit can use their default ability
-	UPROPERTY(EditAnywhere)
-	bool CanMove; // whether the unit can move
-	UPROPERTY(EditAnywhere)
-	bool CanUseAbilities; // whether the unit can use their abilities
+	// which actions the unit has left this turn are kept by ATurnManager
 
 
 protected:
@@ -71,18 +89,28 @@ protected:
 	virtual void BeginPlay() override;
 
 public:	
-	// Called every frame
-	virtual void Tick(float DeltaTime) override;
-
 	// Called to bind functionality to input
 	virtual void SetupPlayerInputComponent(class UInputComponent* PlayerInputComponent) override;
 
 	int32 GetTeam() const;
+
+	// the map the unit is on and its id there. Set by the map when the unit is added to or removed from it
+	ATileMap* GetMap() const;
+	int32 GetMapUnitID() const;
+	void SetMap(ATileMap* NewMap, int32 NewMapUnitID);
+
+	// the simulation of the map the unit is on, which holds its HP and AP. nullptr if it isn't on a map
+	FTileSimulation* GetSimulation() const;
+
+	// current HP and AP
+	int32 GetHitPoints() const;
+	int32 GetAbilityPoints() const;
 	
 	// ---------- Start and end of turn handlers ---------- //
 
 	// in these functions the unit is set up for the start of a turn ans shut down correctly at end of turn
-	// also loop through buffs and apply any effects they have: Buff.OnTurnStart(this);
+	// called by ATurnManager at the start and end of the phase of the unit's team. Units don't tick, these are what wake them
+	// buff effects are not applied here, they are scheduled on the map's turn scheduler and run by ATileMap::RunTurnPhase
 	void OnTurnStart();
 	void OnTurnEnd();
 
@@ -100,33 +128,52 @@ public:
 	// apply damage to the unit
 	void ApplyDamage(const int32& RawDamage, const bool MagicDamage);
 
+	// take damage that has already been mitigated, without triggering death
+	// returns true if this took the unit's HP to 0, so the caller can trigger its death once it is safe to
+	bool ReduceHitPoints(int32 DamageTaken);
+
 	// apply a heal to the unit, limiting the new HP value to the max HP value
 	void ApplyHeal(const int32& RawHeal);
 
 	// performs the necessary action required when a unit dies
 	void TriggerDeath();
 
-	// void ApplyBuff(ABuff buff);
+	// add a buff to the unit
+	void ApplyBuff(const FUnitBuff& Buff);
+
+	// remove every buff with the given name. Returns whether any were removed
+	bool RemoveBuff(FName BuffName);
+
+	const TArray<FUnitBuff>& GetBuffs() const;
+
+	// carry out an effect of one of the unit's buffs that has come due. Does nothing if the unit no longer has the buff
+	void ApplyTurnEffect(const FTurnEffect& Effect);
 
 	// ---------- Getters for modified stat values ---------- //
+	// these read the stats aggregated when the buffs last changed, so they cost the same however many buffs there are
 
-	int32 GetMaxHitPoints();
+	FORCEINLINE int32 GetMaxHitPoints() const { return Stats.Get(ESimStat::MaxHitPoints); }
 
-	int32 GetMaxAbilityPoints();
+	FORCEINLINE int32 GetMaxAbilityPoints() const { return Stats.Get(ESimStat::MaxAbilityPoints); }
 
-	int32 GetAbilityPointRate();
+	FORCEINLINE int32 GetAbilityPointRate() const { return Stats.Get(ESimStat::AbilityPointRate); }
 
-	int32 GetMovement();
+	FORCEINLINE int32 GetMovement() const { return Stats.Get(ESimStat::Movement); }
 
-	int32 GetArmour();
+	FORCEINLINE int32 GetArmour() const { return Stats.Get(ESimStat::Armour); }
 
-	int32 GetMagicResist();
+	FORCEINLINE int32 GetMagicResist() const { return Stats.Get(ESimStat::MagicResist); }
 
+	FORCEINLINE const FUnitStatBlock& GetStats() const { return Stats; }
 
 	// ---------- get buff effects which don't effect base stats --------- //
 
-	int32 DamageModifier();
+	FORCEINLINE int32 DamageModifier() const { return Stats.Get(ESimStat::Damage); }
+
+	FORCEINLINE bool IsTargetable() const { return Stats.bTargetable; }
 
-	bool IsTargetable();
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
 	
 };
@@ -0,0 +1,38 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "UnitStats.h"
+
+static_assert((int32)EUnitStat::Num == (int32)ESimStat::Num, "EUnitStat must list the same stats as ESimStat");
+
+FUnitStatBlock AggregateUnitStats(const FUnitStatBlock& Base, const TArray<FUnitBuff>& Buffs)
+{
+	int32 Added[(int32)ESimStat::Num] = {};
+	float Multiplied[(int32)ESimStat::Num];
+	for (float& Multiplier : Multiplied)
+	{
+		Multiplier = 1.f;
+	}
+
+	FUnitStatBlock Result;
+	Result.bTargetable = Base.bTargetable;
+	for (const FUnitBuff& Buff : Buffs)
+	{
+		for (const FStatModifier& Modifier : Buff.Modifiers)
+		{
+			if (Modifier.Stat < EUnitStat::Num)
+			{
+				const int32 Stat = (int32)ToSimStat(Modifier.Stat);
+				Added[Stat] += Modifier.Add;
+				Multiplied[Stat] *= Modifier.Multiply;
+			}
+		}
+		Result.bTargetable &= !Buff.bUntargetable;
+	}
+
+	for (int32 Stat = 0; Stat < (int32)ESimStat::Num; Stat++)
+	{
+		const int32 Value = FMath::RoundToInt((Base.Stats[Stat] + Added[Stat]) * Multiplied[Stat]);
+		Result.Stats[Stat] = Stat == (int32)ESimStat::Damage ? Value : FMath::Max(Value, 0);
+	}
+	return Result;
+}
@@ -0,0 +1,94 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UnitStatBlock.h"
+#include "UnitStats.generated.h"
+
+// the stats of a unit that buffs can modify. The same stats in the same order as the simulation's ESimStat
+UENUM(BlueprintType)
+enum class EUnitStat : uint8
+{
+	MaxHitPoints,
+	MaxAbilityPoints,
+	AbilityPointRate,
+	Movement,
+	Armour,
+	MagicResist,
+	Damage, // extra damage dealt, 0 before any buffs
+	Num UMETA(Hidden)
+};
+
+// a change a buff makes to one stat. The additive parts of every buff are summed before the multipliers are applied
+USTRUCT(BlueprintType)
+struct FStatModifier
+{
+	GENERATED_USTRUCT_BODY()
+
+public:
+
+	FStatModifier()
+		: Stat(EUnitStat::Movement)
+		, Add(0)
+		, Multiply(1.f)
+	{}
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Buff)
+	EUnitStat Stat;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Buff)
+	int32 Add;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Buff)
+	float Multiply;
+};
+
+// a buff or debuff on a unit. Only changes the unit's stats through its modifiers, so a unit's stats can be aggregated once
+// whenever its buffs change
+USTRUCT(BlueprintType)
+struct FUnitBuff
+{
+	GENERATED_USTRUCT_BODY()
+
+public:
+
+	FUnitBuff()
+		: RemainingTurns(-1)
+		, bUntargetable(false)
+		, DamagePerTurn(0)
+		, bMagicDamage(false)
+		, HealPerTurn(0)
+		, BuffID(INDEX_NONE)
+		, ExpiryTurn(INDEX_NONE)
+	{}
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Buff)
+	FName BuffName;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Buff)
+	TArray<FStatModifier> Modifiers;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Buff)
+	int32 RemainingTurns; // turns the buff lasts, wearing off at the end of the last one. Negative if it never does. Brought up to date when the unit leaves a map
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Buff)
+	bool bUntargetable; // whether the unit can't be targeted while it has the buff
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Buff)
+	int32 DamagePerTurn; // damage dealt to the unit at the start of each turn while it has the buff
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Buff)
+	bool bMagicDamage; // whether the damage per turn is magic damage
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Buff)
+	int32 HealPerTurn; // healing given to the unit at the start of each turn while it has the buff
+
+	// set by the unit when the buff is applied, to match the buff's scheduled effects back to it
+	int32 BuffID;
+
+	// turn of the map's scheduler at the end of which the buff wears off, INDEX_NONE while it isn't scheduled on a map.
+	// RemainingTurns is worked out from it again when the unit leaves the map
+	int32 ExpiryTurn;
+};
+
+// ---------- Stat Aggregation ---------- //
+
+// the stats of a unit with the given base stats and buffs. Each stat is (Base + sum of Add) * product of Multiply,
+// rounded to the nearest whole number. Only the damage modifier can be negative
+FUnitStatBlock AggregateUnitStats(const FUnitStatBlock& Base, const TArray<FUnitBuff>& Buffs);
+
+// the simulation's stat for one set up on a buff
+FORCEINLINE ESimStat ToSimStat(EUnitStat Stat) { return (ESimStat)Stat; }